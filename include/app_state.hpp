@@ -2,6 +2,7 @@
 
 #include <Arduino.h>
 #include "config.hpp"
+#include "string_arena.hpp"
 
 // Centralized application state
 // Step 3: Aggregate scattered global variables into a single structure
@@ -12,20 +13,25 @@ struct AppState {
   int currentPlayingIndex = 0;
   int volume = 10;                    // 0..21
   int brightnessIndex = 2;             // bri, 0..4
-  bool isPlaying = true;
+  bool isPlaying = true;              // isPlaying/stopped mirror Task_Audio (AudioManager::pollEvents)
   bool stopped = false;               // stoped (keeping original spelling for compatibility)
   PlaybackMode playMode = PlaybackMode::Sequential;
+  uint8_t playbackSpeedPct = 100;     // Requested tempo, applied by Task_Audio
+  uint8_t replayGainMode = REPLAYGAIN_DEFAULT_MODE;  // REPLAYGAIN_MODE_*
+  uint8_t latencyMode = LATENCY_DEFAULT_MODE;         // LATENCY_MODE_*
   
   // UI state
   bool screenOff = false;
   int savedBrightness = 2;
   bool showDeleteDialog = false;
   bool showID3Page = false;
+  bool showDiagPage = false;          // Hidden diagnostics page ('`')
   
   // Battery and time
   int batteryPercent = 0;
   unsigned long lastBatteryUpdate = 0;
   String cachedTimeStr = "";
+  String cachedQueueTimeStr = "";     // Remaining queue time shown next to "LIST"
   unsigned long lastTimeUpdate = 0;
   
   // Spectrum graph
@@ -42,44 +48,42 @@ struct AppState {
   String cachedAudioInfo = "";
   unsigned long lastAudioInfoUpdate = 0;
   
-  // ID3 metadata
+  // ID3 metadata, copied from AudioManager::nowPlaying() when its text changes
   String id3Title = "";
   String id3Artist = "";
   String id3Album = "";
   String id3Year = "";
   String id3ContentType = "";
   
-  // ID3 cover (streaming)
-  size_t id3CoverPos = 0;
-  size_t id3CoverLen = 0;
-  uint8_t* id3CoverBuf = nullptr;
-  size_t id3CoverSize = 0;
-  
   // ID3 album text scrolling
   int id3AlbumScrollPos = 0;
   unsigned long id3AlbumSelectTime = 0;
   
-  // Track switching
-  int nextS = 0;  // Request to switch tracks
-  bool volUp = false;
-  
   // Indexed library + playback queue
   uint32_t libraryOffsets[MAX_LIBRARY_FILES] = {0};   // Song index -> offset in LIBRARY_INDEX_PATH
   uint16_t playbackQueue[MAX_LIBRARY_FILES] = {0};    // Queue index -> song index
+  uint16_t libraryDurationSec[MAX_LIBRARY_FILES] = {0};  // Song index -> duration from the index, 0 if unknown
   int libraryCount = 0;
   int fileCount = 0;                                  // Queue size (kept for compatibility)
   int pathCacheIndices[FILE_PATH_CACHE_SIZE] = {0};
-  String pathCacheValues[FILE_PATH_CACHE_SIZE];
+  StrRef pathCacheValues[FILE_PATH_CACHE_SIZE];       // In pathCacheArena
+  StringArena<PATH_CACHE_ARENA_BYTES> pathCacheArena;
   int pathCacheWritePos = 0;
   String queueDirectory = MUSIC_DIR;                  // Current playback scope
 
+  // Folder-level cover art resolved at index time ("#cover" lines in the index)
+  uint32_t folderCoverDirHashes[MAX_FOLDER_COVERS] = {0};  // FNV-1a of directory path
+  uint32_t folderCoverOffsets[MAX_FOLDER_COVERS] = {0};    // Offset of the "#cover" line
+  int folderCoverCount = 0;
+
   // Folder browser state
   bool browserMode = false;
   String browserCurrentDir = MUSIC_DIR;
   bool browserEntryIsDir[MAX_BROWSER_ENTRIES] = {0};
   int browserEntrySongIndex[MAX_BROWSER_ENTRIES] = {0};  // -1 for directory entries
-  String browserEntryName[MAX_BROWSER_ENTRIES];
-  String browserEntryPath[MAX_BROWSER_ENTRIES];          // For directories: target dir
+  StrRef browserEntryName[MAX_BROWSER_ENTRIES];          // In browserArena
+  StrRef browserEntryPath[MAX_BROWSER_ENTRIES];          // For directories: target dir
+  StringArena<BROWSER_ARENA_BYTES> browserArena;         // Reset with the view
   int browserEntryCount = 0;
   
   // Helper methods
@@ -87,11 +91,14 @@ struct AppState {
     return BRIGHTNESS_VALUES[brightnessIndex];
   }
 
+  StrView browserName(int i) const { return browserArena.view(browserEntryName[i]); }
+  StrView browserPath(int i) const { return browserArena.view(browserEntryPath[i]); }
+
   void resetPathCache() {
     pathCacheWritePos = 0;
+    pathCacheArena.reset();
     for (int i = 0; i < FILE_PATH_CACHE_SIZE; ++i) {
       pathCacheIndices[i] = -1;
-      pathCacheValues[i] = "";
     }
   }
 
@@ -101,24 +108,26 @@ struct AppState {
     currentSelectedIndex = 0;
     currentPlayingIndex = 0;
     queueDirectory = MUSIC_DIR;
+    folderCoverCount = 0;
     for (int i = 0; i < MAX_LIBRARY_FILES; ++i) {
       libraryOffsets[i] = 0;
       playbackQueue[i] = 0;
+      libraryDurationSec[i] = 0;
     }
     resetPathCache();
     resetBrowserEntries();
   }
 
-  void resetBrowserEntries() {
+  // Entries past browserEntryCount are never read, so only the arena is dropped
+  void clearBrowserEntries() {
     browserEntryCount = 0;
+    browserArena.reset();
+  }
+
+  void resetBrowserEntries() {
     browserMode = false;
     browserCurrentDir = MUSIC_DIR;
-    for (int i = 0; i < MAX_BROWSER_ENTRIES; ++i) {
-      browserEntryIsDir[i] = false;
-      browserEntrySongIndex[i] = -1;
-      browserEntryName[i] = "";
-      browserEntryPath[i] = "";
-    }
+    clearBrowserEntries();
   }
   
   void resetID3Metadata() {
@@ -127,12 +136,5 @@ struct AppState {
     id3Album = "";
     id3Year = "";
     id3ContentType = "";
-    id3CoverPos = 0;
-    id3CoverLen = 0;
-    if (id3CoverBuf) {
-      heap_caps_free(id3CoverBuf);
-      id3CoverBuf = nullptr;
-      id3CoverSize = 0;
-    }
   }
 };
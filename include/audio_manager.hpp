@@ -4,12 +4,97 @@
 #include <FS.h>
 #include "Audio.h"
 #include "app_state.hpp"
+#include "config.hpp"
+#include "media_info.hpp"
 
 // AudioManager: Centralized audio playback control and callback handling
 // Step 7: Extract audio control logic from M5mp3.cpp
 
 namespace AudioManager {
 
+// Threading: Task_TFT (UI) and Task_Audio share no mutable fields. The UI posts
+// commands into a lock-free ring and wakes Task_Audio with a task notification;
+// Task_Audio answers with events (another ring) and seqlock-published records
+// (playback status, track metadata), which pollEvents() copies into AppState on
+// the UI task.
+
+// Commands posted by the UI task and applied by Task_Audio between decode calls
+enum class AudioCommandType : uint8_t {
+  SeekRelative,  // value: seconds, may be negative
+  SeekPercent,   // value: 0-100 of the track duration
+  SetSpeed,      // value: playback speed in percent (50-200)
+  SetReplayGainMode,  // value: REPLAYGAIN_MODE_*
+  SetLatencyMode,     // value: LATENCY_MODE_*, resizes the I2S DMA
+  PlayTrack,     // value: serial of the request published by requestTrack()
+  SetVolume,     // value: 0-21
+  TogglePause,
+  Stop,
+};
+
+struct AudioCommand {
+  AudioCommandType type;
+  int32_t value;
+  uint32_t issuedMs;  // millis() when posted, for the seek latency log
+};
+
+// Track to open, published by the UI before it posts PlayTrack
+struct TrackRequest {
+  uint32_t serial;
+  uint32_t resumeFilePos;
+  MediaInfo::ReplayGain gain;
+  char path[TRACK_PATH_MAX];
+  char folderCover[TRACK_PATH_MAX];  // Folder's cover image, empty if none (resolved by the UI)
+};
+
+// Published by Task_Audio
+struct PlaybackStatus {
+  uint32_t trackSerial;  // PlayTrack requests opened so far
+  uint32_t trackHash;    // fnv1a32 of the open path, 0 before the first track
+  uint32_t filePos;      // See getPlaybackFilePos()
+  uint32_t positionSec;  // Decoded play time
+  bool paused;
+  // What Task_Audio runs per second of audio, for PowerManager's clock
+  struct Load {
+    uint32_t sampleRate;   // Decoded rate, 0 until the header is parsed
+    uint8_t bitsPerSample;
+    char codec[8];         // Audio::getCodecname(), "" with nothing open
+    bool resampling;       // Converted to AUDIO_OUTPUT_RATE (a track already at that rate bypasses it)
+    bool stretching;       // Playback speed other than 1.0
+  } load;
+};
+
+// Now-playing record, republished by Task_Audio whenever something about the track
+// changes (tags, format, duration, cover). Text fields share one fixed arena, so a
+// record is a single flat copy and the renderer can never mix two tracks.
+struct NowPlaying {
+  enum Field : uint8_t { Title, Artist, Album, Year, ContentType, FieldCount };
+
+  uint32_t trackSerial;  // Request serial of the track, 0 for the one opened at boot
+  uint32_t durationSec;  // Decoder estimate, 0 until known
+  uint32_t sampleRate;   // 0 until the decoder has parsed the header
+  uint8_t bitsPerSample;
+  uint8_t channels;
+  char codec[8];         // "MP3", "FLAC", ...
+  uint32_t coverKey;     // CoverCache handle of the embedded or folder cover, 0 if none
+  uint16_t textOffset[FieldCount];  // Into text; 0 is the shared empty string
+  uint16_t textUsed;
+  char text[NOW_PLAYING_TEXT_BYTES];
+
+  const char* field(Field f) const { return text + textOffset[f]; }
+  void clear();
+  // Replace a field; truncated on a UTF-8 boundary when the arena is full
+  void setField(Field f, const char* value, size_t len);
+};
+
+enum class AudioEventType : uint8_t {
+  TrackEnded,            // The UI picks the next track (play mode, queue) and requests it
+};
+
+struct AudioEvent {
+  AudioEventType type;
+  uint32_t trackSerial;
+};
+
 // Set the Audio instance to manage (call before other functions)
 void setAudioInstance(class Audio* audio);
 
@@ -20,14 +105,48 @@ class Audio* getAudioInstance();
 // Returns true if initialization successful
 bool initialize(AppState& appState);
 
-// Connect to audio file on SD card
-void connectToFile(fs::FS& fs, const char* path);
+// Register the calling task as the command consumer / event consumer (first line of each task)
+void bindAudioTask();
+void bindUiTask();
+
+// Connect to audio file on SD card; gain is the track's indexed ReplayGain (see FileManager).
+// A non-zero resumeFilePos (from getPlaybackFilePos) continues the track from there.
+// folderCover (FileManager::getFolderCoverPath) is shown if the track has no embedded cover.
+// Task_Audio only (or setup before the tasks start); the UI uses requestTrack().
+void connectToFile(fs::FS& fs, const char* path, const MediaInfo::ReplayGain& gain = MediaInfo::ReplayGain(),
+                   uint32_t resumeFilePos = 0, const char* folderCover = nullptr);
+
+// UI task: resolve queueIndex, make it the playing index and ask Task_Audio to open it.
+// False if the path cannot be resolved or the file is gone.
+bool requestTrack(fs::FS& fs, AppState& appState, int queueIndex);
+
+// UI task: apply Task_Audio's events and take this frame's copy of the published records
+// (call once per frame, before drawing)
+void pollEvents(fs::FS& fs, AppState& appState);
+
+// UI task: this frame's now-playing record (see pollEvents)
+const NowPlaying& nowPlaying();
+
+// UI task, from this frame's status: fnv1a32 of the open path (0 before the first track)
+// and the file offset being decoded (read position minus what is still buffered)
+uint32_t getTrackHash();
+uint32_t getPlaybackFilePos();
 
-// Stop current playback
+// UI task: this frame's decoder/DSP load, all zero while paused or stopped
+const PlaybackStatus::Load& playbackLoad();
+
+// Stop current playback (Task_Audio)
 void stop();
 
-// Main audio loop (call in Task_Audio)
-void loop(AppState& appState, bool codecInitialized);
+// Queue a command for Task_Audio (UI task, non-blocking). Returns false if the queue is full.
+bool postCommand(AudioCommandType type, int32_t value);
+
+// Apply queued commands (call in Task_Audio before loop()). Consecutive seeks are merged.
+void processCommands();
+
+// Main audio loop (call in Task_Audio). Returns false while there is nothing to decode
+// (paused, stopped, between tracks); Task_Audio then sleeps until the next command.
+bool loop(bool codecInitialized);
 
 // Set volume (0-21)
 void setVolume(int volume);
@@ -38,26 +157,21 @@ void setBalance(int balance);
 // Set I2S pinout (BCLK, LRCK, DOUT)
 void setPinout(int bclkPin, int lrckPin, int doutPin);
 
-// Get current sample rate
+// UI task, from this frame's records: sample rate, bits per sample, play time and
+// decoder duration of the current track
 uint32_t getSampleRate();
-
-// Get current bits per sample
 uint8_t getBitsPerSample();
-
-// Get current playback time in seconds
 uint32_t getCurrentTime();
-
-// Get total file duration in seconds
 uint32_t getFileDuration();
 
-// ID3 metadata callback (called by ESP32-audioI2S library)
-void onID3Data(const char* info, AppState& appState);
+// ID3 metadata callback (called by ESP32-audioI2S library on Task_Audio)
+void onID3Data(const char* info);
 
-// ID3 image callback (called by ESP32-audioI2S library)
-void onID3Image(File& file, const size_t pos, const size_t size, AppState& appState);
+// ID3 image callback (called by ESP32-audioI2S library on Task_Audio)
+void onID3Image(File& file, const size_t pos, const size_t size);
 
-// EOF callback (called by ESP32-audioI2S library)
-void onEOF(const char* info, AppState& appState, fs::FS& fs);
+// EOF callback (called by ESP32-audioI2S library on Task_Audio); posts TrackEnded
+void onEOF(const char* info);
 
 }  // namespace AudioManager
 
@@ -32,6 +32,16 @@ bool initAudioForDetectedVariant(Variant detected,
                                  int& hpDetectPin, int& ampEnablePin,
                                  bool& codecInitialized, int volume);
 
+// Switch the ES8311 between 16 and 32 bit I2S slots (clock multiplier and serial data word length).
+// Returns false on the Standard board or if the codec is not initialised; playback then stays 16 bit.
+// Takes the I2C lock itself, so Task_Audio can call it mid-playback.
+bool setCodecSlotBits(uint8_t bits);
+
+// The keyboard (TCA8418), codec and PMIC share one I2C bus, reached through both Wire and M5.In_I2C.
+// Once the tasks run, every access holds this lock; setup-time probing and init don't need it.
+void lockI2c();
+void unlockI2c();
+
 // Configure keyboard driver depending on variant (TCA8418 vs IO matrix)
 void configureKeyboard(Variant variant);
 
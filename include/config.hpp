@@ -24,6 +24,12 @@ constexpr int CARDPUTER_ADV_I2S_LRCK = 43;
 constexpr int CARDPUTER_ADV_I2S_DOUT = 42;
 constexpr int CARDPUTER_ADV_HP_DET_PIN = 17;  // LOW when headphones inserted
 constexpr int CARDPUTER_ADV_AMP_EN_PIN = 46;  // HIGH enables amplifier
+constexpr int BATTERY_ADC_PIN = 10;           // Battery voltage behind a 2:1 divider - verify against schematic!
+// microSD slot (wired for SPI; in SD 1-bit mode SCK = CLK, MOSI = CMD, MISO = D0, CS = D3)
+constexpr int CARDPUTER_SD_SCK = 40;
+constexpr int CARDPUTER_SD_MISO = 39;
+constexpr int CARDPUTER_SD_MOSI = 14;
+constexpr int CARDPUTER_SD_CS = 12;
 // Standard (AW88298) I2S pins
 constexpr int CARDPUTER_STD_I2S_BCLK = 41;
 constexpr int CARDPUTER_STD_I2S_LRCK = 43;
@@ -87,14 +93,188 @@ constexpr int MODE_Y = 63;
 constexpr int MAX_LIBRARY_FILES = 4096;
 constexpr int FILE_PATH_CACHE_SIZE = 32;
 constexpr int MAX_BROWSER_ENTRIES = 256;
+constexpr size_t BROWSER_ARENA_BYTES = 12288;    // Names and folder paths of one browser view
+constexpr size_t PATH_CACHE_ARENA_BYTES = 4096;  // Cached track paths; the cache is flushed when full
 constexpr uint8_t LIBRARY_SCAN_MAX_DEPTH = 32;
 constexpr const char* LIBRARY_INDEX_PATH = "/music/.cp_index.txt";
+// First line of the index; bump when the line format changes so old indexes get rebuilt.
+// Track lines are "<path>\t<duration seconds>" (0 when unknown), followed by
+// "\t<track gain>,<track peak>,<album gain>,<album peak>" when the file has ReplayGain tags.
+constexpr const char* LIBRARY_INDEX_HEADER = "#CPIDX 3";
+// Directory cover lines in the index: "#cover\t<dir>\t<image file name>"
+constexpr const char* LIBRARY_INDEX_COVER_TAG = "#cover\t";
+constexpr int MAX_FOLDER_COVERS = 512;
+// Sidecar cover names, highest priority first (compared case-insensitively)
+constexpr int FOLDER_COVER_CANDIDATE_COUNT = 9;
+constexpr const char* FOLDER_COVER_CANDIDATES[FOLDER_COVER_CANDIDATE_COUNT] = {
+  "cover.jpg", "cover.jpeg", "cover.png",
+  "folder.jpg", "folder.jpeg", "folder.png",
+  "front.jpg", "front.jpeg", "front.png"
+};
 
 // Cover image scanning
 constexpr size_t COVER_SCAN_MAX = 4096;  // 4KB scan limit
 constexpr size_t JPEG_SCAN_MAX = 4096;
 constexpr size_t COVER_HEADER_BUF_SIZE = 32;
 
+// Cover thumbnail cache (decoded COVER_WIDTH x COVER_HEIGHT RGB565, see CoverCache)
+constexpr const char* COVER_CACHE_DIR = "/music/.cp_covers";
+constexpr size_t COVER_THUMB_BYTES = COVER_WIDTH * COVER_HEIGHT * 2;  // 18KB per thumbnail
+constexpr int COVER_CACHE_SLOTS_PSRAM = 8;     // In-memory LRU size when PSRAM is available
+constexpr int COVER_CACHE_SLOTS_INTERNAL = 2;  // Fallback LRU size in internal RAM
+constexpr size_t COVER_PATH_MAX = 256;
+constexpr uint32_t COVER_WORKER_STACK_SIZE = 8192;
+constexpr unsigned COVER_WORKER_PRIORITY = 1;  // Below Task_TFT so key handling never waits on a decode
+constexpr int COVER_WORKER_CORE = 0;
+
+// CJK glyph cache (see GlyphCache): set-associative, LRU within a set
+constexpr int GLYPH_CACHE_SETS = 64;      // Power of two
+constexpr int GLYPH_CACHE_WAYS = 4;
+constexpr int GLYPH_MAX_WIDTH = 16;       // efont *_12 glyphs fit in 16x16
+constexpr int GLYPH_MAX_HEIGHT = 16;
+constexpr int GLYPH_BITMAP_BYTES = ((GLYPH_MAX_WIDTH + 7) / 8) * GLYPH_MAX_HEIGHT;  // 1-bit, MSB first
+constexpr int FONT_CHOICE_CACHE_SIZE = 32;  // Per-string font choice memo in detectAndGetFont
+
+// UI <-> Task_Audio channels (see AudioManager::postCommand); ring sizes are powers of two
+constexpr int AUDIO_COMMAND_QUEUE_LEN = 8;
+constexpr int AUDIO_EVENT_QUEUE_LEN = 4;
+constexpr uint32_t AUDIO_STATUS_INTERVAL_MS = 100;  // Position publish rate while playing
+constexpr int TRACK_PATH_MAX = 256;                 // Bytes, path of a track request
+constexpr int NOW_PLAYING_TEXT_BYTES = 320;         // Tag text arena of the now-playing record
+constexpr uint32_t UI_FRAME_MS = 50;                // Task_TFT period, shorter when Task_Audio posts an event
+
+// Seeking
+constexpr int SEEK_STEP_SHORT_SEC = 5;   // ',' and '/'
+constexpr int SEEK_STEP_LONG_SEC = 30;   // '[' and ']'
+
+// Playback speeds cycled by 'x' (percent, pitch is kept; see Audio::setPlaybackSpeed)
+constexpr int PLAYBACK_SPEED_COUNT = 6;
+constexpr uint8_t PLAYBACK_SPEEDS_PCT[PLAYBACK_SPEED_COUNT] = {100, 125, 150, 200, 50, 75};
+
+// ReplayGain loudness normalisation (tags read at index time), cycled by 'r'
+constexpr uint8_t REPLAYGAIN_MODE_OFF = 0;
+constexpr uint8_t REPLAYGAIN_MODE_TRACK = 1;
+constexpr uint8_t REPLAYGAIN_MODE_ALBUM = 2;
+constexpr uint8_t REPLAYGAIN_DEFAULT_MODE = REPLAYGAIN_MODE_TRACK;
+constexpr float REPLAYGAIN_PREAMP_DB = 0.0f;     // Added to tagged gains
+constexpr float REPLAYGAIN_UNTAGGED_DB = -6.0f;  // Untagged tracks, roughly the typical tagged gain of modern masters
+
+// I2S DMA latency modes, cycled by 'k' (see AudioManager). Sizes are DMA buffers x frames per
+// buffer; at 44.1 kHz 512 frames are 11.6 ms. Frames stay <= 511 where 32 bit slots must fit
+// the IDF's 4092 byte buffer limit (balanced keeps the library's original 16 x 512).
+constexpr uint8_t LATENCY_MODE_BALANCED = 0;  // 0 so sessions saved before the setting get it
+constexpr uint8_t LATENCY_MODE_LOW = 1;       // Fast volume/seek response, little SD stall cover
+constexpr uint8_t LATENCY_MODE_BATTERY = 2;   // Large DMA, Task_Audio sleeps until it is mostly played
+constexpr uint8_t LATENCY_MODE_AUTO = 3;      // Starts small, grows after underruns
+constexpr uint8_t LATENCY_MODE_COUNT = 4;
+constexpr uint8_t LATENCY_DEFAULT_MODE = LATENCY_MODE_BALANCED;
+constexpr uint16_t LATENCY_DMA_BUFFERS[3] = {16, 4, 24};     // Balanced, low, battery
+constexpr uint16_t LATENCY_DMA_FRAMES[3] = {511, 384, 511};   // 511: the most a 4092-byte buffer holds at 32 bits
+constexpr uint32_t LATENCY_REFILL_BELOW_MS[3] = {0, 0, 80};  // Sleep while more is queued, 0: refill continuously
+constexpr uint16_t LATENCY_AUTO_FRAMES = 384;
+constexpr uint16_t LATENCY_AUTO_MIN_BUFFERS = 6;             // ~52 ms
+constexpr uint16_t LATENCY_AUTO_MAX_BUFFERS = 32;            // ~280 ms
+constexpr uint16_t LATENCY_AUTO_STEP_BUFFERS = 4;
+constexpr uint32_t LATENCY_AUTO_HOLDOFF_MS = 3000;           // After a resize, before underruns count again
+constexpr uint32_t LATENCY_HEAP_RESERVE_BYTES = 32 * 1024;   // Internal RAM left free when growing the DMA
+
+// MP3 seek index persisted per track (one file offset per second, built by Audio while playing)
+constexpr const char* SEEK_INDEX_DIR = "/music/.cp_seek";
+constexpr uint32_t SEEK_INDEX_MAGIC = 0x314B5343;  // "CSK1"
+
+// Playback session kept in NVS across power cycles (see Session)
+constexpr const char* SESSION_NVS_NAMESPACE = "cpsession";
+constexpr uint32_t SESSION_MAGIC = 0x31535343;                 // "CSS1"
+constexpr uint32_t SESSION_SAVE_DELAY_MS = 3000;               // Settings/track must be stable this long
+constexpr uint32_t SESSION_POSITION_INTERVAL_MS = 60 * 1000;   // Position of a playing track, worst-case loss
+constexpr uint32_t SESSION_MIN_DMA_MS = 100;                   // Less DMA than this: no writes while playing
+
+// SD reads for playback (see Audio::setFileReadChunk). Without PSRAM the input ring lives in internal RAM,
+// so it is kept at 16KB of ring (+1600 reserved for a frame split at the wrap); reads are capped by the ring.
+constexpr uint32_t SD_READ_CHUNK_BYTES = 32 * 1024;     // Multiple of 512, 512..128KB
+constexpr int AUDIO_INBUFF_RAM_BYTES = 16 * 1024 + 1600;
+constexpr int AUDIO_INBUFF_PSRAM_BYTES = 300000;
+
+// Fixed I2S output rate (see Audio::setOutputSampleRate). 0: I2S follows each track's rate.
+// Otherwise every track is resampled to this rate, so the I2S/ES8311 clocks never change between tracks.
+#ifndef AUDIO_OUTPUT_RATE
+#define AUDIO_OUTPUT_RATE 0
+#endif
+#ifndef AUDIO_RESAMPLE_QUALITY
+#define AUDIO_RESAMPLE_QUALITY 1  // 0: 8 taps, 1: 16 taps, 2: 32 taps
+#endif
+
+// SD bus (see Storage). SD_MMC 1-bit uses the SDMMC host on the same pins; SPI is the default.
+#ifndef STORAGE_USE_SDMMC
+#define STORAGE_USE_SDMMC 0
+#endif
+#ifndef SD_CLOCK_AUTOTUNE
+#define SD_CLOCK_AUTOTUNE 1  // Try faster SPI clocks at boot and keep the fastest that reads back clean
+#endif
+constexpr uint32_t SD_SPI_CLOCK_SAFE_HZ = 4000000;   // Mount and reference read
+constexpr uint32_t SD_SPI_CLOCK_HZ = 20000000;       // Used when autotune is off
+constexpr int SD_SPI_CLOCK_CANDIDATE_COUNT = 5;      // Fastest first; APB (80 MHz) divisors
+constexpr uint32_t SD_SPI_CLOCK_CANDIDATES[SD_SPI_CLOCK_CANDIDATE_COUNT] = {
+  40000000, 26666667, 20000000, 16000000, 10000000
+};
+constexpr uint32_t SD_CLOCK_PROBE_SECTORS = 128;     // 64KB of raw sectors per pass
+constexpr int SD_CLOCK_PROBE_PASSES = 2;
+
+// Read-size sweep on the first queued track at boot (see SdBench); off in normal builds
+#ifndef SD_READ_BENCHMARK
+#define SD_READ_BENCHMARK 0
+#endif
+constexpr uint32_t SD_BENCH_BYTES_PER_SIZE = 1024 * 1024;
+
+// Task stacks (bytes; ESP-IDF stack depths are in bytes)
+constexpr uint32_t UI_TASK_STACK_SIZE = 20480;
+constexpr uint32_t AUDIO_TASK_STACK_SIZE = 10240;
+
+// Diagnostics page ('`') and heap/stack telemetry (see Diagnostics)
+#ifndef DIAG_SERIAL_LOG
+#define DIAG_SERIAL_LOG 0  // 1: log a CSV line of heap and stack stats every DIAG_LOG_INTERVAL_MS
+#endif
+constexpr uint32_t DIAG_LOG_INTERVAL_MS = 10000;
+constexpr uint32_t DIAG_PAGE_INTERVAL_MS = 1000;  // Resample rate while the page is shown
+constexpr int DIAG_MAX_TASKS = 6;
+constexpr int DIAG_LINE_HEIGHT = 11;             // Font 0 rows on the page
+
+// I2S output monitor (see OutputMonitor): underrun and near-miss counts on the diagnostics page
+constexpr uint32_t OUTPUT_NEAR_MISS_PCT = 25;       // Less than this share of the DMA queued counts as a near miss
+constexpr uint32_t OUTPUT_REARM_PCT = 50;           // The next one counts after climbing back above this share
+constexpr uint32_t OUTPUT_MONITOR_WAIT_MS = 100;    // Longest a driver reinstall waits for the monitor
+constexpr uint32_t OUTPUT_MONITOR_PUBLISH_MS = 250;
+constexpr uint32_t OUTPUT_MONITOR_STACK_SIZE = 3072;
+constexpr unsigned OUTPUT_MONITOR_PRIORITY = 5;     // Above Task_TFT and Task_Audio; it only wakes per DMA buffer
+constexpr int OUTPUT_MONITOR_CORE = 0;              // Off the audio core, whose running task it samples
+
+// Hot-path trace ring (see Trace); 't' dumps it over serial. Off in normal builds:
+// the trace points compile to nothing and the ring is not linked. Enable with
+// -DENABLE_TRACE=1 so the trace points in ESP32-audioI2S are built too.
+#ifndef ENABLE_TRACE
+#define ENABLE_TRACE 0
+#endif
+constexpr int TRACE_RING_EVENTS = 1024;  // 12 bytes each, power of two
+
+// Power (see PowerManager). The CPU clock follows the playback load and the screen, and
+// steps up one level for POWER_BOOST_HOLD_MS after each output near miss; 0 keeps it at 240 MHz.
+#ifndef POWER_DYNAMIC_CLOCK
+#define POWER_DYNAMIC_CLOCK 1
+#endif
+constexpr uint32_t POWER_SCREEN_ON_MHZ = 160;
+constexpr uint32_t POWER_SCREEN_OFF_MHZ = 80;
+constexpr uint32_t POWER_HIRES_RATE = 48000;             // Above this a track needs one level more
+constexpr uint32_t POWER_BOOST_HOLD_MS = 60 * 1000;
+constexpr uint32_t POWER_SAMPLE_MS = 10 * 1000;          // Battery sampling for the drain report
+constexpr int POWER_ADC_SAMPLES = 8;                     // Averaged per sample
+constexpr uint32_t POWER_SEGMENT_MS = 20 * 60 * 1000;    // Voltage estimate: shortest stretch at one clock
+constexpr float POWER_CHARGE_RISE_MV = 15;               // A rise this large means a charger is attached
+constexpr float BATTERY_CAPACITY_MAH = 1750;
+constexpr float BATTERY_FULL_MV = 4200;                  // Linear 0-100%, as getBatteryPercent
+constexpr float BATTERY_EMPTY_MV = 3300;
+constexpr uint32_t HP_DETECT_DEBOUNCE_MS = 50;
+constexpr uint32_t HP_DETECT_FALLBACK_MS = 5000;         // Re-read the pin even without an edge
+
 // Timing intervals (ms)
 constexpr unsigned long BATTERY_UPDATE_INTERVAL = 30000;
 constexpr unsigned long TIME_UPDATE_INTERVAL = 1000;
@@ -107,6 +287,7 @@ constexpr unsigned long ID3_SCROLL_DELAY = 1000;
 constexpr const char* PLACEHOLDER_UNKNOWN_ARTIST = "Unknown Artist";
 constexpr const char* PLACEHOLDER_UNKNOWN_ALBUM = "Unknown Album";
 constexpr const char* PLACEHOLDER_NO_COVER = "No Cover";
+constexpr const char* PLACEHOLDER_LOADING_COVER = "Loading...";
 
 // SD card paths
 constexpr const char* MUSIC_DIR = "/music";
@@ -290,7 +471,7 @@ constexpr int LIST_TEXT_START_X = 8;
 constexpr int LIST_TEXT_START_Y = 10;
 constexpr int LIST_SCROLL_THRESHOLD = 3;  // Start scrolling when selected index >= this
 constexpr int FILENAME_DISPLAY_MAX_LENGTH = 20;  // Maximum characters to display for filename
-constexpr int TEXT_WIDTH_ESTIMATE_PX = 5;  // Estimated pixels per character for text width calculation
+constexpr int MARQUEE_MAX_WIDTH = 1024;  // Longest pre-rendered scrolling line (1-bit strip, ~2KB)
 
 // Border lines
 constexpr int BORDER_LEFT_X = 3;
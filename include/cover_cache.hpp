@@ -0,0 +1,39 @@
+#pragma once
+
+#include <Arduino.h>
+#include <FS.h>
+
+// CoverCache: decode album art once, keep 96x96 RGB565 thumbnails on SD
+// (COVER_CACHE_DIR, keyed by source path + image offset + size) and the most
+// recently used ones in memory. Decoding runs on a low-priority worker task.
+
+namespace CoverCache {
+
+enum class State {
+  None = 0,   // No cover requested for the current track
+  Loading,    // Worker is loading/decoding the requested cover
+  Ready,      // Thumbnail published; use acquire()/release()
+  Failed      // Image missing or not decodable
+};
+
+// Create the cache directory and start the worker (call once after SD is mounted)
+bool initialize(fs::FS& fs);
+
+// Ask the worker for the thumbnail of the image stored at [pos, pos + len) in sourcePath.
+// Replaces any previous request; safe to call from the audio task. Returns the
+// cover key to hand to acquire(), 0 if nothing was requested.
+uint32_t request(const char* sourcePath, size_t pos, size_t len);
+
+// Drop the current request/thumbnail (track changed). An in-flight decode is aborted.
+void cancel();
+
+// Pin the published thumbnail for drawing. When Ready, pixels points to
+// COVER_WIDTH x COVER_HEIGHT swap565 data that stays valid until release().
+// key is the one returned by request(); a thumbnail for any other key is
+// reported as Loading, so the picture never runs ahead of the metadata.
+State acquire(uint32_t key, const uint16_t*& pixels);
+
+// Unpin the thumbnail returned by the last acquire()
+void release();
+
+}  // namespace CoverCache
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <Arduino.h>
+#include "config.hpp"
+
+// Diagnostics: stack high-water marks of the app's tasks and heap statistics per
+// memory type, sampled on Task_TFT. Shown on the hidden diagnostics page ('`')
+// and, with DIAG_SERIAL_LOG, logged as one CSV line every DIAG_LOG_INTERVAL_MS.
+
+namespace Diagnostics {
+
+struct HeapStats {
+  uint32_t totalBytes;     // 0 when the memory type is absent (PSRAM)
+  uint32_t freeBytes;
+  uint32_t minFreeBytes;   // Low-water mark since boot
+  uint32_t largestBlock;   // Largest single allocation that would succeed now
+  uint32_t allocatedBlocks;
+  uint32_t freeBlocks;
+  uint8_t fragmentationPct;  // 100 - largestBlock / freeBytes
+};
+
+struct TaskStats {
+  const char* name;
+  uint32_t stackBytes;     // As created
+  uint32_t minFreeBytes;   // uxTaskGetStackHighWaterMark (bytes on ESP-IDF)
+};
+
+struct Snapshot {
+  uint32_t ms;
+  uint32_t cpuMhz;
+  HeapStats internal;
+  HeapStats psram;
+  TaskStats tasks[DIAG_MAX_TASKS];
+  int taskCount;
+};
+
+// Watch a task's stack. Call from setup() only, once per task; name must be a literal.
+void registerTask(const char* name, TaskHandle_t handle, uint32_t stackBytes);
+
+// Take a snapshot now (walks the heaps, a few hundred microseconds)
+void sample(Snapshot& out);
+
+// Task_TFT, once per frame: resamples every DIAG_PAGE_INTERVAL_MS while the page is
+// shown, otherwise only when a serial line is due
+void update(bool pageVisible);
+
+// Last snapshot taken by update()
+const Snapshot& latest();
+
+}  // namespace Diagnostics
@@ -4,6 +4,7 @@
 #include <FS.h>
 #include "app_state.hpp"
 #include "config.hpp"
+#include "media_info.hpp"
 #include "M5Cardputer.h"  // For M5Canvas type alias
 #include <ESP32Time.h>    // For ESP32Time class
 
@@ -13,6 +14,8 @@ namespace FileManager {
 struct Callbacks {
   void (*resetClock)() = nullptr;
   void (*onFileDeleted)(int deletedIndex, int newPlayingIndex) = nullptr;
+  void (*playQueueIndex)(int queueIndex) = nullptr;  // Replace the deleted playing track
+  void (*stopPlayback)() = nullptr;                  // Queue became empty
 };
 
 // Backward-compatible entry: rebuild index from dirname and load playback queue
@@ -27,6 +30,20 @@ bool loadLibraryIndex(fs::FS& fs, AppState& appState);
 // Read full file path from current playback queue index
 bool getPathByQueueIndex(fs::FS& fs, AppState& appState, int queueIndex, String& outPath);
 
+// Track duration in seconds recorded at index time (0 if unknown)
+uint32_t getDurationByQueueIndex(const AppState& appState, int queueIndex);
+
+// ReplayGain tags recorded at index time; false (and all unknown) if the track has none.
+// Reads the index line, so call it once per track start rather than per frame.
+bool getReplayGainByQueueIndex(fs::FS& fs, const AppState& appState, int queueIndex, MediaInfo::ReplayGain& out);
+
+// Sum of indexed durations from firstQueueIndex to the end of the queue
+uint32_t getQueueDurationFrom(const AppState& appState, int firstQueueIndex);
+
+// Resolve the sidecar cover image (cover/folder/front.jpg|png) for a track's directory.
+// Uses the "#cover" lines recorded at index time; never probes the card for candidates.
+bool getFolderCoverPath(fs::FS& fs, AppState& appState, const char* trackPath, String& outImagePath);
+
 // Build playback queue from a target directory (recursive)
 bool buildQueueForDirectory(fs::FS& fs, AppState& appState, const char* dirname, int preferredSongIndex = -1);
 
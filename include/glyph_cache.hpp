@@ -0,0 +1,26 @@
+#pragma once
+
+#include <Arduino.h>
+#include "M5Cardputer.h"
+
+// GlyphCache: 1-bit glyph bitmaps for the CJK U8g2 fonts, rendered once and
+// kept in a set-associative LRU keyed by font + codepoint. Drawing a cached
+// string is a drawBitmap per glyph instead of U8g2 bitmap-stream decoding.
+
+namespace GlyphCache {
+
+// Allocate the glyph pool (PSRAM when available). Call once before drawing.
+bool initialize();
+
+// Draw UTF-8 text with a U8g2 font honouring dst's current text datum, like drawString.
+// Returns the rendered width in pixels.
+int32_t drawText(M5Canvas& dst, const char* text, const lgfx::U8g2font* font,
+                 int32_t x, int32_t y, uint16_t fg, uint16_t bg);
+
+// Width of text in pixels using cached glyph advances (populates the cache)
+int32_t textWidth(const char* text, const lgfx::U8g2font* font);
+
+// Cache statistics since boot
+void getStats(uint32_t& hits, uint32_t& misses);
+
+}  // namespace GlyphCache
@@ -10,6 +10,8 @@ namespace InputHandler {
 // - 'm': cycle playback mode (SEQ -> RND -> ONE)
 // - 's': screen on/off toggle with brightness restore/save
 // - 'i': toggle ID3 page and reset its scroll timer
+// - '`': toggle the diagnostics page
+// - 't': dump the trace ring over serial (ENABLE_TRACE builds)
 //
 // Returns true if any UI needs immediate redraw.
 bool processBasicToggles(AppState& appState);
@@ -29,6 +31,32 @@ struct Actions {
 // Returns true if anything changed requiring redraw.
 bool processPlaybackAndList(AppState& appState);
 
+// Handle seek keys (posted to Task_Audio through AudioManager::postCommand):
+// - ',' '/' : back/forward SEEK_STEP_SHORT_SEC
+// - '[' ']' : back/forward SEEK_STEP_LONG_SEC
+// - '0'-'9' : jump to 0%-90% of the track
+//
+// Returns true if a seek was requested.
+bool processSeekKeys(AppState& appState);
+
+// Handle the speed key (posted to Task_Audio like the seek keys):
+// - 'x' : next entry of PLAYBACK_SPEEDS_PCT (pitch is kept)
+//
+// Returns true if the speed changed.
+bool processSpeedKey(AppState& appState);
+
+// Handle the ReplayGain key (posted to Task_Audio like the speed key):
+// - 'r' : off -> track -> album
+//
+// Returns true if the mode changed.
+bool processReplayGainKey(AppState& appState);
+
+// Handle the latency key (posted to Task_Audio like the speed key):
+// - 'k' : balanced -> low latency -> battery saver -> auto
+//
+// Returns true if the mode changed.
+bool processLatencyKey(AppState& appState);
+
 // Handle delete dialog and screenshot keys:
 // - 'd' : open delete dialog
 // - 'y' : confirm delete (calls actions.deleteCurrentFile if provided)
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <Arduino.h>
+#include "M5Cardputer.h"
+
+// MarqueeStrip: a scrolling text line pre-rendered once into a 1-bit
+// off-screen strip. Scrolling then only copies the visible window, so the
+// per-frame cost does not depend on string length or font complexity.
+
+class MarqueeStrip {
+ public:
+  // Render text into the strip if text or font changed; colours only update the palette.
+  // Returns the text width in pixels.
+  int32_t prepare(const String& text, const lgfx::U8g2font* font, uint16_t fg, uint16_t bg);
+
+  // Copy the strip to dst with its left edge at x. The caller's clip rect bounds the copy;
+  // y follows dst's text datum the same way drawString would.
+  void draw(M5Canvas& dst, int32_t x, int32_t y);
+
+  int32_t width() const { return _textWidth; }
+
+ private:
+  M5Canvas _canvas;
+  uint32_t _hash = 0;
+  const lgfx::U8g2font* _font = nullptr;
+  int32_t _textWidth = 0;
+  uint16_t _fg = 0;
+  uint16_t _bg = 0;
+  bool _ready = false;
+};
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <Arduino.h>
+#include <FS.h>
+
+// MediaInfo: container-level track facts read from headers only, without
+// decoding audio. Used by the library indexer.
+
+namespace MediaInfo {
+
+// Duration in whole seconds (rounded), or 0 if it cannot be determined.
+// MP3: Xing/Info/VBRI frame count, else CBR size / bitrate. WAV: data chunk size.
+// FLAC: STREAMINFO total samples. M4A: mdhd of the first track. AAC (ADTS): 0.
+uint32_t probeDurationSec(File& file);
+
+// ReplayGain values from the tags; gains in 1/100 dB, peaks in 1/10000 of full scale.
+struct ReplayGain {
+  static constexpr int16_t kUnknownGain = INT16_MIN;
+  int16_t trackGain = kUnknownGain;
+  int16_t albumGain = kUnknownGain;
+  uint16_t trackPeak = 0;  // 0 if unknown
+  uint16_t albumPeak = 0;
+  bool any() const { return trackGain != kUnknownGain || albumGain != kUnknownGain; }
+};
+
+// REPLAYGAIN_TRACK/ALBUM_GAIN/PEAK from ID3v2.3/2.4 TXXX frames (MP3, or an ID3 tag ahead of FLAC)
+// and FLAC Vorbis comments. Returns false if the file has none.
+bool probeReplayGain(File& file, ReplayGain& out);
+
+}  // namespace MediaInfo
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <Arduino.h>
+#include "config.hpp"
+
+class Audio;
+
+// OutputMonitor: watches the I2S DMA queue from the driver's events and counts
+// underruns (the DMA ran dry while a track was playing) and near misses (less
+// than OUTPUT_NEAR_MISS_PCT of the DMA queued). For each one it records which task was
+// running on the audio core, so a dropout can be tied to what starved it.
+// Runs as its own task on core 0, above Task_TFT.
+
+namespace OutputMonitor {
+
+struct Stats {
+  uint32_t underruns;
+  uint32_t nearMisses;
+  uint32_t depthMs;       // Queued in the DMA now
+  uint32_t minDepthMs;    // Lowest while playing since boot, UINT32_MAX if never measured
+  uint32_t capacityMs;    // dmaBufCount x dmaBufLen at the current rate
+  uint16_t dmaBufCount;
+  uint16_t dmaBufLen;     // Frames per DMA buffer, as the driver allocated them
+  uint32_t lastEventMs;   // millis() of the last underrun or near miss, 0 if none
+  bool lastWasUnderrun;
+  char lastTask[configMAX_TASK_NAME_LEN];  // Running on core 1 at that moment
+  char lastAudioState;    // Task_Audio then: 'R'unning, 'r'eady (preempted), 'B'locked, 'S'uspended
+};
+
+// Create the monitor task (setup, after the audio task exists)
+bool start(Audio* audio, TaskHandle_t audioTask);
+
+// Task_Audio: output is expected to be fed (playing, not paused). Underruns are
+// only counted while set and once the DMA has been at least half full, so pauses,
+// stops and the first fill of a track don't show up.
+void setActive(bool active);
+
+// Any task: latest published stats
+void read(Stats& out);
+
+// Any task: ms queued in the DMA as of the last DMA event (at most one buffer old)
+uint32_t queuedMs();
+
+}  // namespace OutputMonitor
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stdint.h>
+
+// Small FNV-1a helpers used to build content keys for on-SD caches
+// (cover thumbnails, seek indexes). Not cryptographic, just stable.
+
+constexpr uint32_t FNV1A_OFFSET_BASIS = 2166136261UL;
+constexpr uint32_t FNV1A_PRIME = 16777619UL;
+
+inline uint32_t fnv1a32(const char* str, uint32_t hash = FNV1A_OFFSET_BASIS) {
+  if (!str) return hash;
+  while (*str) {
+    hash ^= (uint8_t)*str++;
+    hash *= FNV1A_PRIME;
+  }
+  return hash;
+}
+
+// Mix a 32-bit value into an existing hash (little-endian byte order)
+inline uint32_t fnv1a32Mix(uint32_t hash, uint32_t value) {
+  for (int i = 0; i < 4; ++i) {
+    hash ^= (uint8_t)(value >> (i * 8));
+    hash *= FNV1A_PRIME;
+  }
+  return hash;
+}
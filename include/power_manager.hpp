@@ -0,0 +1,39 @@
+#pragma once
+
+#include <Arduino.h>
+#include "app_state.hpp"
+#include "config.hpp"
+
+// PowerManager: CPU clock policy and per-clock battery drain. The base clock is the
+// higher of what the screen needs (POWER_SCREEN_ON_MHZ / POWER_SCREEN_OFF_MHZ) and what
+// the playback load needs (AudioManager::playbackLoad: hi-res decoding, time stretch,
+// resampling). As a fallback it steps up one level for a while whenever the output
+// monitor reports a near miss or underrun, i.e. when the decoder ran out of headroom anyway. Drain is the PMIC's current where the board has one,
+// otherwise estimated from the battery voltage falling over long stretches at one clock.
+
+namespace PowerManager {
+
+enum Level : uint8_t { Mhz80, Mhz160, Mhz240, LevelCount };
+
+struct Report {
+  Level level;                   // Current clock
+  Level loadLevel;               // What the playback load alone asks for
+  int32_t drainMa[LevelCount];   // -1 until measured
+  bool measured;                 // PMIC current rather than the voltage estimate
+};
+
+// Setup, before the tasks start
+void initialize();
+
+// Task_TFT, once per frame
+void update(const AppState& appState);
+
+// Task_TFT: latest report
+const Report& report();
+
+// Battery voltage in mV from the PMIC or the battery ADC, 0 if unavailable
+int batteryMillivolts();
+
+uint32_t levelMhz(Level level);
+
+}  // namespace PowerManager
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <Arduino.h>
+#include <FS.h>
+
+// SdBench: sequential read throughput of the SD card for a range of read
+// sizes, to pick SD_READ_CHUNK_BYTES. Results go to the serial log.
+
+namespace SdBench {
+
+struct ReadResult {
+  uint32_t readSize = 0;
+  uint32_t bytes = 0;       // Bytes actually read
+  uint32_t kbPerSec = 0;
+  uint32_t worstUs = 0;     // Slowest single read
+  uint32_t avgUs = 0;
+};
+
+// Read totalBytes from path in readSize pieces (sector-aligned, wrapping to the start of the file).
+// buf must hold readSize bytes. Returns false if the file cannot be read.
+bool measureReads(fs::FS& fs, const char* path, uint8_t* buf, uint32_t readSize, uint32_t totalBytes,
+                  ReadResult& result);
+
+// Sweep 512B..128KB (sizes that do not fit the largest allocatable buffer are skipped) and log a table.
+void sweepReadSizes(fs::FS& fs, const char* path);
+
+}  // namespace SdBench
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <atomic>
+#include <stdint.h>
+
+// Double-buffered seqlock: one writer publishes a new T while readers on any
+// task copy the latest complete one. The writer never waits; publish n fills
+// slot n & 1, so a reader only retries when two publishes land within one copy.
+// T must be trivially copyable (fixed-size arrays, no String).
+template <typename T>
+class Seqlock {
+ public:
+  // Writer side (a single task)
+  void publish(const T& value) {
+    uint32_t n = (seq_.load(std::memory_order_relaxed) >> 1) + 1;
+    seq_.store(2 * n - 1, std::memory_order_relaxed);  // Odd: publish n in progress
+    std::atomic_thread_fence(std::memory_order_release);
+    slots_[n & 1] = value;
+    seq_.store(2 * n, std::memory_order_release);
+  }
+
+  // Reader side. Returns the publish count of the copy (0: nothing published yet).
+  uint32_t read(T& out) const {
+    while (true) {
+      uint32_t s1 = seq_.load(std::memory_order_acquire);
+      uint32_t complete = s1 >> 1;
+      out = slots_[complete & 1];
+      std::atomic_thread_fence(std::memory_order_acquire);
+      uint32_t s2 = seq_.load(std::memory_order_relaxed);
+      if (s2 - s1 < 3 - (s1 & 1)) return complete;  // Slot is rewritten by publish complete + 2 only
+    }
+  }
+
+  // Publish count without copying, to skip unchanged records
+  uint32_t version() const { return seq_.load(std::memory_order_acquire) >> 1; }
+
+ private:
+  T slots_[2] = {};
+  std::atomic<uint32_t> seq_{0};
+};
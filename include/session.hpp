@@ -0,0 +1,30 @@
+#pragma once
+
+#include <Arduino.h>
+#include <FS.h>
+#include "app_state.hpp"
+
+// Session: what survives a power cycle (queue scope, current track and its
+// position, volume, brightness, play mode, speed, ReplayGain mode), kept in
+// NVS. Writes are batched to spare the flash: settings and track changes are
+// saved once they have been stable for SESSION_SAVE_DELAY_MS, the position of
+// a playing track at most every SESSION_POSITION_INTERVAL_MS. While playing with
+// less than SESSION_MIN_DMA_MS of DMA (low latency) nothing is written until a pause.
+
+namespace Session {
+
+// Read the saved session and apply its settings to appState. Call early in
+// setup, before the brightness, the volume and AudioManager are initialised.
+// Returns false if there is no valid session.
+bool loadSettings(AppState& appState);
+
+// After the library index is loaded: rebuild the saved queue and select the
+// saved track. outResumeFilePos is the byte offset for connecttoFS (0 when the
+// track cannot be confirmed). Returns false if the saved queue is gone.
+bool restoreQueue(fs::FS& fs, AppState& appState, uint32_t& outResumeFilePos);
+
+// Call regularly from Task_TFT; writes only when something changed and the
+// batching allows it.
+void update(const AppState& appState);
+
+}  // namespace Session
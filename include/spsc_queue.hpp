@@ -0,0 +1,49 @@
+#pragma once
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+// Lock-free ring for exactly one producer task and one consumer task (may be on
+// different cores). N must be a power of two; one slot stays empty, so it holds
+// N - 1 items. T is copied in and out, keep it small and trivially copyable.
+template <typename T, size_t N>
+class SpscQueue {
+  static_assert(N >= 2 && (N & (N - 1)) == 0, "SpscQueue size must be a power of two");
+
+ public:
+  // Producer side. False if the ring is full.
+  bool push(const T& item) {
+    uint32_t head = head_.load(std::memory_order_relaxed);
+    uint32_t next = (head + 1) & (N - 1);
+    if (next == tail_.load(std::memory_order_acquire)) return false;
+    items_[head] = item;
+    head_.store(next, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer side. False if the ring is empty.
+  bool pop(T& out) {
+    uint32_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail == head_.load(std::memory_order_acquire)) return false;
+    out = items_[tail];
+    tail_.store((tail + 1) & (N - 1), std::memory_order_release);
+    return true;
+  }
+
+  // Producer side. The consumer only ever frees slots, so a push right after
+  // full() returned false succeeds.
+  bool full() const {
+    uint32_t next = (head_.load(std::memory_order_relaxed) + 1) & (N - 1);
+    return next == tail_.load(std::memory_order_acquire);
+  }
+
+  bool empty() const {
+    return tail_.load(std::memory_order_acquire) == head_.load(std::memory_order_acquire);
+  }
+
+ private:
+  T items_[N];
+  std::atomic<uint32_t> head_{0};  // Written by the producer only
+  std::atomic<uint32_t> tail_{0};  // Written by the consumer only
+};
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <Arduino.h>
+#include <FS.h>
+
+// Storage: owns the microSD mount. Everything else reaches the card through
+// Storage::fs(), so the bus (SPI or SD_MMC 1-bit) and its clock are chosen
+// in one place.
+
+namespace Storage {
+
+enum class Bus : uint8_t {
+  Spi,
+  Mmc1Bit,
+};
+
+struct Info {
+  Bus bus = Bus::Spi;
+  bool mounted = false;
+  uint32_t clockHz = 0;
+  uint32_t probeKBps = 0;  // Raw sector read rate measured by the clock probe, 0 if not probed
+};
+
+// Mount the card (call once in setup). With SD_CLOCK_AUTOTUNE the SPI clock is
+// stepped down from the fastest candidate until reads match a reference read.
+bool begin();
+
+// Filesystem of the mounted card
+fs::FS& fs();
+
+const Info& info();
+
+}  // namespace Storage
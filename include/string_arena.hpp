@@ -0,0 +1,71 @@
+#pragma once
+
+#include <Arduino.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Read-only view of a string owned by someone else (an arena, a record). Always
+// NUL-terminated here, so c_str() can be handed to APIs that want one.
+struct StrView {
+  const char* ptr = "";
+  size_t len = 0;
+
+  const char* c_str() const { return ptr; }
+  size_t length() const { return len; }
+  bool empty() const { return len == 0; }
+  bool equals(const char* s, size_t n) const { return n == len && memcmp(ptr, s, n) == 0; }
+  bool operator==(const String& s) const { return equals(s.c_str(), s.length()); }
+  bool operator==(const char* s) const { return equals(s, strlen(s)); }
+  String toString() const { return String(ptr); }
+};
+
+// Bump allocator for strings that are dropped together (one browser view, one
+// generation of the path cache). Storage is inline, so the owner decides whether it
+// lives in .bss or on the heap; reset() is O(1) and never touches the allocator.
+// Strings are referred to by StrRef handles, which stay valid until reset().
+struct StrRef {
+  uint16_t offset = 0;  // 0 is the shared empty string
+  uint16_t length = 0;
+};
+
+template <size_t N>
+class StringArena {
+  static_assert(N >= 2 && N <= 0xFFFF, "StringArena offsets are 16 bit");
+
+ public:
+  StringArena() { reset(); }
+
+  void reset() {
+    buf_[0] = '\0';
+    used_ = 1;
+  }
+
+  // Copies s and a terminator. False (out left empty) when the arena is full.
+  bool add(const char* s, size_t len, StrRef& out) {
+    out = StrRef();
+    if (len == 0) return true;
+    if (len > 0xFFFF || used_ + len + 1 > N) return false;
+    memcpy(buf_ + used_, s, len);
+    buf_[used_ + len] = '\0';
+    out.offset = (uint16_t)used_;
+    out.length = (uint16_t)len;
+    used_ += len + 1;
+    return true;
+  }
+  bool add(const String& s, StrRef& out) { return add(s.c_str(), s.length(), out); }
+
+  StrView view(StrRef ref) const {
+    StrView v;
+    v.ptr = buf_ + ref.offset;
+    v.len = ref.length;
+    return v;
+  }
+
+  size_t used() const { return used_; }
+  static constexpr size_t capacity() { return N; }
+
+ private:
+  char buf_[N];
+  size_t used_ = 1;
+};
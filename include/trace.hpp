@@ -0,0 +1,41 @@
+#pragma once
+
+#include <Arduino.h>
+#include "config.hpp"
+
+// Trace: fixed ring of timestamped begin/end records from the audio and UI hot
+// paths, for finding what stalled when a dropout is heard. Compiled in with
+// -DENABLE_TRACE=1 only; otherwise the macros below expand to nothing.
+// 't' prints the ring over serial; scripts/trace2perfetto.py turns the log
+// into Chrome trace JSON for ui.perfetto.dev.
+
+namespace Trace {
+
+// Ids 2..4 are the library's AUDIO_TRACE_* points (forwarded by audio_trace())
+enum Event : uint8_t {
+  AudioLoop = 1,   // AudioManager::loop -> Audio::loop
+  SdRead = 2,      // arg: bytes requested / read
+  Decode = 3,      // arg: codec / bytes consumed
+  I2sWrite = 4,    // arg: bytes / written, includes the wait for a free DMA buffer
+  UiFrame = 16,    // Task_TFT frame without the frame wait, arg: frame number
+  UiPush = 17,     // sprite.pushSprite to the display
+};
+
+enum Phase : uint8_t { Begin = 0, End = 1 };
+
+// Any task or core; lock-free, overwrites the oldest record when full
+void record(uint8_t event, uint8_t phase, uint32_t arg);
+
+// Print the ring as "T,<us>,<core>,<event>,<phase>,<arg>" lines between
+// "TRACE,begin,..." and "TRACE,end". Recording pauses while printing.
+void dump();
+
+}  // namespace Trace
+
+#if ENABLE_TRACE
+#define TRACE_BEGIN(ev, arg) Trace::record(Trace::ev, Trace::Begin, (arg))
+#define TRACE_END(ev, arg) Trace::record(Trace::ev, Trace::End, (arg))
+#else
+#define TRACE_BEGIN(ev, arg) ((void)0)
+#define TRACE_END(ev, arg) ((void)0)
+#endif
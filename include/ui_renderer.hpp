@@ -31,6 +31,10 @@ void drawMainView(M5Canvas& sprite,
                   int (*getBatteryPercent)(),
                   const lgfx::U8g2font* (*detectAndGetFont)(const String&));
 
+// Render the hidden diagnostics page (heap per memory type, task stack
+// high-water marks) from Diagnostics::latest().
+void drawDiagnosticsPage(M5Canvas& sprite, const AppState& appState, const unsigned short* grays);
+
 }  // namespace UiRenderer
 
 
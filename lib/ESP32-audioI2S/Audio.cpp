@@ -12,6 +12,8 @@
 #include "mp3_decoder/mp3_decoder.h"
 #include "aac_decoder/aac_decoder.h"
 #include "flac_decoder/flac_decoder.h"
+#include "resampler/resampler.h"
+#include "timestretch/timestretch.h"
 
 #ifdef SDFATFS_USED
 fs::SDFATFS SD_SDFAT;
@@ -128,7 +130,8 @@ uint8_t* AudioBuffer::getWritePtr() {
 uint8_t* AudioBuffer::getReadPtr() {
     size_t len = m_endPtr - m_readPtr;
     if(len < m_maxBlockSize) { // be sure the last frame is completed
-        memcpy(m_endPtr, m_buffer, m_maxBlockSize - len);  // cpy from m_buffer to m_endPtr with len
+        size_t reserved = m_f_psram ? m_resBuffSizePSRAM : m_resBuffSizeRAM; // never write past the allocation
+        memcpy(m_endPtr, m_buffer, min(m_maxBlockSize - len, reserved));  // cpy from m_buffer to m_endPtr with len
     }
     return m_readPtr;
 }
@@ -182,6 +185,7 @@ Audio::Audio(bool internalDAC /* = false */, uint8_t channelEnabled /* = I2S_DAC
     m_i2s_config.use_apll             = APLL_DISABLE; // must be disabled in V2.0.1-RC1
     m_i2s_config.tx_desc_auto_clear   = true;   // new in V1.0.1
     m_i2s_config.fixed_mclk           = I2S_PIN_NO_CHANGE;
+    m_i2sEventLock = xSemaphoreCreateMutex();
 
 
     if (internalDAC)  {
@@ -202,7 +206,7 @@ Audio::Audio(bool internalDAC /* = false */, uint8_t channelEnabled /* = I2S_DAC
                 m_i2s_config.communication_format = (i2s_comm_format_t)(I2S_COMM_FORMAT_I2S_MSB);
             #endif
 
-            i2s_driver_install((i2s_port_t)m_i2s_num, &m_i2s_config, 0, NULL);
+            i2s_install();
             i2s_set_dac_mode((i2s_dac_mode_t)m_f_channelEnabled);
             if(m_f_channelEnabled != I2S_DAC_CHANNEL_BOTH_EN) {
                 m_f_forceMono = true;
@@ -220,7 +224,7 @@ Audio::Audio(bool internalDAC /* = false */, uint8_t channelEnabled /* = I2S_DAC
             m_i2s_config.communication_format = (i2s_comm_format_t)(I2S_COMM_FORMAT_I2S | I2S_COMM_FORMAT_I2S_MSB);
         #endif
 
-        i2s_driver_install((i2s_port_t)m_i2s_num, &m_i2s_config, 0, NULL);
+        i2s_install();
         m_f_forceMono = false;
     }
 
@@ -243,6 +247,12 @@ void Audio::setBufsize(int rambuf_sz, int psrambuf_sz) {
     InBuff.setBufsize(rambuf_sz, psrambuf_sz);
 };
 
+void Audio::setFileReadChunk(uint32_t bytes) {
+    // whole sectors only, FATFS then reads straight into InBuff without its sector window
+    bytes &= ~(uint32_t)511;
+    m_fileReadChunk = constrain(bytes, (uint32_t)512, (uint32_t)128 * 1024);
+}
+
 void Audio::initInBuff() {
     if(!InBuff.isInitialized()) {
         size_t size = InBuff.init();
@@ -302,13 +312,19 @@ Audio::~Audio() {
     if(m_playlistBuff) {free(m_playlistBuff); m_playlistBuff = NULL;}
 #endif
     i2s_driver_uninstall((i2s_port_t)m_i2s_num); // #215 free I2S buffer
+    if(m_i2sEventLock) {vSemaphoreDelete(m_i2sEventLock); m_i2sEventLock = NULL;}
     if(m_chbuf) {free(m_chbuf); m_chbuf = NULL;}
+    if(m_seekIndex) {free(m_seekIndex); m_seekIndex = NULL;}
+    if(m_resampler) {delete m_resampler; m_resampler = NULL;}
+    if(m_stretch) {delete m_stretch; m_stretch = NULL;}
 }
 //---------------------------------------------------------------------------------------------------------------------
 void Audio::setDefaults() {
     stopSong();
     initInBuff(); // initialize InputBuffer if not already done
     InBuff.resetBuffer();
+    if(m_stretch) m_stretch->reset();
+    m_limiter.reset();
     MP3Decoder_FreeBuffers();
     FLACDecoder_FreeBuffers();
     AACDecoder_FreeBuffers();
@@ -357,6 +373,19 @@ void Audio::setDefaults() {
     m_audioDataSize = 0;
     m_avr_bitrate = 0;                                      // the same as m_bitrate if CBR, median if VBR
     m_bitRate = 0;                                          // Bitrate still unknown
+    m_f_mp3Toc = false;                                     // Xing/VBRI TOC of the previous file
+    m_f_mp3VbrChecked = false;
+    m_f_seekIndexExact = true;                              // playback starts at frame 0
+    m_mp3SamplesPerFrame = 1152;
+    m_mp3SampleRate = 44100;
+    m_mp3TotalFrames = 0;
+    m_mp3TotalBytes = 0;
+    m_mp3FrameCounter = 0;
+    m_resumeFrameNo = -1;
+    m_resumeTime = -1;
+    m_seekIndexCount = 0;                                   // the allocation is kept for the next file
+    m_seekIndexFrames = 0;
+    m_f_i2sSlotChecked = false;                             // slot width follows the next track
 #ifndef AUDIO_NO_NETWORK
     m_contentlength = 0;                                    // If Content-Length is known, count it
     m_metaint = 0;                                          // No metaint yet
@@ -1264,8 +1293,8 @@ int Audio::read_WAV_Header(uint8_t* data, size_t len) {
         AUDIO_INFO("DataBlockSize: %u", dbs);
         AUDIO_INFO("BitsPerSample: %u", bps);
 
-        if((bps != 8) && (bps != 16)){
-            AUDIO_INFO("BitsPerSample is %u,  must be 8 or 16" , bps);
+        if((bps != 8) && (bps != 16) && (bps != 24) && (bps != 32)){
+            AUDIO_INFO("BitsPerSample is %u,  must be 8, 16, 24 or 32" , bps);
             stopSong();
             return -1;
         }
@@ -1274,7 +1303,7 @@ int Audio::read_WAV_Header(uint8_t* data, size_t len) {
             stopSong();
             return -1;
         }
-        if(fc != 1) {
+        if(fc != 1 && fc != 0xFFFE) { // 0xFFFE: WAVE_FORMAT_EXTENSIBLE, used by most 24 bit files
             AUDIO_INFO("format code is not 1 (PCM)");
             stopSong();
             return -1 ; //false;
@@ -1437,8 +1466,8 @@ int Audio::read_FLAC_Header(uint8_t *data, size_t len) {
         uint8_t bps = (nextval & 0x01) << 4;
         bps += (*(data +16) >> 4) + 1;
         m_flacBitsPerSample = bps;
-        if((bps != 8) && (bps != 16)){
-            log_e("bits per sample must be 8 or 16, is %i", bps);
+        if((bps != 8) && (bps != 16) && (bps != 20) && (bps != 24)){
+            log_e("bits per sample must be 8, 16, 20 or 24, is %i", bps);
             stopSong();
             return -1;
         }
@@ -2228,8 +2257,8 @@ int Audio::read_OGG_Header(uint8_t *data, size_t len){
         bps += (*(data +i) >> 4) + 1;
         i++;
         m_flacBitsPerSample = bps;
-        if((bps != 8) && (bps != 16)){
-            log_e("bits per sample must be 8 or 16, is %i", bps);
+        if((bps != 8) && (bps != 16) && (bps != 20) && (bps != 24)){
+            log_e("bits per sample must be 8, 16, 20 or 24, is %i", bps);
             stopSong();
             return -1;
         }
@@ -2344,9 +2373,15 @@ void Audio::playI2Sremains() { // returns true if all dma_buffs flushed
     if(getBitsPerSample() > 8) memset(m_outBuff,   0, sizeof(m_outBuff));     //Clear OutputBuffer (signed)
     else                       memset(m_outBuff, 128, sizeof(m_outBuff));     //Clear OutputBuffer (unsigned, PCM 8u)
 
-    m_validSamples = m_i2s_config.dma_buf_len * m_i2s_config.dma_buf_count;
-    while(m_validSamples) {
-        playChunk();
+    // the DMA holds more frames than m_outBuff, so push the silence in pieces that stay inside it
+    uint32_t remains = m_i2s_config.dma_buf_len * m_i2s_config.dma_buf_count;
+    const uint32_t maxFrames = sizeof(m_outBuff) / (getBitsPerSample() > 16 ? 8 : 4);
+    while(remains) {
+        m_validSamples = min(remains, maxFrames);
+        remains -= m_validSamples;
+        while(m_validSamples) {
+            playChunk();
+        }
     }
     i2s_zero_dma_buffer((i2s_port_t) m_i2s_num);
     return;
@@ -2370,88 +2405,62 @@ bool Audio::pauseResume() {
 }
 //---------------------------------------------------------------------------------------------------------------------
 bool Audio::playChunk() {
-    // If we've got data, try and pump it out..
+    // Decoded 8/16 bit PCM in m_outBuff -> Q23 frames (mixSample), handed to the limiter in blocks
+    if(!m_f_i2sSlotChecked) updateI2SSlotBits();
+    if(getBitsPerSample() > 16) return playChunk32();
+    if(getBitsPerSample() != 8 && getBitsPerSample() != 16) {
+        log_e("BitsPer Sample must be 8 or 16!");
+        m_validSamples = 0;
+        stopSong();
+        return false;
+    }
+    const bool eight = getBitsPerSample() == 8;
+    const bool mono = getChannels() == 1;
     int16_t sample[2];
-    if(getBitsPerSample() == 8) {
-        if(getChannels() == 1) {
-            while(m_validSamples) {
-                uint8_t x =  m_outBuff[m_curSample] & 0x00FF;
-                uint8_t y = (m_outBuff[m_curSample] & 0xFF00) >> 8;
-                sample[LEFTCHANNEL]  = x;
-                sample[RIGHTCHANNEL] = x;
-                while(1) {
-                    if(playSample(sample)) break;
-                } // Can't send?
-                sample[LEFTCHANNEL]  = y;
-                sample[RIGHTCHANNEL] = y;
-                while(1) {
-                    if(playSample(sample)) break;
-                } // Can't send?
-                m_validSamples--;
-                m_curSample++;
-            }
+    int32_t out[2 * LIMITER_BLOCK];
+    size_t n = 0;
+    bool second = false;                                // 8 bit mono: the high byte of the word is next
+    bool ok = true;
+    while(m_validSamples) {
+        const int16_t w = m_outBuff[(mono || eight) ? m_curSample : m_curSample * 2];
+        if(eight && mono) {                             // one word holds two frames
+            sample[LEFTCHANNEL] = sample[RIGHTCHANNEL] = second ? (w & 0xFF00) >> 8 : w & 0x00FF;
+            second = !second;
         }
-        if(getChannels() == 2) {
-            while(m_validSamples) {
-                uint8_t x =  m_outBuff[m_curSample] & 0x00FF;
-                uint8_t y = (m_outBuff[m_curSample] & 0xFF00) >> 8;
-                if(!m_f_forceMono) { // stereo mode
-                    sample[LEFTCHANNEL]  = x;
-                    sample[RIGHTCHANNEL] = y;
-                }
-                else { // force mono
-                    uint8_t xy = (x + y) / 2;
-                    sample[LEFTCHANNEL]  = xy;
-                    sample[RIGHTCHANNEL] = xy;
-                }
-
-                while(1) {
-                    if(playSample(sample)) break;
-                } // Can't send?
-                m_validSamples--;
-                m_curSample++;
-            }
+        else if(eight) {
+            uint8_t x = w & 0x00FF;
+            uint8_t y = (w & 0xFF00) >> 8;
+            sample[LEFTCHANNEL]  = m_f_forceMono ? (x + y) / 2 : x;
+            sample[RIGHTCHANNEL] = m_f_forceMono ? (x + y) / 2 : y;
         }
-        m_curSample = 0;
-        return true;
-    }
-    if(getBitsPerSample() == 16) {
-        if(getChannels() == 1) {
-            while(m_validSamples) {
-                sample[LEFTCHANNEL]  = m_outBuff[m_curSample];
-                sample[RIGHTCHANNEL] = m_outBuff[m_curSample];
-                if(!playSample(sample)) {
-                    log_e("can't send");
-                    return false;
-                } // Can't send
-                m_validSamples--;
-                m_curSample++;
-            }
+        else if(mono) {
+            sample[LEFTCHANNEL] = sample[RIGHTCHANNEL] = w;
         }
-        if(getChannels() == 2) {
-            m_curSample = 0;
-            while(m_validSamples) {
-                if(!m_f_forceMono) { // stereo mode
-                    sample[LEFTCHANNEL]  = m_outBuff[m_curSample * 2];
-                    sample[RIGHTCHANNEL] = m_outBuff[m_curSample * 2 + 1];
-                }
-                else { // mono mode, #100
-                    int16_t xy = (m_outBuff[m_curSample * 2] + m_outBuff[m_curSample * 2 + 1]) / 2;
-                    sample[LEFTCHANNEL] = xy;
-                    sample[RIGHTCHANNEL] = xy;
-                }
-                playSample(sample);
-                m_validSamples--;
-                m_curSample++;
-            }
+        else if(!m_f_forceMono) { // stereo mode
+            sample[LEFTCHANNEL]  = w;
+            sample[RIGHTCHANNEL] = m_outBuff[m_curSample * 2 + 1];
+        }
+        else { // mono mode, #100
+            sample[LEFTCHANNEL] = sample[RIGHTCHANNEL] = (w + m_outBuff[m_curSample * 2 + 1]) / 2;
+        }
+        if(!second) {
+            m_validSamples--;
+            m_curSample++;
+        }
+        mixSample(sample, out + 2 * n);
+        if(++n == LIMITER_BLOCK) {
+            ok = i2s_limitFrames(out, n, false);
+            n = 0;
+            if(!ok) break;
         }
-        m_curSample = 0;
-        return true;
     }
-    log_e("BitsPer Sample must be 8 or 16!");
-    m_validSamples = 0;
-    stopSong();
-    return false;
+    if(ok && n) ok = i2s_limitFrames(out, n, false);
+    m_curSample = 0;
+    if(!ok) {                                           // the limiter holds what it took, drop the rest
+        log_e("can't send");
+        m_validSamples = 0;
+    }
+    return ok;
 }
 //---------------------------------------------------------------------------------------------------------------------
 void Audio::loop() {
@@ -2953,24 +2962,33 @@ void Audio::processLocalFile() {
         return;
     }
 
-    availableBytes = 16 * 1024; // set some large value
-
-    availableBytes = min(availableBytes, InBuff.writeSpace());
-    availableBytes = min(availableBytes, audiofile.size() - byteCounter);
+    // While playing, read only when a whole chunk (or half the ring) is free or the buffer runs low, so the
+    // card sees few large transfers instead of a top-up per loop(). Reads end on a 512 byte file offset.
+    uint32_t fileEnd = audiofile.size();
 #ifndef AUDIO_NO_NETWORK
-    if(m_contentlength){
-        if(m_contentlength > getFilePos()) availableBytes = min(availableBytes, m_contentlength - getFilePos());
-    }
+    if(m_contentlength > byteCounter && m_contentlength < fileEnd) fileEnd = m_contentlength;
 #endif
-    if(m_audioDataSize){
-        availableBytes = min(availableBytes, m_audioDataSize + m_audioDataStart - byteCounter);
-    }
-
-    int32_t bytesAddedToBuffer = audiofile.read(InBuff.getWritePtr(), availableBytes);
-
-    if(bytesAddedToBuffer > 0) {
+    if(m_audioDataSize && m_audioDataSize + m_audioDataStart < fileEnd) fileEnd = m_audioDataSize + m_audioDataStart;
+    uint32_t batch = min(m_fileReadChunk, (uint32_t)(InBuff.getBufsize() / 2));
+    bool f_read = !f_stream || InBuff.freeSpace() >= batch || InBuff.bufferFilled() < 2 * maxFrameSize ||
+                  (fileEnd > byteCounter && fileEnd - byteCounter <= InBuff.freeSpace());
+    uint32_t chunkLeft = f_read ? m_fileReadChunk : 0;
+
+    for(int pass = 0; pass < 2 && chunkLeft; pass++) { // second pass continues after the ring wrapped
+        availableBytes = min(chunkLeft, (uint32_t)InBuff.writeSpace());
+        availableBytes = min(availableBytes, (fileEnd > byteCounter) ? fileEnd - byteCounter : 0);
+        uint32_t endPos = audiofile.position() + availableBytes;
+        if(availableBytes > 512 && (endPos % 512) && endPos < fileEnd) availableBytes -= endPos % 512;
+        if(!availableBytes) break;
+
+        AUDIO_TRACE(AUDIO_TRACE_SD_READ, true, availableBytes);
+        int32_t bytesAddedToBuffer = audiofile.read(InBuff.getWritePtr(), availableBytes);
+        AUDIO_TRACE(AUDIO_TRACE_SD_READ, false, bytesAddedToBuffer > 0 ? bytesAddedToBuffer : 0);
+        if(bytesAddedToBuffer <= 0) break;
         byteCounter += bytesAddedToBuffer;  // Pull request #42
         InBuff.bytesWritten(bytesAddedToBuffer);
+        chunkLeft -= bytesAddedToBuffer;
+        if(InBuff.getWritePos() != 0) break;   // no wrap, nothing more to gain
     }
     if(!f_stream){
         if(m_controlCounter != 100) {
@@ -2988,6 +3006,7 @@ void Audio::processLocalFile() {
             f_stream = true;
             AUDIO_INFO("stream ready");
             if(m_f_Log) log_i("m_audioDataStart %d", m_audioDataStart);
+            if(m_codec == CODEC_MP3 && !m_f_mp3VbrChecked) mp3_readVbrHeader();
         }
     }
 
@@ -2997,11 +3016,51 @@ void Audio::processLocalFile() {
         if(m_codec == CODEC_M4A) m_resumeFilePos = m4a_correctResumeFilePos(m_resumeFilePos);
         if(m_codec == CODEC_WAV) {while((m_resumeFilePos % 4) != 0) m_resumeFilePos++;} // must be divisible by four
         if(m_codec == CODEC_FLAC) {m_resumeFilePos = flac_correctResumeFilePos(m_resumeFilePos); FLACDecoderReset();}
-        if(m_codec == CODEC_MP3) {m_resumeFilePos = mp3_correctResumeFilePos(m_resumeFilePos);}
-        if(m_avr_bitrate) m_audioCurrentTime = ((m_resumeFilePos - m_audioDataStart) / m_avr_bitrate) * 8;
-        audiofile.seek(m_resumeFilePos);
-        InBuff.resetBuffer();
-        byteCounter = m_resumeFilePos;
+        if(m_codec == CODEC_MP3) {
+            // one buffered read, then skip to the first validated frame header inside it
+            InBuff.resetBuffer();
+            audiofile.seek(m_resumeFilePos);
+            uint32_t len = min((uint32_t)InBuff.writeSpace(), (uint32_t)(m_file_size - m_resumeFilePos));
+            int32_t  n = audiofile.read(InBuff.getWritePtr(), len);
+            if(n < 0) n = 0;
+            InBuff.bytesWritten(n);
+            int skip = mp3_findValidSync(InBuff.getReadPtr(), InBuff.bufferFilled());
+            if(skip < 0) skip = 0; // let the decoder resync
+            InBuff.bytesWasRead(skip);
+            byteCounter = m_resumeFilePos + n;
+            uint32_t requestedPos = m_resumeFilePos;
+            m_resumeFilePos += skip;
+            if(m_resumeFilePos == m_audioDataStart){
+                m_mp3FrameCounter = 0; m_resumeTime = 0; m_f_seekIndexExact = true;
+            }
+            else if(m_resumeFrameNo >= 0 && m_resumeFilePos == requestedPos){ // landed on an indexed frame
+                m_mp3FrameCounter = m_resumeFrameNo; m_f_seekIndexExact = true;
+            }
+            else {
+                if(m_resumeFrameNo >= 0) {m_seekIndexCount = 0; log_w("seek index does not match the file, dropped");}
+                if(m_resumeTime < 0 && m_avr_bitrate) m_resumeTime = ((m_resumeFilePos - m_audioDataStart) / m_avr_bitrate) * 8;
+                m_mp3FrameCounter = (m_resumeTime > 0) ? (uint32_t)(m_resumeTime * m_mp3SampleRate / m_mp3SamplesPerFrame) : 0;
+                m_f_seekIndexExact = false;
+            }
+            if(m_resumeTime >= 0) m_audioCurrentTime = m_resumeTime;
+            else m_audioCurrentTime = (float)m_mp3FrameCounter * m_mp3SamplesPerFrame / m_mp3SampleRate;
+            m_resumeFrameNo = -1;
+            m_resumeTime = -1;
+        }
+        else {
+            if(m_avr_bitrate) m_audioCurrentTime = ((m_resumeFilePos - m_audioDataStart) / m_avr_bitrate) * 8;
+            audiofile.seek(m_resumeFilePos);
+            InBuff.resetBuffer();
+            byteCounter = m_resumeFilePos;
+        }
+        f_fileDataComplete = false;
+        // drop the PCM of the old position still queued in DMA, then ramp the new one in
+        i2s_zero_dma_buffer((i2s_port_t)m_i2s_num);
+        if(m_stretch) m_stretch->reset();
+        m_limiter.reset();
+        m_fadeInSamples = pcm_fadeInFrames(getSampleRate());
+        m_fadeInPos = 0;
+        m_f_resumeProbe = true;
 
         if(m_f_Log){
             log_i("m_resumeFilePos %d", m_resumeFilePos);
@@ -3046,6 +3105,7 @@ void Audio::processLocalFile() {
         char *afn =strdup(audiofile.name()); // store temporary the name
 #endif
 
+        if(m_codec == CODEC_MP3 && m_f_seekIndexExact) m_seekIndexFrames = m_mp3FrameCounter; // index is complete
         stopSong();
         if(m_codec == CODEC_MP3)   MP3Decoder_FreeBuffers();
         if(m_codec == CODEC_AAC)   AACDecoder_FreeBuffers();
@@ -4125,8 +4185,11 @@ int Audio::sendBytes(uint8_t* data, size_t len) {
     int ret = 0;
     int bytesDecoded = 0;
 
+    AUDIO_TRACE(AUDIO_TRACE_DECODE, true, m_codec);
     switch(m_codec){
-        case CODEC_WAV:      memmove(m_outBuff, data , len); //copy len data in outbuff and set validsamples and bytesdecoded=len
+        case CODEC_WAV:      if(wav_fastPathOk(data)) {wav_playFused(data, len); m_validSamples = 0; bytesLeft = 0; break;}
+                             if(getBitsPerSample() > 16) {bytesLeft = wav_unpackWide(data, len); break;}
+                             memmove(m_outBuff, data , len); //copy len data in outbuff and set validsamples and bytesdecoded=len
                              if(getBitsPerSample() == 16) m_validSamples = len / (2 * getChannels());
                              if(getBitsPerSample() == 8 ) m_validSamples = len / 2;
                              bytesLeft = 0; break;
@@ -4139,6 +4202,7 @@ int Audio::sendBytes(uint8_t* data, size_t len) {
     }
 
     bytesDecoded = len - bytesLeft;
+    AUDIO_TRACE(AUDIO_TRACE_DECODE, false, bytesDecoded);
     if(bytesDecoded == 0 && ret == 0){ // unlikely framesize
             if(audio_info) audio_info("framesize is 0, start decoding again");
             m_f_playing = false; // seek for new syncword
@@ -4146,6 +4210,9 @@ int Audio::sendBytes(uint8_t* data, size_t len) {
         // so skip two sync bytes and seek for next
         return 1;
     }
+    if(m_codec == CODEC_MP3 && getDatamode() == AUDIO_LOCALFILE){ // data is the InBuff read pointer
+        mp3_updateSeekIndex(getFilePos() - InBuff.bufferFilled(), ret);
+    }
     if(ret < 0) { // Error, skip the frame...
         if(m_f_Log) if(m_codec == CODEC_M4A){log_i("begin not found"); return 1;}
         i2s_zero_dma_buffer((i2s_port_t)m_i2s_num);
@@ -4170,6 +4237,7 @@ int Audio::sendBytes(uint8_t* data, size_t len) {
             if(m_codec == CODEC_MP3){
                 setChannels(MP3GetChannels());
                 setSampleRate(MP3GetSampRate());
+                m_mp3SampleRate = MP3GetSampRate();
                 setBitsPerSample(MP3GetBitsPerSample());
                 setBitrate(MP3GetBitrate());
             }
@@ -4199,7 +4267,7 @@ int Audio::sendBytes(uint8_t* data, size_t len) {
     }
     compute_audioCurrentTime(bytesDecoded);
 
-    if(audio_process_extern){
+    if(audio_process_extern && getBitsPerSample() <= 16){ // the callback takes int16 frames
         bool continueI2S = false;
         audio_process_extern(m_outBuff, m_validSamples, &continueI2S);
         if(!continueI2S){
@@ -4263,6 +4331,9 @@ void Audio::compute_audioCurrentTime(int bd) {
         }
     }
     m_audioCurrentTime += ((float)bd / m_avr_bitrate) * 8;
+    if(m_codec == CODEC_MP3 && getDatamode() == AUDIO_LOCALFILE && m_mp3SampleRate){ // frame accurate, also for VBR
+        m_audioCurrentTime = (float)m_mp3FrameCounter * m_mp3SamplesPerFrame / m_mp3SampleRate;
+    }
 }
 //---------------------------------------------------------------------------------------------------------------------
 void Audio::printDecodeError(int r) {
@@ -4347,6 +4418,7 @@ bool Audio::setPinout(uint8_t BCLK, uint8_t LRC, uint8_t DOUT, int8_t DIN, int8_
 #endif
 
     const esp_err_t result = i2s_set_pin((i2s_port_t) m_i2s_num, &m_pin_config);
+    m_f_i2sPinsSet = true;
     return (result == ESP_OK);
 }
 //---------------------------------------------------------------------------------------------------------------------
@@ -4371,6 +4443,10 @@ uint32_t Audio::getAudioFileDuration() {
     if(m_streamType == ST_WEBFILE)   {if(!m_contentlength) return 0;}
 #endif
 
+    if(m_codec == CODEC_MP3 && getDatamode() == AUDIO_LOCALFILE && m_mp3SampleRate){
+        uint32_t frames = m_mp3TotalFrames ? m_mp3TotalFrames : m_seekIndexFrames; // Xing/VBRI or a complete index
+        if(frames) {m_audioFileDuration = (uint64_t)frames * m_mp3SamplesPerFrame / m_mp3SampleRate; return m_audioFileDuration;}
+    }
     if     (m_avr_bitrate && m_codec == CODEC_MP3)   m_audioFileDuration = 8 * (m_audioDataSize / m_avr_bitrate); // #289
     else if(m_avr_bitrate && m_codec == CODEC_WAV)   m_audioFileDuration = 8 * (m_audioDataSize / m_avr_bitrate);
     else if(m_avr_bitrate && m_codec == CODEC_M4A)   m_audioFileDuration = 8 * (m_audioDataSize / m_avr_bitrate);
@@ -4389,6 +4465,7 @@ bool Audio::setAudioPlayPosition(uint16_t sec){
     // e.g. setAudioPlayPosition(300) sets the pointer at pos 5 min
     // works only with format mp3 or wav
     if(m_codec == CODEC_M4A)  return false;
+    if(m_codec == CODEC_MP3 && getDatamode() == AUDIO_LOCALFILE) return mp3_seekToTime(sec);
     if(sec > getAudioFileDuration()) sec = getAudioFileDuration();
     uint32_t filepos = m_audioDataStart + (m_avr_bitrate * sec / 8);
 
@@ -4405,6 +4482,11 @@ bool Audio::setTimeOffset(int sec){
     // fast forward or rewind the current position in seconds
     // audiosource must be a mp3, aac or wav file
 
+    if(m_codec == CODEC_MP3 && audiofile && getDatamode() == AUDIO_LOCALFILE){
+        int32_t target = (int32_t)getAudioCurrentTime() + sec;
+        if(target < 0) target = 0;
+        return mp3_seekToTime(target);
+    }
     if(!audiofile || !m_avr_bitrate) return false;
 
     uint32_t oneSec  = m_avr_bitrate / 8;                   // bytes decoded in one sec
@@ -4428,6 +4510,8 @@ bool Audio::setFilePos(uint32_t pos) {
     if(pos < m_audioDataStart) pos = m_audioDataStart; // issue #96
     if(pos > m_file_size) pos = m_file_size;
     m_resumeFilePos = pos;
+    m_resumeFrameNo = -1;   // a raw byte position, the frame is unknown
+    m_resumeTime = -1;
     return true;
 }
 //---------------------------------------------------------------------------------------------------------------------
@@ -4435,26 +4519,83 @@ bool Audio::audioFileSeek(const float speed) {
     // 0.5 is half speed
     // 1.0 is normal speed
     // 1.5 is one and half speed
-    if((speed > 1.5f) || (speed < 0.25f)) return false;
-
-    uint32_t srate = getSampleRate() * speed;
-    i2s_set_sample_rates((i2s_port_t)m_i2s_num, srate);
+    // used to retune the I2S clock, which shifted the pitch as well
+    return setPlaybackSpeed(speed);
+}
+//---------------------------------------------------------------------------------------------------------------------
+bool Audio::setPlaybackSpeed(float speed) {
+    if((speed > 2.0f) || (speed < 0.5f)) return false;
+    if(!m_stretch) {
+        if(speed == 1.0f) return true;
+        if(m_f_internalDAC) return false;               // the DAC offset is added before the stretcher
+        m_stretch = new TimeStretch();
+        if(!m_stretch->setSampleRate(getSampleRate())) {
+            log_e("time stretch: not enough memory");
+            delete m_stretch; m_stretch = NULL;
+            return false;
+        }
+    }
+    m_stretch->setSpeed(speed);
+    if(m_i2sSlotBits != 16) m_f_i2sSlotChecked = false; // back to 16 bit slots with the next chunk
+    AUDIO_INFO("playback speed %.2f", speed);
     return true;
 }
+float Audio::getPlaybackSpeed() {
+    return m_stretch ? m_stretch->getSpeed() : 1.0f;
+}
+//---------------------------------------------------------------------------------------------------------------------
+void Audio::setReplayGain(float gainDb, float peak) {
+    float g = powf(10.0f, gainDb / 20.0f);
+    if(peak > 0 && g * peak > 1.0f) g = 1.0f / peak;     // peak protection, no clipping from the gain itself
+    g = constrain(g, 0.0f, 2.0f);
+    m_rgQ14 = (uint16_t)(g * 16384 + 0.5f);
+    updateVolQ14();
+}
 //---------------------------------------------------------------------------------------------------------------------
 bool Audio::setSampleRate(uint32_t sampRate) {
     if(!sampRate) sampRate = 16000; // fuse, if there is no value -> set default #209
-    i2s_set_sample_rates((i2s_port_t)m_i2s_num, sampRate);
+    if(m_resampler) m_resampler->setRatio(sampRate, m_outputRate);
+    else setI2SRate(sampRate);
+    if(m_stretch && !m_stretch->setSampleRate(sampRate)) {delete m_stretch; m_stretch = NULL;}
     m_sampleRate = sampRate;
     IIR_calculateCoefficients(m_gain0, m_gain1, m_gain2); // must be recalculated after each samplerate change
     return true;
 }
+void Audio::setI2SRate(uint32_t hz) {
+    // i2s_set_sample_rates() stops and restarts the clocks, skip it if nothing changes
+    if(hz == m_i2s_config.sample_rate) return;
+    i2s_set_sample_rates((i2s_port_t)m_i2s_num, hz);
+    m_i2s_config.sample_rate = hz;                      // also used if the driver is reinstalled
+}
+//---------------------------------------------------------------------------------------------------------------------
+bool Audio::setOutputSampleRate(uint32_t hz, uint8_t quality) {
+    if(!hz) {
+        if(m_resampler) {delete m_resampler; m_resampler = NULL;}
+        m_outputRate = 0;
+        setI2SRate(getSampleRate());
+        m_f_i2sSlotChecked = false;                     // > 16 bit tracks may use 32 bit slots again
+        return true;
+    }
+    if(m_f_internalDAC) return false;                   // the DAC offset is added before the resampler
+    if(!m_resampler) m_resampler = new Resampler();
+    if(!m_resampler->setQuality(quality)) {
+        log_e("resampler: not enough memory");
+        delete m_resampler; m_resampler = NULL; m_outputRate = 0;
+        return false;
+    }
+    m_outputRate = hz;
+    m_resampler->setRatio(getSampleRate(), hz);
+    if(m_i2sSlotBits != 16) m_f_i2sSlotChecked = false; // back to 16 bit slots with the next chunk
+    setI2SRate(hz);
+    AUDIO_INFO("resampling to %u Hz, %u taps", hz, m_resampler->getTaps());
+    return true;
+}
 uint32_t Audio::getSampleRate(){
     return m_sampleRate;
 }
 //---------------------------------------------------------------------------------------------------------------------
 bool Audio::setBitsPerSample(int bits) {
-    if((bits != 16) && (bits != 8)) return false;
+    if((bits != 8) && (bits != 16) && (bits != 20) && (bits != 24) && (bits != 32)) return false;
     m_bitsPerSample = bits;
     return true;
 }
@@ -4511,53 +4652,292 @@ void Audio::setI2SCommFMT_LSB(bool commFMT) {
 
     }
     AUDIO_INFO("commFMT = %i", m_i2s_config.communication_format);
-    i2s_driver_uninstall((i2s_port_t)m_i2s_num);
-    i2s_driver_install  ((i2s_port_t)m_i2s_num, &m_i2s_config, 0, NULL);
+    i2s_install();
 }
 //---------------------------------------------------------------------------------------------------------------------
-bool Audio::playSample(int16_t sample[2]) {
-
+void Audio::mixSample(int16_t sample[2], int32_t s[2]) {
+    // One 8/16 bit frame to Q23: EQ, seek fade-in, volume. EQ and volume/ReplayGain boosts get room above
+    // full scale, the limiter brings them back.
     if (getBitsPerSample() == 8) { // Upsample from unsigned 8 bits to signed 16 bits
         sample[LEFTCHANNEL]  = ((sample[LEFTCHANNEL]  & 0xff) -128) << 8;
         sample[RIGHTCHANNEL] = ((sample[RIGHTCHANNEL] & 0xff) -128) << 8;
     }
 
-    sample[LEFTCHANNEL]  = sample[LEFTCHANNEL]  >> 1; // half Vin so we can boost up to 6dB in filters
-    sample[RIGHTCHANNEL] = sample[RIGHTCHANNEL] >> 1;
-
-    // Filterchain, can commented out if not used
-    sample = IIR_filterChain0(sample);
-    sample = IIR_filterChain1(sample);
-    sample = IIR_filterChain2(sample);
-    //-------------------------------------------
-
-    uint32_t s32 = Gain(sample); // vosample2lume;
-
-    if(audio_process_i2s){
-        // process audio sample just before writing to i2s
-        bool continueI2S = false;
-        audio_process_i2s(&s32, &continueI2S);
-        if(!continueI2S){
-            return true;
+    s[LEFTCHANNEL]  = (int32_t)sample[LEFTCHANNEL]  << 8;
+    s[RIGHTCHANNEL] = (int32_t)sample[RIGHTCHANNEL] << 8;
+    if(m_gain0 || m_gain1 || m_gain2) {
+        float f[2] = {(float)sample[LEFTCHANNEL], (float)sample[RIGHTCHANNEL]}; // filter state is in 16 bit units
+        IIR_filterChain32(f);
+        for(int c = 0; c < 2; c++) {
+            float v = f[c] * 256.0f;
+            s[c] = v > 2147483520.0f ? INT32_MAX : (v < -2147483520.0f ? INT32_MIN : (int32_t)v);
         }
     }
 
+    pcm_fadeInQ23(s, m_fadeInPos, m_fadeInSamples); // linear ramp after a seek, avoids a click at the new position
+    if(m_f_resumeProbe){m_f_resumeProbe = false; m_resumeMillis = millis();}
+
+    Gain(s); // volume, balance, ReplayGain
+}
+//---------------------------------------------------------------------------------------------------------------------
+bool Audio::wav_fastPathOk(const uint8_t* data) {
+    // 16 bit stereo with nothing in mixSample() that changes the samples besides the volume
+    if(getBitsPerSample() != 16 || getChannels() != 2) return false;
+    if(m_f_forceMono || m_f_internalDAC || m_balance) return false;
+    if(m_gain0 || m_gain1 || m_gain2) return false;                     // EQ active
+    if(audio_process_extern || audio_process_i2s) return false;        // user wants the samples
+    if(m_fadeInPos < m_fadeInSamples) return false;                    // seek ramp runs per sample
+    return ((uintptr_t)data & 1) == 0;                                  // int16 access
+}
+//---------------------------------------------------------------------------------------------------------------------
+void Audio::wav_playFused(uint8_t* data, size_t len) {
+    // The result mixSample() would produce (volume, Q23), one limiter block at a time instead of per frame.
+    size_t frames = len / 4;
+    const int16_t* s = (const int16_t*)data;
+    const int32_t vol = m_volQ14;
+    int32_t q[2 * LIMITER_BLOCK];
+    if(m_f_resumeProbe){m_f_resumeProbe = false; m_resumeMillis = millis();}
+    while(frames) {
+        size_t n = min(frames, (size_t)LIMITER_BLOCK);
+        pcm_scaleBlockQ23(s, n, vol, q);
+        s += 2 * n;
+        frames -= n;
+        if(!i2s_limitFrames(q, n, false)) break;
+    }
+}
+//---------------------------------------------------------------------------------------------------------------------
+size_t Audio::wav_unpackWide(const uint8_t* data, size_t len) {
+    // 24/32 bit little endian PCM -> left-justified int32 in m_outBuff, whole frames only; returns bytes left over
+    const uint8_t bytesPerSample = getBitsPerSample() / 8;
+    const uint8_t ch = getChannels();
+    size_t frames = len / (bytesPerSample * ch);
+    frames = min(frames, sizeof(m_outBuff) / (4 * ch));
+    int32_t* out = (int32_t*)m_outBuff;
+    const size_t n = frames * ch;
+    if(bytesPerSample == 3) {
+        for(size_t i = 0; i < n; i++, data += 3) out[i] = (int32_t)((uint32_t)data[0] << 8 | (uint32_t)data[1] << 16 | (uint32_t)data[2] << 24);
+    }
+    else {
+        for(size_t i = 0; i < n; i++, data += 4) out[i] = (int32_t)((uint32_t)data[0] | (uint32_t)data[1] << 8 | (uint32_t)data[2] << 16 | (uint32_t)data[3] << 24);
+    }
+    m_validSamples = frames;
+    return len - n * bytesPerSample;
+}
+//---------------------------------------------------------------------------------------------------------------------
+void Audio::i2s_install() {
+    // (re)install with an event queue: TX_DONE per finished DMA buffer, TX_Q_OVF when the DMA ran dry.
+    // The lock keeps the queue alive while waitI2sEvent() is blocked on it.
+    m_f_i2sReinstall = true;
+    if(m_i2sEventLock) xSemaphoreTake(m_i2sEventLock, portMAX_DELAY);
+    if(m_f_i2sInstalled) i2s_driver_uninstall((i2s_port_t)m_i2s_num);
+    m_i2sEventQueue = NULL;
+    m_f_i2sInstalled = i2s_driver_install((i2s_port_t)m_i2s_num, &m_i2s_config,
+                                          2 * m_i2s_config.dma_buf_count + 4, &m_i2sEventQueue) == ESP_OK;
+    if(m_i2sEventLock) xSemaphoreGive(m_i2sEventLock);
+    m_f_i2sReinstall = false;
+}
+//---------------------------------------------------------------------------------------------------------------------
+bool Audio::setI2sDmaBuffers(uint16_t count, uint16_t len) {
+    if(count < 2 || len < 8 || len > 1024) return false;
+    if(count == m_i2s_config.dma_buf_count && len == m_i2s_config.dma_buf_len) return true;
+    const int oldCount = m_i2s_config.dma_buf_count, oldLen = m_i2s_config.dma_buf_len;
+    m_i2s_config.dma_buf_count = count;
+    m_i2s_config.dma_buf_len   = len;
+    i2s_install();
+    bool ok = m_f_i2sInstalled;
+    if(!ok) {
+        log_e("I2S: no memory for %u x %u DMA buffers", count, len);
+        m_i2s_config.dma_buf_count = oldCount;
+        m_i2s_config.dma_buf_len   = oldLen;
+        i2s_install();
+    }
+    // the clock comes from m_i2s_config (rate, slot width), the routing has to be set again
     if(m_f_internalDAC) {
-        s32 += 0x80008000;
+    #ifdef CONFIG_IDF_TARGET_ESP32
+        i2s_set_dac_mode((i2s_dac_mode_t)m_f_channelEnabled);
+    #endif
     }
-    m_i2s_bytesWritten = 0;
-    esp_err_t err = i2s_write((i2s_port_t) m_i2s_num, (const char*) &s32, sizeof(uint32_t), &m_i2s_bytesWritten, 100);
-    if(err != ESP_OK) {
-        log_e("ESP32 Errorcode %i", err);
-        return false;
+    else if(m_f_i2sPinsSet) i2s_set_pin((i2s_port_t)m_i2s_num, &m_pin_config);
+    i2s_zero_dma_buffer((i2s_port_t)m_i2s_num);
+    AUDIO_INFO("I2S DMA: %u x %u frames", m_i2s_config.dma_buf_count, m_i2s_config.dma_buf_len);
+    return ok;
+}
+//---------------------------------------------------------------------------------------------------------------------
+bool Audio::waitI2sEvent(i2s_event_t* ev, TickType_t timeout) {
+    if(m_f_i2sReinstall || !m_i2sEventLock) {vTaskDelay(timeout); return false;}  // let i2s_install() take the lock
+    if(xSemaphoreTake(m_i2sEventLock, timeout) != pdTRUE) return false;
+    bool ok = m_i2sEventQueue && xQueueReceive(m_i2sEventQueue, ev, timeout) == pdTRUE;
+    xSemaphoreGive(m_i2sEventLock);
+    return ok;
+}
+//---------------------------------------------------------------------------------------------------------------------
+bool Audio::i2s_writeAll(const void* buf, size_t bytes) {
+    size_t done = 0;
+    AUDIO_TRACE(AUDIO_TRACE_I2S_WRITE, true, bytes);    // the span includes waiting for a free DMA buffer
+    while(done < bytes) {
+        size_t written = 0;
+        esp_err_t err = i2s_write((i2s_port_t) m_i2s_num, (const uint8_t*)buf + done, bytes - done, &written, 100);
+        m_i2sBytesTotal += written;
+        if(err != ESP_OK) {log_e("ESP32 Errorcode %i", err); break;}
+        if(!written) {log_e("Can't stuff any more in I2S..."); break;}
+        done += written;
+    }
+    AUDIO_TRACE(AUDIO_TRACE_I2S_WRITE, false, done);
+    return done == bytes;
+}
+//---------------------------------------------------------------------------------------------------------------------
+bool Audio::i2s_writeFrames(const void* buf, size_t frames) {
+    // packed 16 bit stereo frames: time stretch, resampler, I2S
+    if(!m_stretch) return i2s_resampleFrames(buf, frames);
+    if(m_stretch->isBypassed() && m_stretch->getSpeed() == 1.0f) {   // drained after going back to 1.0
+        delete m_stretch; m_stretch = NULL;
+        m_f_i2sSlotChecked = false;
+        return i2s_resampleFrames(buf, frames);
+    }
+    const int16_t* in = (const int16_t*)buf;
+    int16_t out[2 * 128];
+    while(frames) {
+        size_t used = 0;
+        size_t n = m_stretch->process(in, frames, &used, out, 128);
+        if(n && !i2s_resampleFrames(out, n)) return false;
+        in += 2 * used;
+        frames -= used;
     }
-    if(m_i2s_bytesWritten < 4) {
-        log_e("Can't stuff any more in I2S..."); // increase waitingtime or outputbuffer
-        return false;
+    return true;
+}
+//---------------------------------------------------------------------------------------------------------------------
+bool Audio::i2s_resampleFrames(const void* buf, size_t frames) {
+    if(!m_resampler) return i2s_writeAll(buf, frames * 4);
+    const int16_t* in = (const int16_t*)buf;
+    int16_t out[2 * 128];
+    while(frames) {
+        size_t used = 0;
+        size_t n = m_resampler->process(in, frames, &used, out, 128);
+        if(n && !i2s_writeAll(out, n * 4)) return false;
+        in += 2 * used;
+        frames -= used;
+    }
+    return true;
+}
+//---------------------------------------------------------------------------------------------------------------------
+void Audio::updateI2SSlotBits() {
+    // > 16 bit tracks get 32 bit slots if the DAC follows (audio_i2s_slot_bits), everything else 16 bit.
+    // Without the callback, or if it refuses, wide tracks are dithered down to 16 bit in playChunk32().
+    // The resampler and the time stretcher work on 16 bit frames, so they keep the slots at 16 bit as well.
+    m_f_i2sSlotChecked = true;
+    uint8_t want = (getBitsPerSample() > 16 && audio_i2s_slot_bits && !m_resampler && !m_stretch) ? 32 : 16;
+    if(want == m_i2sSlotBits) return;
+    if(audio_i2s_slot_bits && !audio_i2s_slot_bits(want)) {
+        if(want == 32) return;                          // stay at 16, dithered
+        log_w("DAC did not accept 16 bit slots");
+    }
+    i2s_zero_dma_buffer((i2s_port_t)m_i2s_num);
+    m_i2s_config.bits_per_sample = (i2s_bits_per_sample_t)want;
+    i2s_set_clk((i2s_port_t)m_i2s_num, m_i2s_config.sample_rate, (i2s_bits_per_sample_t)want, I2S_CHANNEL_STEREO);
+    m_i2sSlotBits = want;
+    AUDIO_INFO("I2S slot width: %u bit", want);
+}
+//---------------------------------------------------------------------------------------------------------------------
+static inline int16_t narrowTPDF(int32_t s, uint32_t& state) {
+    // two uniform values in one xorshift32 step; their difference spans +-1 LSB of the 16 bit result
+    state ^= state << 13; state ^= state >> 17; state ^= state << 5;
+    int32_t tpdf = (int32_t)(state & 0xFFFF) - (int32_t)(state >> 16);
+    int64_t v = ((int64_t)s + tpdf + 0x8000) >> 16;
+    if(v >  32767) v =  32767;
+    if(v < -32768) v = -32768;
+    return (int16_t)v;
+}
+//---------------------------------------------------------------------------------------------------------------------
+bool Audio::i2s_limitFrames(const int32_t* frames, size_t n, bool dither) {
+    // Q23 stereo frames [L, R] from every path go through the limiter, then into the I2S format
+    int32_t out[2 * LIMITER_BLOCK];
+    while(n) {
+        size_t used = 0;
+        size_t k = m_limiter.process(frames, n, &used, out, LIMITER_BLOCK);
+        if(k && !i2s_writeQ23(out, k, dither)) return false;
+        frames += 2 * used;
+        n -= used;
     }
     return true;
 }
 //---------------------------------------------------------------------------------------------------------------------
+bool Audio::i2s_writeQ23(const int32_t* frames, size_t n, bool dither) {
+    // 32 bit slots: left-justified [L, R]. 16 bit slots: packed (L << 16) | R words, TPDF dither for > 16 bit
+    // sources, then audio_process_i2s(), time stretch and resampler as for any 16 bit frame.
+    uint32_t out[2 * LIMITER_BLOCK];
+    if(m_i2sSlotBits == 32) {
+        for(size_t i = 0; i < 2 * n; i++) out[i] = (uint32_t)frames[i] << 8;
+        return i2s_writeAll(out, n * 8);
+    }
+    const bool dacOffset = m_f_internalDAC && !m_resampler && !m_stretch;
+    size_t k = 0;
+    for(size_t i = 0; i < n; i++) {
+        int32_t l = frames[2 * i], r = frames[2 * i + 1];
+        int16_t l16 = dither ? narrowTPDF(l << 8, m_ditherState) : (int16_t)((l + 128) >> 8);
+        int16_t r16 = dither ? narrowTPDF(r << 8, m_ditherState) : (int16_t)((r + 128) >> 8);
+        uint32_t s32 = ((uint32_t)(uint16_t)l16 << 16) | (uint16_t)r16;
+        if(audio_process_i2s) {
+            bool continueI2S = false;
+            audio_process_i2s(&s32, &continueI2S);
+            if(!continueI2S) continue;
+        }
+        if(dacOffset) s32 += 0x80008000;
+        out[k++] = s32;
+    }
+    return i2s_writeFrames(out, k);
+}
+//---------------------------------------------------------------------------------------------------------------------
+bool Audio::playChunk32() {
+    // m_outBuff holds left-justified int32 samples (WAV 24/32, FLAC 20/24). Same chain as mixSample() in
+    // Q23: EQ, seek fade-in, volume/balance. Output is collected and handed to the limiter in blocks.
+    const int32_t* in = (const int32_t*)m_outBuff;
+    const bool eq = m_gain0 || m_gain1 || m_gain2;
+    const bool mono = getChannels() == 1;
+
+    int32_t bl = 0, br = 0;                             // balance as in Gain()
+    if(m_balance < 0) bl = (int32_t)m_volQ14 * -m_balance / 16;
+    if(m_balance > 0) br = (int32_t)m_volQ14 * m_balance / 16;
+    const int32_t volL = m_volQ14 - bl, volR = m_volQ14 - br;
+
+    int32_t out[2 * LIMITER_BLOCK];
+    size_t n = 0;
+    bool ok = true;
+    while(m_validSamples) {
+        int32_t s[2];
+        if(mono) {s[LEFTCHANNEL] = s[RIGHTCHANNEL] = in[m_curSample];}
+        else {
+            s[LEFTCHANNEL]  = in[m_curSample * 2];
+            s[RIGHTCHANNEL] = in[m_curSample * 2 + 1];
+            if(m_f_forceMono) s[LEFTCHANNEL] = s[RIGHTCHANNEL] = (s[LEFTCHANNEL] >> 1) + (s[RIGHTCHANNEL] >> 1);
+        }
+        s[LEFTCHANNEL]  >>= 8;                          // Q23, 24 bit resolution and room for boosts
+        s[RIGHTCHANNEL] >>= 8;
+        if(eq) {
+            float f[2] = {s[LEFTCHANNEL] / 256.0f, s[RIGHTCHANNEL] / 256.0f}; // filter state is in 16 bit units
+            IIR_filterChain32(f);
+            for(int c = 0; c < 2; c++) {
+                float v = f[c] * 256.0f;
+                s[c] = v > 2147483520.0f ? INT32_MAX : (v < -2147483520.0f ? INT32_MIN : (int32_t)v);
+            }
+        }
+        pcm_fadeInQ23(s, m_fadeInPos, m_fadeInSamples);
+        if(m_f_resumeProbe){m_f_resumeProbe = false; m_resumeMillis = millis();}
+        pcm_gainFrameQ23(s, volL, volR);                // EQ boost * ReplayGain can exceed full scale
+        out[2 * n]     = s[LEFTCHANNEL];
+        out[2 * n + 1] = s[RIGHTCHANNEL];
+        n++;
+        m_validSamples--;
+        m_curSample++;
+        if(n == LIMITER_BLOCK || !m_validSamples) {
+            ok = i2s_limitFrames(out, n, true);
+            n = 0;
+            if(!ok) {log_e("can't send"); m_validSamples = 0; break;}
+        }
+    }
+    m_curSample = 0;
+    return ok;
+}
+//---------------------------------------------------------------------------------------------------------------------
 void Audio::setTone(int8_t gainLowPass, int8_t gainBandPass, int8_t gainHighPass){
     // see https://www.earlevel.com/main/2013/10/13/biquad-calculator-v2/
     // values can be between -40 ... +6 (dB)
@@ -4595,6 +4975,7 @@ void Audio::setBalance(int8_t bal){ // bal -16...16
 void Audio::setVolume(uint8_t vol) { // vol 22 steps, 0...21
     if(vol > 21) vol = 21;
     m_vol = volumetable[vol];
+    updateVolQ14();
 }
 //---------------------------------------------------------------------------------------------------------------------
 uint8_t Audio::getVolume() {
@@ -4602,6 +4983,7 @@ uint8_t Audio::getVolume() {
         if(volumetable[i] == m_vol) return i;
     }
     m_vol = 12; // if m_vol not found in table
+    updateVolQ14();
     return m_vol;
 }
 //---------------------------------------------------------------------------------------------------------------------
@@ -4609,24 +4991,17 @@ uint8_t Audio::getI2sPort() {
     return m_i2s_num;
 }
 //---------------------------------------------------------------------------------------------------------------------
-int32_t Audio::Gain(int16_t s[2]) {
-    int32_t v[2];
-    float step = (float)m_vol /64;
-    uint8_t l = 0, r = 0;
+void Audio::Gain(int32_t s[2]) {
+    int32_t l = 0, r = 0;
 
     if(m_balance < 0){
-        step = step * (float)(abs(m_balance) * 4);
-        l = (uint8_t)(step);
+        l = (int32_t)m_volQ14 * -m_balance / 16;
     }
     if(m_balance > 0){
-        step = step * m_balance * 4;
-        r = (uint8_t)(step);
+        r = (int32_t)m_volQ14 * m_balance / 16;
     }
 
-    v[LEFTCHANNEL] = (s[LEFTCHANNEL]  * (m_vol - l)) >> 6;
-    v[RIGHTCHANNEL]= (s[RIGHTCHANNEL] * (m_vol - r)) >> 6;
-
-    return (v[LEFTCHANNEL] << 16) | (v[RIGHTCHANNEL] & 0xffff);
+    pcm_gainFrameQ23(s, m_volQ14 - l, m_volQ14 - r);   // EQ boost * ReplayGain can leave the int32 range
 }
 //---------------------------------------------------------------------------------------------------------------------
 uint32_t Audio::inBufferFilled() {
@@ -4878,6 +5253,26 @@ int16_t* Audio::IIR_filterChain2(int16_t iir_in[2], bool clear){  // Infinite Im
 
     return iir_out;
 }
+//---------------------------------------------------------------------------------------------------------------------
+void Audio::IIR_filterChain32(float s[2]){  // the three biquads of IIR_filterChain0..2 on a float pair
+
+    enum: uint8_t {z1 = 0, z2 = 1, in = 0, out = 1};
+    for(uint8_t f = 0; f < 3; f++){
+        for(uint8_t ch = 0; ch < 2; ch++){
+            float (*b)[2][2] = m_filterBuff[f];
+            float o =   m_filter[f].a0 * s[ch]
+                      + m_filter[f].a1 * b[z1][in][ch]
+                      + m_filter[f].a2 * b[z2][in][ch]
+                      - m_filter[f].b1 * b[z1][out][ch]
+                      - m_filter[f].b2 * b[z2][out][ch];
+            b[z2][in][ch]  = b[z1][in][ch];
+            b[z1][in][ch]  = s[ch];
+            b[z2][out][ch] = b[z1][out][ch];
+            b[z1][out][ch] = o;
+            s[ch] = o;
+        }
+    }
+}
 //----------------------------------------------------------------------------------------------------------------------
 //    AAC - T R A N S P O R T S T R E A M
 //----------------------------------------------------------------------------------------------------------------------
@@ -5372,25 +5767,170 @@ uint32_t Audio::flac_correctResumeFilePos(uint32_t resumeFilePos){
     return m_audioDataStart;
 }
 //----------------------------------------------------------------------------------------------------------------------
-uint32_t Audio::mp3_correctResumeFilePos(uint32_t resumeFilePos){
-    // The starting point is the next MP3 syncword
-    uint8_t p1, p2;
-    boolean found = false;
-    uint32_t pos = resumeFilePos;
-    audiofile.seek(pos);
-
-    p1 = audiofile.read();
-    p2 = audiofile.read();
-    pos+=2;
-    while(!found || pos == m_file_size){
-        if(p1 == 0xFF && (p2 & 0xF0) == 0xF0){found = true; break;}
-        p1 = p2;
-        p2 = audiofile.read();
-        pos++;
+int Audio::mp3_frameLength(const uint8_t* h, uint32_t* sampleRate, uint16_t* samplesPerFrame){
+    // Layer III frame length in bytes from a 4 byte frame header, -1 if the header is not valid
+    static const uint16_t br_mpeg1[15] = {0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320};
+    static const uint16_t br_mpeg2[15] = {0,  8, 16, 24, 32, 40, 48, 56,  64,  80,  96, 112, 128, 144, 160};
+    static const uint16_t sr_mpeg1[3]  = {44100, 48000, 32000};
+
+    if(h[0] != 0xFF || (h[1] & 0xE0) != 0xE0) return -1;   // 11 bit syncword
+    uint8_t version = (h[1] >> 3) & 0x03;                   // 0: MPEG2.5, 1: reserved, 2: MPEG2, 3: MPEG1
+    uint8_t layer   = (h[1] >> 1) & 0x03;                   // 1: Layer III
+    uint8_t brIdx   = (h[2] >> 4) & 0x0F;
+    uint8_t srIdx   = (h[2] >> 2) & 0x03;
+    uint8_t padding = (h[2] >> 1) & 0x01;
+    if(version == 1 || layer != 1 || brIdx == 0 || brIdx == 15 || srIdx == 3) return -1;
+
+    uint32_t sr = sr_mpeg1[srIdx];
+    if(version == 2) sr /= 2;
+    if(version == 0) sr /= 4;
+    uint32_t br  = (version == 3 ? br_mpeg1[brIdx] : br_mpeg2[brIdx]) * 1000;
+    uint16_t spf = (version == 3) ? 1152 : 576;
+    if(sampleRate)      *sampleRate = sr;
+    if(samplesPerFrame) *samplesPerFrame = spf;
+    return (spf / 8) * br / sr + padding;
+}
+//----------------------------------------------------------------------------------------------------------------------
+int Audio::mp3_findValidSync(const uint8_t* data, size_t len){
+    // Offset of the first frame header that is followed by a matching header, -1 if there is none.
+    // Checking the successor skips 0xFFEx patterns inside the audio data.
+    for(size_t i = 0; i + 4 <= len; i++){
+        if(data[i] != 0xFF) continue;
+        uint32_t sr1 = 0, sr2 = 0;
+        int fl = mp3_frameLength(data + i, &sr1);
+        if(fl < 0) continue;
+        if(i + fl + 4 > len) return i; // successor is outside the buffer
+        if(mp3_frameLength(data + i + fl, &sr2) > 0 && sr1 == sr2 && (data[i + 1] & 0xFE) == (data[i + fl + 1] & 0xFE)) return i;
+    }
+    return -1;
+}
+//----------------------------------------------------------------------------------------------------------------------
+void Audio::mp3_readVbrHeader(){
+    // Looks for a Xing/Info or VBRI header in the first frame: exact frame count and a seek TOC
+    m_f_mp3VbrChecked = true;
+    const size_t bufLen = 1024;
+    uint8_t* buf = (uint8_t*)malloc(bufLen);
+    if(!buf) return;
+    uint32_t filePos = audiofile.position();
+    audiofile.seek(m_audioDataStart);
+    int n = audiofile.read(buf, bufLen);
+    audiofile.seek(filePos);
+    int off = (n > 0) ? mp3_findValidSync(buf, n) : -1;
+    if(off < 0) {free(buf); return;}
+
+    uint8_t* h   = buf + off;
+    uint8_t* end = buf + n;
+    mp3_frameLength(h, &m_mp3SampleRate, &m_mp3SamplesPerFrame);
+    bool mpeg1   = ((h[1] >> 3) & 0x03) == 3;
+    bool mono    = ((h[3] >> 6) & 0x03) == 3;
+    int sideInfo = mpeg1 ? (mono ? 17 : 32) : (mono ? 9 : 17);
+    uint8_t* x   = h + 4 + sideInfo;                        // Xing/Info follows the side info
+    uint8_t* v   = h + 4 + 32;                              // VBRI is always at offset 36
+
+    if(x + 8 <= end && (memcmp(x, "Xing", 4) == 0 || memcmp(x, "Info", 4) == 0)){
+        uint32_t flags = bigEndian(x + 4, 4);
+        uint8_t* p = x + 8;
+        if((flags & 0x01) && p + 4 <= end)   {m_mp3TotalFrames = bigEndian(p, 4); p += 4;}
+        if((flags & 0x02) && p + 4 <= end)   {m_mp3TotalBytes  = bigEndian(p, 4); p += 4;}
+        if((flags & 0x04) && p + 100 <= end) {memcpy(m_mp3Toc, p, 100); m_f_mp3Toc = true;}
+        AUDIO_INFO("%.4s header: %u frames, %u bytes, TOC %s", (const char*)x, m_mp3TotalFrames, m_mp3TotalBytes, m_f_mp3Toc ? "yes" : "no");
+    }
+    else if(v + 26 <= end && memcmp(v, "VBRI", 4) == 0){
+        m_mp3TotalBytes  = bigEndian(v + 10, 4);
+        m_mp3TotalFrames = bigEndian(v + 14, 4);
+        uint16_t entries        = bigEndian(v + 18, 2);
+        uint16_t scale          = bigEndian(v + 20, 2);
+        uint16_t entrySize      = bigEndian(v + 22, 2);
+        uint16_t framesPerEntry = bigEndian(v + 24, 2);
+        uint8_t* t = v + 26;
+        if(entries && framesPerEntry && entrySize >= 1 && entrySize <= 4 && t + entries * entrySize <= end &&
+           m_mp3TotalFrames && m_mp3TotalBytes){
+            // convert the per block byte table into Xing style percent positions
+            uint32_t sum = 0;
+            uint16_t e = 0;
+            for(int pct = 0; pct < 100; pct++){
+                uint32_t frame = (uint64_t)m_mp3TotalFrames * pct / 100;
+                while(e < entries && (uint32_t)(e + 1) * framesPerEntry <= frame){sum += bigEndian(t + e * entrySize, entrySize) * scale; e++;}
+                uint32_t pos = sum;
+                if(e < entries) pos += (uint64_t)bigEndian(t + e * entrySize, entrySize) * scale * (frame - e * framesPerEntry) / framesPerEntry;
+                uint32_t toc = (uint64_t)pos * 256 / m_mp3TotalBytes;
+                m_mp3Toc[pct] = toc > 255 ? 255 : toc;
+            }
+            m_f_mp3Toc = true;
+        }
+        AUDIO_INFO("VBRI header: %u frames, %u bytes, TOC %s", m_mp3TotalFrames, m_mp3TotalBytes, m_f_mp3Toc ? "yes" : "no");
     }
-
-    if(found) return (pos - 2);
-    return m_audioDataStart;
+    free(buf);
+}
+//----------------------------------------------------------------------------------------------------------------------
+bool Audio::mp3_seekToTime(uint32_t sec){
+    // Frame index first (lands on the first frame of that second), then the Xing/VBRI TOC, then the average bitrate
+    uint32_t duration = getAudioFileDuration();
+    if(duration && sec > duration) sec = duration;
+    uint32_t pos = 0;
+    int32_t  frameNo = -1;
+    if(sec < m_seekIndexCount){
+        pos = m_seekIndex[sec];
+        frameNo = ((uint64_t)sec * m_mp3SampleRate + m_mp3SamplesPerFrame - 1) / m_mp3SamplesPerFrame;
+    }
+    else if(m_f_mp3Toc && duration){
+        float pct = (float)sec * 100 / duration;
+        int   i   = (int)pct;
+        if(i > 99) i = 99;
+        float a = m_mp3Toc[i];
+        float b = (i < 99) ? m_mp3Toc[i + 1] : 256;
+        uint32_t totalBytes = m_mp3TotalBytes ? m_mp3TotalBytes : m_audioDataSize;
+        pos = m_audioDataStart + (uint32_t)((a + (b - a) * (pct - i)) * totalBytes / 256);
+    }
+    else if(m_avr_bitrate){
+        pos = m_audioDataStart + (uint32_t)((uint64_t)m_avr_bitrate * sec / 8);
+    }
+    else return false;
+
+    if(!setFilePos(pos)) return false;
+    m_resumeFrameNo = frameNo;
+    m_resumeTime = (frameNo >= 0) ? (float)frameNo * m_mp3SamplesPerFrame / m_mp3SampleRate : (float)sec;
+    return true;
+}
+//----------------------------------------------------------------------------------------------------------------------
+void Audio::mp3_updateSeekIndex(uint32_t framePos, int ret){
+    // Called for every frame of a local mp3 file, framePos is the file offset of that frame
+    if(ret != ERR_MP3_NONE && ret != ERR_MP3_MAINDATA_UNDERFLOW){m_f_seekIndexExact = false; return;} // frame count lost
+    if(m_f_seekIndexExact && !m_seekIndexFrames && m_seekIndexCount < m_seekIndexMaxEntries){
+        uint32_t entryFrame = ((uint64_t)m_seekIndexCount * m_mp3SampleRate + m_mp3SamplesPerFrame - 1) / m_mp3SamplesPerFrame;
+        if(m_mp3FrameCounter == entryFrame && seekIndexReserve(m_seekIndexCount + 1)){
+            m_seekIndex[m_seekIndexCount++] = framePos;
+        }
+    }
+    m_mp3FrameCounter++;
+}
+//----------------------------------------------------------------------------------------------------------------------
+bool Audio::seekIndexReserve(uint16_t count){
+    if(count <= m_seekIndexCapacity) return true;
+    uint16_t capacity = (count + 255) & ~255;               // grow in 1KB steps
+    if(capacity > m_seekIndexMaxEntries) capacity = m_seekIndexMaxEntries;
+    if(count > capacity) return false;
+    size_t bytes = capacity * sizeof(uint32_t);
+    uint32_t* p = (uint32_t*)(psramFound() ? ps_realloc(m_seekIndex, bytes) : realloc(m_seekIndex, bytes));
+    if(!p) {log_e("seek index: out of memory"); return false;}
+    m_seekIndex = p;
+    m_seekIndexCapacity = capacity;
+    return true;
+}
+//----------------------------------------------------------------------------------------------------------------------
+uint16_t Audio::getSeekIndex(const uint32_t** entries, uint32_t* totalFrames){
+    if(entries)     *entries = m_seekIndex;
+    if(totalFrames) *totalFrames = m_seekIndexFrames;
+    return m_seekIndexCount;
+}
+//----------------------------------------------------------------------------------------------------------------------
+bool Audio::setSeekIndex(const uint32_t* entries, uint16_t count, uint32_t totalFrames){
+    if(count > m_seekIndexMaxEntries) count = m_seekIndexMaxEntries;
+    if(!seekIndexReserve(count)) return false;
+    if(count) memcpy(m_seekIndex, entries, count * sizeof(uint32_t));
+    m_seekIndexCount = count;
+    m_seekIndexFrames = totalFrames;
+    return true;
 }
 //----------------------------------------------------------------------------------------------------------------------
 
@@ -26,6 +26,8 @@
 #endif
 #include <vector>
 #include <driver/i2s.h>
+#include "limiter/limiter.h"
+#include "pcmscale/pcmscale.h"
 
 #ifdef SDFATFS_USED
 #include <SdFat.h>  // https://github.com/greiman/SdFat
@@ -88,6 +90,21 @@ extern __attribute__((weak)) void audio_eof_speech(const char*);
 extern __attribute__((weak)) void audio_eof_stream(const char*); // The webstream comes to an end
 extern __attribute__((weak)) void audio_process_extern(int16_t* buff, uint16_t len, bool *continueI2S); // record audiodata or send via BT
 extern __attribute__((weak)) void audio_process_i2s(uint32_t* sample, bool *continueI2S); // record audiodata or send via BT
+extern __attribute__((weak)) bool audio_i2s_slot_bits(uint8_t bits); // DAC follows the I2S slot width (16/32), false if it can't
+extern __attribute__((weak)) void audio_trace(uint8_t point, bool begin, uint32_t arg); // hot-path timing, -DENABLE_TRACE=1
+
+// Trace points passed to audio_trace(), begin and end of each
+enum : uint8_t {AUDIO_TRACE_SD_READ = 2,      // arg: bytes requested / read
+                AUDIO_TRACE_DECODE = 3,       // arg: codec / bytes consumed
+                AUDIO_TRACE_I2S_WRITE = 4};   // arg: bytes
+#if ENABLE_TRACE
+#define AUDIO_TRACE(point, begin, arg) {if(audio_trace) audio_trace(point, begin, arg);}
+#else
+#define AUDIO_TRACE(point, begin, arg) {}
+#endif
+
+class Resampler;
+class TimeStretch;
 
 #define AUDIO_INFO(...) {char buff[512 + 64]; sprintf(buff,__VA_ARGS__); if(audio_info) audio_info(buff);}
 
@@ -128,6 +145,7 @@ public:
     void     setBufsize(int ram, int psram);
     void     changeMaxBlockSize(uint16_t mbs);  // is default 1600 for mp3 and aac, set 16384 for FLAC
     uint16_t getMaxBlockSize();                 // returns maxBlockSize
+    size_t   getBufsize() { return m_buffSize; }; // usable ring size without the reserved tail
     size_t   freeSpace();                       // number of free bytes to overwrite
     size_t   writeSpace();                      // space fom writepointer to bufferend
     size_t   bufferFilled();                    // returns the number of filled bytes
@@ -181,7 +199,7 @@ public:
 #endif
     bool setAudioPlayPosition(uint16_t sec);
     bool setFilePos(uint32_t pos);
-    bool audioFileSeek(const float speed);
+    bool audioFileSeek(const float speed);  // same as setPlaybackSpeed()
     bool setTimeOffset(int sec);
     bool setPinout(uint8_t BCLK, uint8_t LRC, uint8_t DOUT, int8_t DIN = I2S_PIN_NO_CHANGE, int8_t MCK = I2S_PIN_NO_CHANGE);
     bool pauseResume();
@@ -193,6 +211,23 @@ public:
     void setVolume(uint8_t vol);
     uint8_t getVolume();
     uint8_t getI2sPort();
+    // output monitoring, from any task: the driver's events (TX_DONE per DMA buffer, TX_Q_OVF when the
+    // DMA ran dry) and the bytes handed to i2s_write() so far. The queue changes when the driver is
+    // reinstalled, so it is only reachable through waitI2sEvent().
+    bool     waitI2sEvent(i2s_event_t* ev, TickType_t timeout);
+    uint32_t getI2sBytesWritten() {return m_i2sBytesTotal;}
+    uint32_t getI2sSampleRate() {return m_i2s_config.sample_rate;}
+    uint16_t getI2sDmaBufCount() {return m_i2s_config.dma_buf_count;}
+    // bytes per stereo frame in the DMA (IDF pads samples to 16 or 32 bits) and frames per DMA buffer as
+    // the driver allocated them: buffers are cut to 4092 bytes, so 512 frames of 32-bit samples are 511
+    uint32_t getI2sFrameBytes() {return ((int)m_i2s_config.bits_per_sample + 15) / 16 * 2 * 2;}
+    uint16_t getI2sDmaBufLen() {uint32_t cap = 4092 / getI2sFrameBytes();
+                                return m_i2s_config.dma_buf_len < cap ? m_i2s_config.dma_buf_len : cap;}
+    uint32_t getI2sDmaBufBytes() {return (uint32_t)getI2sDmaBufLen() * getI2sFrameBytes();}
+    // DMA size in buffers x frames per buffer (len <= 1024; IDF shortens buffers over 4092 bytes).
+    // Reinstalls the driver and drops what is queued: call it from the task that feeds the output.
+    // On failure (no memory) the previous size is restored and false returned.
+    bool     setI2sDmaBuffers(uint16_t count, uint16_t len);
 
     uint32_t getAudioDataStartPos();
     uint32_t getFileSize();
@@ -213,6 +248,24 @@ public:
     int getCodec() {return m_codec;}
     const char *getCodecname() {return codecname[m_codec];}
 
+    // MP3 seek index: file offset of the first frame of every second, built while playing.
+    // totalFrames is the decoded frame count once playback reached EOF, otherwise 0.
+    uint16_t getSeekIndex(const uint32_t** entries, uint32_t* totalFrames = NULL);
+    bool     setSeekIndex(const uint32_t* entries, uint16_t count, uint32_t totalFrames);
+    uint32_t getResumeMillis() {return m_resumeMillis;} // millis() of the first sample written after the last seek
+    void     setFileReadChunk(uint32_t bytes); // max bytes per SD read of a local file, multiple of 512
+    // Resample everything to one I2S rate so the clocks never change between tracks; 0 = follow the track.
+    // quality: 0 fast (8 taps), 1 balanced (16), 2 best (32). Output is 16 bit while active.
+    bool     setOutputSampleRate(uint32_t hz, uint8_t quality = 1);
+    uint32_t getOutputSampleRate() {return m_outputRate;}
+    // Tempo 0.5 ... 2.0 with unchanged pitch (WSOLA). Output is 16 bit while it is not 1.0.
+    bool     setPlaybackSpeed(float speed);
+    float    getPlaybackSpeed();
+    // Loudness normalisation on top of the volume: gain in dB, limited so peak * gain stays below full scale
+    // (peak 0 = unknown) and to +6 dB. 0 dB resets it.
+    void     setReplayGain(float gainDb, float peak = 0);
+    float    getReplayGain() {return m_rgQ14 / 16384.0f;}   // linear
+
 private:
 
     #ifndef ESP_ARDUINO_VERSION_VAL
@@ -259,9 +312,19 @@ private:
     bool setChannels(int channels);
     bool setBitrate(int br);
     bool playChunk();
-    bool playSample(int16_t sample[2]) ;
+    bool playChunk32();
+    void mixSample(int16_t sample[2], int32_t s[2]);
+    void i2s_install();
+    bool i2s_writeAll(const void* buf, size_t bytes);
+    bool i2s_writeFrames(const void* buf, size_t frames);
+    bool i2s_resampleFrames(const void* buf, size_t frames);
+    bool i2s_limitFrames(const int32_t* frames, size_t n, bool dither);
+    bool i2s_writeQ23(const int32_t* frames, size_t n, bool dither);
+    void setI2SRate(uint32_t hz);
+    void updateI2SSlotBits();
     void playI2Sremains();
-    int32_t Gain(int16_t s[2]);
+    void    Gain(int32_t s[2]);
+    void    updateVolQ14() {m_volQ14 = ((uint32_t)m_vol * m_rgQ14) >> 6;}
     bool fill_InputBuf();
     void showstreamtitle(const char* ml);
 #ifndef AUDIO_NO_NETWORK
@@ -277,6 +340,7 @@ private:
     int16_t* IIR_filterChain0(int16_t iir_in[2], bool clear = false);
     int16_t* IIR_filterChain1(int16_t* iir_in, bool clear = false);
     int16_t* IIR_filterChain2(int16_t* iir_in, bool clear = false);
+    void     IIR_filterChain32(float s[2]);
     inline void setDatamode(uint8_t dm){m_datamode=dm;}
     inline uint8_t getDatamode(){return m_datamode;}
 #ifndef AUDIO_NO_NETWORK
@@ -298,7 +362,15 @@ private:
     void     seek_m4a_stsz();
     uint32_t m4a_correctResumeFilePos(uint32_t resumeFilePos);
     uint32_t flac_correctResumeFilePos(uint32_t resumeFilePos);
-    uint32_t mp3_correctResumeFilePos(uint32_t resumeFilePos);
+    int      mp3_frameLength(const uint8_t* h, uint32_t* sampleRate = NULL, uint16_t* samplesPerFrame = NULL);
+    int      mp3_findValidSync(const uint8_t* data, size_t len);
+    void     mp3_readVbrHeader();
+    bool     mp3_seekToTime(uint32_t sec);
+    void     mp3_updateSeekIndex(uint32_t framePos, int ret);
+    bool     seekIndexReserve(uint16_t count);
+    bool     wav_fastPathOk(const uint8_t* data);
+    void     wav_playFused(uint8_t* data, size_t len);
+    size_t   wav_unpackWide(const uint8_t* data, size_t len);
 
 
 //++++ implement several function with respect to the index of string ++++
@@ -520,6 +592,8 @@ private:
     int             m_controlCounter = 0;           // Status within readID3data() and readWaveHeader()
     int8_t          m_balance = 0;                  // -16 (mute left) ... +16 (mute right)
     uint8_t         m_vol=64;                       // volume
+    uint16_t        m_rgQ14 = 16384;                // ReplayGain, linear Q14, at most 2.0
+    uint16_t        m_volQ14 = 64 << 8;             // m_vol * ReplayGain, Q14, what the gain stages use
     uint8_t         m_bitsPerSample = 16;           // bitsPerSample
     uint8_t         m_channels = 2;
     uint8_t         m_i2s_num = I2S_NUM_0;          // I2S_NUM_0 or I2S_NUM_1
@@ -532,7 +606,7 @@ private:
 #endif
     uint8_t         m_filterType[2];                // lowpass, highpass
     uint8_t         m_ID3Size = 0;                  // lengt of ID3frame - ID3header
-    int16_t         m_outBuff[2048*2];              // Interleaved L/R
+    int16_t         m_outBuff[2048*2] __attribute__((aligned(4))); // Interleaved L/R, int32 left-justified if > 16 bit
     int16_t         m_validSamples = 0;
     int16_t         m_curSample = 0;
     uint16_t        m_datamode = 0;                 // Statemaschine
@@ -583,9 +657,43 @@ private:
     uint32_t        m_audioFileDuration = 0;
     float           m_audioCurrentTime = 0;
     uint32_t        m_audioDataStart = 0;           // in bytes
+    uint8_t         m_mp3Toc[100];                  // Xing TOC (VBRI converted): byte position of each percent, /256
+    bool            m_f_mp3Toc = false;             // m_mp3Toc is valid
+    bool            m_f_mp3VbrChecked = false;      // Xing/Info/VBRI header has been looked for
+    bool            m_f_seekIndexExact = false;     // m_mp3FrameCounter is exact, index entries may be appended
+    uint16_t        m_mp3SamplesPerFrame = 1152;    // 1152 MPEG1, 576 MPEG2/2.5 (layer 3)
+    uint32_t        m_mp3SampleRate = 44100;        // from the first frame header
+    uint32_t        m_mp3TotalFrames = 0;           // from Xing/Info/VBRI, 0 if unknown
+    uint32_t        m_mp3TotalBytes = 0;            // from Xing/Info/VBRI, 0 if unknown
+    uint32_t        m_mp3FrameCounter = 0;          // frames decoded since m_audioDataStart
+    int32_t         m_resumeFrameNo = -1;           // frame at m_resumeFilePos if known from the seek index
+    float           m_resumeTime = -1;              // playtime at m_resumeFilePos if known from a seek
+    uint32_t        m_resumeMillis = 0;             // set by the first frame mixed after a seek
+    bool            m_f_resumeProbe = false;        // a seek was applied, waiting for the first sample
+    uint16_t        m_fadeInSamples = 0;            // length of the fade-in after a seek, 0 = none
+    uint16_t        m_fadeInPos = 0;
+    uint32_t*       m_seekIndex = NULL;             // file offset of the first frame of each second
+    uint16_t        m_seekIndexCount = 0;
+    uint16_t        m_seekIndexCapacity = 0;
+    uint32_t        m_seekIndexFrames = 0;          // total frames, set when the index reached EOF
+    uint32_t        m_fileReadChunk = 16 * 1024;    // local files: max bytes per read, see setFileReadChunk()
+    uint8_t         m_i2sSlotBits = 16;             // current I2S slot width, 32 only for > 16 bit tracks
+    bool            m_f_i2sSlotChecked = false;     // slot width chosen for the current track
+    uint32_t        m_ditherState = 0x12345678;     // xorshift32 for the TPDF dither when narrowing to 16 bit
+    Resampler*      m_resampler = NULL;             // only while setOutputSampleRate() is active
+    uint32_t        m_outputRate = 0;               // fixed I2S rate, 0 = I2S follows the track
+    TimeStretch*    m_stretch = NULL;               // while the speed is not 1.0 and until it has drained
+    Limiter         m_limiter;                      // last stage before the output format, every path
+    const uint16_t  m_seekIndexMaxEntries = 2 * 3600;  // two hours at one entry per second, 28KB
     size_t          m_audioDataSize = 0;            //
     float           m_filterBuff[3][2][2][2];       // IIR filters memory for Audio DSP
     size_t          m_i2s_bytesWritten = 0;         // set in i2s_write() but not used
+    volatile uint32_t m_i2sBytesTotal = 0;          // every byte i2s_write() accepted, wraps
+    QueueHandle_t   m_i2sEventQueue = NULL;         // the driver's, replaced by i2s_install()
+    SemaphoreHandle_t m_i2sEventLock = NULL;        // held by waitI2sEvent() and i2s_install()
+    volatile bool   m_f_i2sReinstall = false;       // i2s_install() is waiting for the lock
+    bool            m_f_i2sInstalled = false;
+    bool            m_f_i2sPinsSet = false;         // setPinout() was called, reapplied after a reinstall
     size_t          m_file_size = 0;                // size of the file
     uint16_t        m_filterFrequency[2];
     int8_t          m_gain0 = 0;                    // cut or boost filters (EQ)
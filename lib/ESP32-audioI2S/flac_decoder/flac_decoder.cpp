@@ -254,7 +254,7 @@ int8_t FLACDecode(uint8_t *inbuf, int *bytesLeft, short *outbuf){
             if(FLACFrameHeader->sampleSizeCode == 5) FLACMetadataBlock->bitsPerSample = 20;
             if(FLACFrameHeader->sampleSizeCode == 6) FLACMetadataBlock->bitsPerSample = 24;
         }
-        if(FLACMetadataBlock->bitsPerSample > 16) return ERR_FLAC_BITS_PER_SAMPLE_TOO_BIG;
+        if(FLACMetadataBlock->bitsPerSample > 24) return ERR_FLAC_BITS_PER_SAMPLE_TOO_BIG;
         if(FLACMetadataBlock->bitsPerSample < 8 ) return ERR_FLAG_BITS_PER_SAMPLE_UNKNOWN;
 
         if(!FLACMetadataBlock->sampleRate){
@@ -328,17 +328,30 @@ int8_t FLACDecode(uint8_t *inbuf, int *bytesLeft, short *outbuf){
     if(m_status == OUT_SAMPLES){  // Write the decoded samples
         // blocksize can be much greater than outbuff, so we can't stuff all in once
         // therefore we need often more than one loop (split outputblock into pieces)
+        // > 16 bit: outbuf takes left-justified int32 samples, so half as many frames fit
         uint16_t blockSize;
         static uint16_t offset = 0;
-        if(m_blockSize < outBuffSize + offset) blockSize = m_blockSize - offset;
-        else blockSize = outBuffSize;
-
-
-        for (int i = 0; i < blockSize; i++) {
-            for (int j = 0; j < FLACMetadataBlock->numChannels; j++) {
-                int val = FLACsubFramesBuff->samplesBuffer[j][i + offset];
-                if (FLACMetadataBlock->bitsPerSample == 8) val += 128;
-                outbuf[2*i+j] = val;
+        const uint8_t bps = FLACMetadataBlock->bitsPerSample;
+        const uint16_t maxFrames = (bps > 16) ? outBuffSize / 2 : outBuffSize;
+        if(m_blockSize < maxFrames + offset) blockSize = m_blockSize - offset;
+        else blockSize = maxFrames;
+
+        if(bps > 16) {
+            int32_t* out32 = (int32_t*)outbuf;
+            const uint8_t nch = FLACMetadataBlock->numChannels;
+            for (int i = 0; i < blockSize; i++) {
+                for (int j = 0; j < nch; j++) {
+                    out32[nch * i + j] = FLACsubFramesBuff->samplesBuffer[j][i + offset] << (32 - bps);
+                }
+            }
+        }
+        else {
+            for (int i = 0; i < blockSize; i++) {
+                for (int j = 0; j < FLACMetadataBlock->numChannels; j++) {
+                    int val = FLACsubFramesBuff->samplesBuffer[j][i + offset];
+                    if (bps == 8) val += 128;
+                    outbuf[2*i+j] = val;
+                }
             }
         }
 
@@ -449,7 +462,7 @@ int8_t decodeSubframe(uint8_t sampleDepth, uint8_t ch) {
     sampleDepth -= shift;
 
     if(type == 0){  // Constant coding
-        int16_t s= readSignedInt(sampleDepth);
+        int32_t s= readSignedInt(sampleDepth);
         for(int i=0; i < m_blockSize; i++){
             FLACsubFramesBuff->samplesBuffer[ch][i] = s;
         }
@@ -544,6 +557,16 @@ int8_t decodeResiduals(uint8_t warmup, uint8_t ch) {
 //----------------------------------------------------------------------------------------------------------------------
 void restoreLinearPrediction(uint8_t ch, uint8_t shift) {
 
+    if(FLACMetadataBlock->bitsPerSample > 16) { // 24 bit samples times 15 bit coefficients overflow int32
+        for (int i = coefs.size(); i < m_blockSize; i++) {
+            int64_t sum = 0;
+            for (int j = 0; j < coefs.size(); j++){
+                sum += (int64_t)FLACsubFramesBuff->samplesBuffer[ch][i - 1 - j] * coefs[j];
+            }
+            FLACsubFramesBuff->samplesBuffer[ch][i] += (int32_t)(sum >> shift);
+        }
+        return;
+    }
     for (int i = coefs.size(); i < m_blockSize; i++) {
         int32_t sum = 0;
         for (int j = 0; j < coefs.size(); j++){
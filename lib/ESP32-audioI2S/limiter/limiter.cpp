@@ -0,0 +1,96 @@
+/*
+ * limiter.cpp
+ *
+ *  Lookahead brickwall limiter, see limiter.h
+ */
+#include "limiter.h"
+
+//---------------------------------------------------------------------------------------------------------------------
+void Limiter::reset() {
+    m_fill = 0;
+    m_emitPos = m_emitLen = 0;
+    m_peak = m_pendingPeak = 0;
+    m_f_pending = false;
+    m_gain = m_target = LIMITER_UNITY;
+    m_step = 0;
+}
+//---------------------------------------------------------------------------------------------------------------------
+int32_t Limiter::gainFor(uint32_t peak) {
+    if(peak <= LIMITER_CEILING) return LIMITER_UNITY;
+    return (int32_t)(((uint64_t)LIMITER_CEILING << 31) / peak);
+}
+//---------------------------------------------------------------------------------------------------------------------
+void Limiter::endBlock() {
+    // The pending block is emitted now; its gain ends at what both it and the block just filled allow.
+    // It starts at the value the previous ramp ended on, which already respected this block's peak.
+    m_fill = 0;
+    if(!m_f_pending) {
+        m_f_pending = true;
+        m_pendingPeak = m_peak;
+        m_peak = 0;
+        m_fillBuf ^= 1;
+        return;
+    }
+    int32_t need = gainFor(m_pendingPeak);
+    if(m_gain > need) m_gain = need;                    // only after reset(), nothing looked ahead yet
+    int32_t g = m_gain;
+    if(g < LIMITER_UNITY) {
+        g += (LIMITER_UNITY - g) >> LIMITER_RELEASE_SHIFT;
+        if(LIMITER_UNITY - g < 64) g = LIMITER_UNITY;
+    }
+    g = min(g, min(need, gainFor(m_peak)));
+    int32_t d = g - m_gain;
+    m_step = d >= 0 ? d / LIMITER_BLOCK : -((-d + LIMITER_BLOCK - 1) / LIMITER_BLOCK);   // never ends above g
+    m_target = g;
+    m_emitPos = 0;
+    m_emitLen = LIMITER_BLOCK;
+    m_pendingPeak = m_peak;
+    m_peak = 0;
+    m_fillBuf ^= 1;                                     // the emitted buffer is filled next, once it is out
+}
+//---------------------------------------------------------------------------------------------------------------------
+size_t Limiter::process(const int32_t* in, size_t frames, size_t* used, int32_t* out, size_t outCap) {
+    size_t nIn = 0, nOut = 0;
+    while(true) {
+        if(m_emitPos < m_emitLen) {
+            size_t n = min((size_t)(m_emitLen - m_emitPos), outCap - nOut);
+            const int32_t* src = m_buf[m_fillBuf] + 2 * m_emitPos;
+            int32_t* dst = out + 2 * nOut;
+            if(m_gain == LIMITER_UNITY && m_step == 0) {
+                memcpy(dst, src, n * 8);
+            }
+            else {
+                int32_t g = m_gain;
+                for(size_t i = 0; i < n; i++) {
+                    g += m_step;
+                    dst[2 * i]     = (int32_t)(((int64_t)src[2 * i]     * g) >> 31);
+                    dst[2 * i + 1] = (int32_t)(((int64_t)src[2 * i + 1] * g) >> 31);
+                }
+                m_gain = g;
+            }
+            m_emitPos += n;
+            nOut += n;
+            if(m_emitPos < m_emitLen) break;            // out is full
+            m_gain = m_target;
+            m_step = 0;
+            continue;
+        }
+        if(nIn == frames) break;
+        size_t c = min(frames - nIn, (size_t)(LIMITER_BLOCK - m_fill));
+        const int32_t* src = in + 2 * nIn;
+        int32_t* dst = m_buf[m_fillBuf] + 2 * m_fill;
+        uint32_t peak = m_peak;
+        for(size_t i = 0; i < 2 * c; i++) {
+            int32_t v = src[i];
+            uint32_t a = v < 0 ? -(uint32_t)v : (uint32_t)v;
+            if(a > peak) peak = a;
+            dst[i] = v;
+        }
+        m_peak = peak;
+        m_fill += c;
+        nIn += c;
+        if(m_fill == LIMITER_BLOCK) endBlock();
+    }
+    *used = nIn;
+    return nOut;
+}
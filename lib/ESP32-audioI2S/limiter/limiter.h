@@ -0,0 +1,42 @@
+/*
+ * limiter.h
+ *
+ *  Lookahead brickwall limiter for stereo int32 frames in Q23 (full scale is 1 << 23, which leaves
+ *  48 dB above it for EQ and ReplayGain boosts). Works on blocks of LIMITER_BLOCK frames and looks
+ *  one block ahead: while a block is played, its gain ramps linearly to what the next block needs,
+ *  so no sample leaves above LIMITER_CEILING. The gain is Q31, the release is exponential with a
+ *  time constant of 32 blocks (46 ms at 44.1 kHz). Below the ceiling samples pass unchanged.
+ *
+ *  Delay: LIMITER_BLOCK frames (1.3 ms at 48 kHz, 4 ms at 16 kHz).
+ */
+#pragma once
+
+#include "Arduino.h"
+
+#define LIMITER_BLOCK         64
+#define LIMITER_CEILING       8290000         // -0.1 dBFS of 32767 << 8
+#define LIMITER_RELEASE_SHIFT 5
+#define LIMITER_UNITY         0x7FFFFFFF
+
+class Limiter {
+public:
+    void    reset();                                    // drop the buffered frames, gain back to 1
+    // Same contract as Resampler::process(), on int32 frames. Output starts one block after the input.
+    size_t  process(const int32_t* in, size_t frames, size_t* used, int32_t* out, size_t outCap);
+    int32_t getGain() {return m_gain;}                  // Q31, LIMITER_UNITY = no reduction
+
+private:
+    int32_t gainFor(uint32_t peak);                     // largest gain that keeps peak at the ceiling
+    void    endBlock();
+
+    int32_t  m_buf[2][2 * LIMITER_BLOCK];
+    uint8_t  m_fillBuf = 0;                             // being filled; the other one waits or is emitted
+    uint16_t m_fill = 0;
+    uint16_t m_emitPos = 0, m_emitLen = 0;
+    uint32_t m_peak = 0;                                // of the block being filled
+    uint32_t m_pendingPeak = 0;                         // of the block waiting for its lookahead
+    bool     m_f_pending = false;
+    int32_t  m_gain = LIMITER_UNITY;                    // Q31, current
+    int32_t  m_target = LIMITER_UNITY;                  // at the end of the emitted block
+    int32_t  m_step = 0;                                // per frame
+};
@@ -0,0 +1,42 @@
+/*
+ * pcmscale.h
+ *
+ *  Volume scaling of 16 bit PCM into Q23 (see limiter.h), the two ways Audio does it:
+ *  per frame with balance and saturation (Gain(), every source and the EQ path), or a
+ *  whole block of stereo frames at one volume (the fused WAV path). With the same volume
+ *  on both channels the results are identical: (s << 8) * vol >> 14 == s * vol >> 6.
+ *
+ *  Volumes are Q14 (16384 = 1.0), including ReplayGain, so at most 2.0.
+ *
+ *  After a seek the new position is ramped in linearly, so the jump from whatever the
+ *  DMA played last is spread over about 8 ms instead of a click.
+ */
+#pragma once
+
+#include "Arduino.h"
+
+// One frame, already in Q23; the EQ can push it past full scale, so the product is saturated
+inline void pcm_gainFrameQ23(int32_t s[2], int32_t volL, int32_t volR) {
+    int64_t l = ((int64_t)s[0] * volL) >> 14;
+    int64_t r = ((int64_t)s[1] * volR) >> 14;
+    s[0] = l > INT32_MAX ? INT32_MAX : (l < INT32_MIN ? INT32_MIN : (int32_t)l);
+    s[1] = r > INT32_MAX ? INT32_MAX : (r < INT32_MIN ? INT32_MIN : (int32_t)r);
+}
+
+// frames interleaved 16 bit frames straight to Q23; 32768 * 2.0 in Q14 still fits an int32 product
+inline void pcm_scaleBlockQ23(const int16_t* in, size_t frames, int32_t vol, int32_t* out) {
+    for(size_t i = 0; i < 2 * frames; i++) out[i] = (in[i] * vol) >> 6;
+}
+
+// Length of the seek fade-in in frames, rate / 128 (7.8 ms at 44.1 kHz, 2.9k frames at 384 kHz)
+inline uint16_t pcm_fadeInFrames(uint32_t rate) {
+    return rate / 128;
+}
+
+// One frame of the fade-in: gain pos / len, then pos moves on; a no-op once pos reached len
+inline void pcm_fadeInQ23(int32_t s[2], uint16_t& pos, uint16_t len) {
+    if(pos >= len) return;
+    s[0] = (int64_t)s[0] * pos / len;
+    s[1] = (int64_t)s[1] * pos / len;
+    pos++;
+}
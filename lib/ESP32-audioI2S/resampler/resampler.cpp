@@ -0,0 +1,150 @@
+/*
+ * resampler.cpp
+ *
+ *  Polyphase windowed-sinc sample rate converter, see resampler.h
+ */
+#include "resampler.h"
+
+static const struct {uint8_t taps; float cutoff; float beta;} s_tiers[] = {
+    { 8, 0.80f, 5.0f},      // RESAMPLER_FAST
+    {16, 0.88f, 7.0f},      // RESAMPLER_BALANCED
+    {32, 0.92f, 8.5f},      // RESAMPLER_BEST
+};
+static const uint64_t ONE = 1ULL << 32;
+
+//---------------------------------------------------------------------------------------------------------------------
+static double besselI0(double x) {
+    double sum = 1, term = 1, q = x * x / 4;
+    for(int k = 1; k < 50 && term > sum * 1e-12; k++) {
+        term *= q / ((double)k * k);
+        sum += term;
+    }
+    return sum;
+}
+//---------------------------------------------------------------------------------------------------------------------
+Resampler::Resampler() {
+    reset();
+}
+Resampler::~Resampler() {
+    if(m_coef) free(m_coef);
+}
+//---------------------------------------------------------------------------------------------------------------------
+bool Resampler::setQuality(uint8_t quality) {
+    if(quality > RESAMPLER_BEST) quality = RESAMPLER_BEST;
+    if(m_coef && quality == m_quality) return true;
+    int16_t* coef = (int16_t*)malloc((RESAMPLER_PHASES + 1) * s_tiers[quality].taps * sizeof(int16_t));
+    if(!coef) return false;
+    if(m_coef) free(m_coef);
+    m_coef = coef;
+    m_quality = quality;
+    m_taps = s_tiers[quality].taps;
+    m_cutoff = 0;                                   // force a rebuild
+    reset();
+    if(m_inRate) setRatio(m_inRate, m_outRate);
+    else buildTable(s_tiers[quality].cutoff);
+    return true;
+}
+//---------------------------------------------------------------------------------------------------------------------
+bool Resampler::setRatio(uint32_t inRate, uint32_t outRate) {
+    if(!inRate || !outRate || !m_coef) return false;
+    m_inRate = inRate;
+    m_outRate = outRate;
+    m_step = ((uint64_t)inRate << 32) / outRate;
+    bool bypass = (inRate == outRate);
+    if(bypass && !m_bypass) m_pos = ONE;            // drop the sub-sample offset, the next frame is passed through
+    m_bypass = bypass;
+    float cutoff = s_tiers[m_quality].cutoff;       // downsampling: stay below the output Nyquist
+    if(outRate < inRate) cutoff = cutoff * outRate / inRate;
+    if(cutoff != m_cutoff) return buildTable(cutoff);
+    return true;
+}
+//---------------------------------------------------------------------------------------------------------------------
+void Resampler::reset() {
+    memset(m_hist, 0, sizeof(m_hist));
+    m_histPos = 0;
+    m_pos = ONE;
+}
+//---------------------------------------------------------------------------------------------------------------------
+bool Resampler::buildTable(float cutoff) {
+    // h(t) = fc * sinc(fc * t) * kaiser(t / (taps / 2)), t in input frames from the output position.
+    // Row p is the output position p / PHASES behind the window centre; every row has a DC gain of 1.
+    const int half = m_taps / 2;
+    const double beta = s_tiers[m_quality].beta;
+    const double i0beta = besselI0(beta);
+    double row[RESAMPLER_MAX_TAPS];
+    for(int p = 0; p <= RESAMPLER_PHASES; p++) {
+        double sum = 0;
+        for(int k = 0; k < m_taps; k++) {
+            double t = (double)p / RESAMPLER_PHASES + half - 1 - k;
+            double u = t / half;
+            double w = (u * u < 1) ? besselI0(beta * sqrt(1 - u * u)) / i0beta : 0;
+            double x = M_PI * cutoff * t;
+            row[k] = (t == 0 ? 1.0 : sin(x) / x) * cutoff * w;
+            sum += row[k];
+        }
+        int16_t* c = m_coef + p * m_taps;
+        int32_t isum = 0, kmax = 0;
+        for(int k = 0; k < m_taps; k++) {
+            c[k] = (int16_t)lround(row[k] * 16384 / sum);
+            isum += c[k];
+            if(c[k] > c[kmax]) kmax = k;
+        }
+        c[kmax] += 16384 - isum;                    // rounding rest onto the largest tap
+    }
+    m_cutoff = cutoff;
+    return true;
+}
+//---------------------------------------------------------------------------------------------------------------------
+inline void Resampler::push(const int16_t* frame) {
+    int16_t* h = m_hist + 2 * m_histPos;
+    h[0] = h[2 * m_taps]     = frame[0];
+    h[1] = h[2 * m_taps + 1] = frame[1];
+    if(++m_histPos == m_taps) m_histPos = 0;
+}
+//---------------------------------------------------------------------------------------------------------------------
+size_t Resampler::process(const int16_t* in, size_t frames, size_t* used, int16_t* out, size_t outCap) {
+    size_t nIn = 0, nOut = 0;
+    const int centre = m_taps / 2 - 1;
+
+    if(m_bypass) {                                  // same delay as the filter, so switching is seamless
+        while(nIn < frames && nOut < outCap) {
+            push(in + 2 * nIn++);
+            const int16_t* w = m_hist + 2 * (m_histPos + centre);
+            out[2 * nOut]     = w[0];
+            out[2 * nOut + 1] = w[1];
+            nOut++;
+        }
+        *used = nIn;
+        return nOut;
+    }
+
+    while(true) {
+        while(m_pos >= ONE) {
+            if(nIn == frames) goto done;
+            push(in + 2 * nIn++);
+            m_pos -= ONE;
+        }
+        if(nOut == outCap) break;
+
+        const uint32_t frac = (uint32_t)m_pos;
+        const int16_t* c0 = m_coef + (frac >> (32 - RESAMPLER_PHASE_BITS)) * m_taps;
+        const int16_t* c1 = c0 + m_taps;
+        const int32_t  a  = (frac >> (32 - RESAMPLER_PHASE_BITS - 15)) & 0x7FFF;   // Q15 between the rows
+        const int16_t* w  = m_hist + 2 * m_histPos;
+        int32_t acc0 = 1 << 13, acc1 = 1 << 13;
+        for(int k = 0; k < m_taps; k++) {
+            int32_t c = c0[k] + (((c1[k] - c0[k]) * a) >> 15);
+            acc0 += c * w[2 * k];
+            acc1 += c * w[2 * k + 1];
+        }
+        acc0 >>= 14;
+        acc1 >>= 14;
+        out[2 * nOut]     = acc0 > 32767 ? 32767 : (acc0 < -32768 ? -32768 : acc0);
+        out[2 * nOut + 1] = acc1 > 32767 ? 32767 : (acc1 < -32768 ? -32768 : acc1);
+        nOut++;
+        m_pos += m_step;
+    }
+done:
+    *used = nIn;
+    return nOut;
+}
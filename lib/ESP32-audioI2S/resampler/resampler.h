@@ -0,0 +1,53 @@
+/*
+ * resampler.h
+ *
+ *  Polyphase windowed-sinc sample rate converter for 16 bit stereo.
+ *  Kaiser windowed sinc, RESAMPLER_PHASES phases in Q14, coefficients are
+ *  interpolated linearly between neighbouring phases, int32 accumulation.
+ *  The filter history survives rate changes, so tracks with different rates
+ *  follow each other without a gap.
+ *
+ *  Delay: taps / 2 input frames.
+ */
+#pragma once
+
+#include "Arduino.h"
+
+#define RESAMPLER_PHASE_BITS 7
+#define RESAMPLER_PHASES     (1 << RESAMPLER_PHASE_BITS)
+#define RESAMPLER_MAX_TAPS   32
+
+enum : uint8_t {RESAMPLER_FAST = 0,       //  8 taps
+                RESAMPLER_BALANCED = 1,   // 16 taps
+                RESAMPLER_BEST = 2};      // 32 taps
+
+class Resampler {
+public:
+    Resampler();
+    ~Resampler();
+    bool    setQuality(uint8_t quality);                // false if the table could not be allocated
+    bool    setRatio(uint32_t inRate, uint32_t outRate);
+    void    reset();                                    // clear the history
+    // Converts interleaved stereo frames (channel order is kept). Stops when either the input is
+    // used up or out is full; *used is the number of input frames consumed. Returns output frames.
+    size_t  process(const int16_t* in, size_t frames, size_t* used, int16_t* out, size_t outCap);
+    uint8_t getQuality() {return m_quality;}
+    uint8_t getTaps()    {return m_taps;}
+    bool    isBypassed() {return m_bypass;}
+
+private:
+    bool    buildTable(float cutoff);
+    inline void push(const int16_t* frame);
+
+    int16_t* m_coef = NULL;                             // (RESAMPLER_PHASES + 1) rows of m_taps
+    int16_t  m_hist[2 * RESAMPLER_MAX_TAPS * 2];        // last m_taps frames twice, the window is always contiguous
+    uint16_t m_histPos = 0;                             // oldest frame of the window
+    uint8_t  m_quality = RESAMPLER_BALANCED;
+    uint8_t  m_taps = 0;
+    float    m_cutoff = 0;                              // of the current table, relative to the input Nyquist
+    uint32_t m_inRate = 0;
+    uint32_t m_outRate = 0;
+    uint64_t m_step = 1ULL << 32;                       // input frames per output frame, Q32.32
+    uint64_t m_pos = 1ULL << 32;                        // next output position relative to the window centre
+    bool     m_bypass = true;
+};
@@ -0,0 +1,141 @@
+/*
+ * timestretch.cpp
+ *
+ *  WSOLA time stretcher, see timestretch.h
+ */
+#include "timestretch.h"
+
+//---------------------------------------------------------------------------------------------------------------------
+TimeStretch::~TimeStretch() {
+    if(m_buf) free(m_buf);
+}
+//---------------------------------------------------------------------------------------------------------------------
+bool TimeStretch::setSampleRate(uint32_t hz) {
+    if(!hz) return false;
+    if(hz == m_rate && m_buf) return true;           // same rate: the next track continues seamlessly
+    uint32_t r = min(hz, (uint32_t)48000);
+    uint16_t seq = r * 40 / 1000, seek = r * 15 / 1000, overlap = r * 8 / 1000;
+    size_t bytes = ((size_t)(seek + seq) * 2 + overlap * 3) * sizeof(int16_t);
+    int16_t* buf = (int16_t*)realloc(m_buf, bytes);
+    if(!buf) return false;
+    m_buf = buf;
+    m_mid = m_buf + (seek + seq) * 2;
+    m_midMono = m_mid + overlap * 2;
+    m_rate = hz; m_seq = seq; m_seek = seek; m_overlap = overlap;
+    reset();
+    return true;
+}
+//---------------------------------------------------------------------------------------------------------------------
+void TimeStretch::setSpeed(float speed) {
+    speed = constrain(speed, 0.5f, 2.0f);
+    m_speed = (uint32_t)(speed * 65536 + 0.5f);
+    if(m_speed > 65536 - 64 && m_speed < 65536 + 64) m_speed = 65536;
+}
+//---------------------------------------------------------------------------------------------------------------------
+void TimeStretch::reset() {
+    m_count = 0;
+    m_drop = 0;
+    m_emitPos = m_emitLen = 0;
+    m_skipFrac = 0;
+    m_f_haveMid = false;
+}
+//---------------------------------------------------------------------------------------------------------------------
+size_t TimeStretch::findOffset(size_t range) {
+    // Coarse pass on every 4th position and every 2nd sample, then every position around the best one.
+    // Score corr * |corr| / energy compares normalised correlations without a square root.
+    size_t best = 0;
+    float bestScore = -1e30f;
+    for(int pass = 0; pass < 2; pass++) {
+        size_t from = 0, to = range, step = 4, stride = 2;
+        if(pass) {from = best > 3 ? best - 3 : 0; to = min(best + 4, range); step = 1; stride = 1; bestScore = -1e30f;}
+        for(size_t o = from; o < to; o += step) {
+            int32_t corr = 0, energy = 1;
+            for(size_t k = 0; k < m_overlap; k += stride) {
+                int32_t x = mono(o + k);
+                corr   += x * m_midMono[k];
+                energy += x * x;
+            }
+            float score = (float)corr * fabsf((float)corr) / (float)energy;
+            if(score > bestScore) {bestScore = score; best = o;}
+        }
+    }
+    return best;
+}
+//---------------------------------------------------------------------------------------------------------------------
+void TimeStretch::startSegment() {
+    const bool drain = (m_speed == 65536);              // back at 1.0: play out what is buffered, then bypass
+    size_t range = m_count > m_overlap ? min((size_t)m_seek, m_count - m_overlap) : 1;
+    m_offset = m_f_haveMid ? findOffset(range) : 0;
+    if(m_offset > m_count) m_offset = m_count;
+    m_emitLen = drain ? m_count - m_offset : m_seq - m_overlap;
+    m_emitPos = 0;
+    if(drain) m_drop = 0;
+}
+//---------------------------------------------------------------------------------------------------------------------
+void TimeStretch::endSegment() {
+    m_emitPos = m_emitLen = 0;
+    if(m_speed == 65536 || m_offset + m_seq > m_count) {    // drained
+        m_count = 0;
+        m_f_haveMid = false;
+        return;
+    }
+    const int16_t* tail = m_buf + 2 * (m_offset + m_seq - m_overlap);
+    memcpy(m_mid, tail, m_overlap * 4);
+    for(uint16_t k = 0; k < m_overlap; k++) m_midMono[k] = (tail[2 * k] + tail[2 * k + 1]) >> 5;
+    m_f_haveMid = true;
+
+    uint32_t q = m_speed * (uint32_t)(m_seq - m_overlap) + m_skipFrac;
+    size_t skip = q >> 16;
+    m_skipFrac = q & 0xFFFF;
+    size_t removed = min(skip, m_count);
+    memmove(m_buf, m_buf + 2 * removed, (m_count - removed) * 4);
+    m_count -= removed;
+    m_drop = skip - removed;
+}
+//---------------------------------------------------------------------------------------------------------------------
+size_t TimeStretch::process(const int16_t* in, size_t frames, size_t* used, int16_t* out, size_t outCap) {
+    size_t nIn = 0, nOut = 0;
+    while(true) {
+        if(m_emitPos < m_emitLen) {
+            size_t n = min(m_emitLen - m_emitPos, outCap - nOut);
+            const int16_t* src = m_buf + 2 * (m_offset + m_emitPos);
+            for(size_t i = 0; i < n; i++, m_emitPos++) {
+                if(m_f_haveMid && m_emitPos < m_overlap) {  // linear cross-fade from the previous tail
+                    int32_t w = ((int32_t)m_emitPos << 15) / m_overlap;
+                    const int16_t* p = m_mid + 2 * m_emitPos;
+                    out[2 * (nOut + i)]     = p[0] + (((src[2 * i]     - p[0]) * w) >> 15);
+                    out[2 * (nOut + i) + 1] = p[1] + (((src[2 * i + 1] - p[1]) * w) >> 15);
+                }
+                else {
+                    out[2 * (nOut + i)]     = src[2 * i];
+                    out[2 * (nOut + i) + 1] = src[2 * i + 1];
+                }
+            }
+            nOut += n;
+            if(m_emitPos < m_emitLen) break;            // out is full
+            endSegment();
+            continue;
+        }
+        if(isBypassed()) {
+            m_drop = 0;
+            m_f_haveMid = false;                        // the next segment follows the passed-through audio
+            size_t n = min(frames - nIn, outCap - nOut);
+            memcpy(out + 2 * nOut, in + 2 * nIn, n * 4);
+            nIn += n; nOut += n;
+            break;
+        }
+        size_t d = min(m_drop, frames - nIn);           // input the last step jumped over
+        nIn += d; m_drop -= d;
+        const size_t cap = m_seek + m_seq;
+        size_t c = min(frames - nIn, cap - m_count);
+        memcpy(m_buf + 2 * m_count, in + 2 * nIn, c * 4);
+        m_count += c; nIn += c;
+        size_t need = m_f_haveMid ? cap : m_seq;        // the first segment is not searched, start sooner
+        if(m_speed == 65536 ? m_count == 0 : m_count < need) break;  // needs more input
+        if(nOut == outCap) break;
+        startSegment();
+        if(!m_emitLen) endSegment();                    // drain found nothing left to play
+    }
+    *used = nIn;
+    return nOut;
+}
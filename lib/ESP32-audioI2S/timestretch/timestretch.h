@@ -0,0 +1,44 @@
+/*
+ * timestretch.h
+ *
+ *  WSOLA time stretcher for 16 bit stereo: changes the tempo (0.5 ... 2.0)
+ *  without changing the pitch. Segments of 40 ms are taken from the input at
+ *  speed * 32 ms steps; each one is moved by up to 15 ms to the position whose
+ *  start best matches the tail of the previous segment (normalised cross
+ *  correlation of the mono mix, integer), then cross-faded over 8 ms.
+ *  Durations are fixed above 48 kHz to bound the buffer (about 13 KB).
+ */
+#pragma once
+
+#include "Arduino.h"
+
+class TimeStretch {
+public:
+    ~TimeStretch();
+    bool    setSampleRate(uint32_t hz);                 // a new rate clears the buffers; false if out of memory
+    void    setSpeed(float speed);                      // 0.5 ... 2.0, 1.0 drains the buffer and then passes through
+    float   getSpeed() {return m_speed / 65536.0f;}
+    void    reset();                                    // drop buffered audio, e.g. after a seek
+    // Same contract as Resampler::process(): interleaved stereo frames in, frames out, *used = frames consumed.
+    size_t  process(const int16_t* in, size_t frames, size_t* used, int16_t* out, size_t outCap);
+    bool    isBypassed() {return m_speed == 65536 && !m_count && m_emitPos == m_emitLen;}
+
+private:
+    inline int32_t mono(size_t i) {return (m_buf[2 * i] + m_buf[2 * i + 1]) >> 5;}  // 12 bit, sums stay in int32
+    size_t  findOffset(size_t range);
+    void    startSegment();
+    void    endSegment();
+
+    int16_t* m_buf = NULL;                              // input frames, m_seek + m_seq
+    int16_t* m_mid = NULL;                              // tail of the last segment, m_overlap frames
+    int16_t* m_midMono = NULL;                          // the same as mono() values
+    uint32_t m_rate = 0;
+    uint16_t m_seq = 0, m_seek = 0, m_overlap = 0;      // frames
+    size_t   m_count = 0;                               // frames in m_buf
+    size_t   m_drop = 0;                                // input still to skip (speed > 1)
+    size_t   m_offset = 0;                              // start of the segment being emitted in m_buf
+    size_t   m_emitPos = 0, m_emitLen = 0;
+    uint32_t m_speed = 65536;                           // Q16
+    uint32_t m_skipFrac = 0;                            // Q16 rest of the input step
+    bool     m_f_haveMid = false;
+};
@@ -0,0 +1,109 @@
+#!/usr/bin/env python3
+"""Convert a trace dump from the serial log into Chrome trace JSON.
+
+Build the firmware with -DENABLE_TRACE=1, reproduce the problem, press 't' and
+save the serial output (e.g. `pio device monitor | tee trace.log`). Then
+
+    python3 scripts/trace2perfetto.py trace.log -o trace.json
+
+and open trace.json in https://ui.perfetto.dev (or chrome://tracing). The last
+dump in the log is used; other log lines are ignored. One track per core:
+core 0 runs Task_TFT, core 1 Task_Audio.
+"""
+
+import argparse
+import json
+import sys
+
+# Event ids from include/trace.hpp: name, arg name at begin, arg name at end
+EVENTS = {
+    1: ("audio_loop", None, None),
+    2: ("sd_read", "requested", "bytes"),
+    3: ("decode", "codec", "consumed"),
+    4: ("i2s_write", "bytes", "written"),
+    16: ("ui_frame", "frame", None),
+    17: ("push_sprite", None, None),
+}
+CORE_NAMES = {0: "core 0 (Task_TFT)", 1: "core 1 (Task_Audio)"}
+
+
+def last_dump(lines):
+    """Records of the last complete TRACE,begin ... TRACE,end block."""
+    dump, current = None, None
+    for line in lines:
+        line = line.strip()
+        if line.startswith("TRACE,begin"):
+            current = []
+        elif line == "TRACE,end":
+            if current is not None:
+                dump = current
+            current = None
+        elif current is not None and line.startswith("T,"):
+            fields = line.split(",")
+            if len(fields) == 6:
+                try:
+                    current.append(tuple(int(f) for f in fields[1:]))
+                except ValueError:
+                    pass  # A log line from another task got mixed in
+    return dump
+
+
+def convert(records):
+    events = []
+    depth = {}  # core -> open begin records, to drop ends whose begin was overwritten
+    base = None
+    prev = None
+    wraps = 0
+    for us, core, event, phase, arg in records:
+        # 32-bit microseconds wrap after ~71 minutes; records are in claim order
+        if prev is not None and us < prev and prev - us > (1 << 31):
+            wraps += 1
+        prev = us
+        ts = us + (wraps << 32)
+        if base is None:
+            base = ts
+        name, begin_arg, end_arg = EVENTS.get(event, ("event_%d" % event, "arg", "arg"))
+        if phase == 0:
+            depth[core] = depth.get(core, 0) + 1
+            ev = {"name": name, "ph": "B", "ts": ts - base, "pid": 1, "tid": core}
+            if begin_arg:
+                ev["args"] = {begin_arg: arg}
+        else:
+            if depth.get(core, 0) == 0:
+                continue
+            depth[core] -= 1
+            ev = {"name": name, "ph": "E", "ts": ts - base, "pid": 1, "tid": core}
+            if end_arg:
+                ev["args"] = {end_arg: arg}
+        events.append(ev)
+
+    meta = [{"name": "process_name", "ph": "M", "pid": 1, "args": {"name": "Cardputer"}}]
+    for core in sorted(set(r[1] for r in records)):
+        meta.append({"name": "thread_name", "ph": "M", "pid": 1, "tid": core,
+                     "args": {"name": CORE_NAMES.get(core, "core %d" % core)}})
+    return {"traceEvents": meta + events, "displayTimeUnit": "ms"}
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("log", nargs="?", help="serial log (default: stdin)")
+    parser.add_argument("-o", "--output", help="JSON file (default: stdout)")
+    args = parser.parse_args()
+
+    src = open(args.log, encoding="utf-8", errors="replace") if args.log else sys.stdin
+    with src:
+        records = last_dump(src)
+    if not records:
+        sys.exit("no complete TRACE,begin ... TRACE,end block found")
+
+    trace = convert(records)
+    out = open(args.output, "w") if args.output else sys.stdout
+    with out:
+        json.dump(trace, out)
+    stamps = [e["ts"] for e in trace["traceEvents"] if "ts" in e]
+    span_ms = (max(stamps) if stamps else 0) / 1000.0
+    print("%d records, %.1f ms" % (len(records), span_ms), file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
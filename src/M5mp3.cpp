@@ -21,21 +21,25 @@
 #include "../include/board_init.hpp"    // Board / codec init (scaffold)
 #include "../include/audio_manager.hpp"  // Audio playback control
 #include "../include/file_manager.hpp"   // File operations (list, delete, screenshot)
+#include "../include/cover_cache.hpp"    // Decoded cover thumbnail cache
+#include "../include/glyph_cache.hpp"    // Cached CJK glyph bitmaps
+#include "../include/path_hash.hpp"
+#include "../include/sd_bench.hpp"     // SD read-size sweep (SD_READ_BENCHMARK)
+#include "../include/storage.hpp"      // SD mount and bus clock
+#include "../include/session.hpp"      // Playback session kept across power cycles
+#include "../include/diagnostics.hpp"  // Heap/stack telemetry and the diagnostics page
+#include "../include/output_monitor.hpp"  // I2S underrun / near-miss counters
+#include "../include/power_manager.hpp"   // CPU clock policy and battery drain
+#include "../include/trace.hpp"        // Hot-path trace ring (ENABLE_TRACE)
 M5Canvas sprite(&M5Cardputer.Display);
 // Removed unused canvas: spr
 // Step 3: Centralized application state
 AppState appState;
-// microSD card
-#define SD_SCK 40
-#define SD_MISO 39
-#define SD_MOSI 14
-#define SD_CS 12
+// microSD card: pins and bus setup live in Storage
 // Cardputer audio pin mappings provided by config.hpp
 
 // Hardware initialization functions have been migrated to BoardInit module
 
-#define BAT_ADC_PIN 10  // ADC pin used for battery reading - verify against schematic!
-
 // Hardware pin variables (initialized by BoardInit)
 static int audioBclkPin = CARDPUTER_ADV_I2S_BCLK;
 static int audioLrckPin = CARDPUTER_ADV_I2S_LRCK;
@@ -54,8 +58,10 @@ int sliderPos = 0;
 unsigned short light;
 // Removed unused variable: textPos (was set but never read)
 static bool lastHPState = false;
-// Task handle for audio task
+static TaskHandle_t hpWatchTask = nullptr;  // loop(), woken by the detect pin's edges
+// Task handles (audio task, UI task)
 TaskHandle_t handleAudioTask = NULL;
+TaskHandle_t handleTftTask = NULL;
 ESP32Time rtc(0);
 // Global flag to indicate codec init state so tasks can check it
 bool codec_initialized = false;
@@ -72,7 +78,7 @@ void resetClock() {
 
 // Wrapper functions for FileManager operations (required for function pointer compatibility)
 static void captureScreenshotWrapper() {
-  FileManager::captureScreenshot(SD, sprite, rtc);
+  FileManager::captureScreenshot(Storage::fs(), sprite, rtc);
 }
 
 static void deleteCurrentFileWrapper() {
@@ -82,7 +88,13 @@ static void deleteCurrentFileWrapper() {
     (void)deletedIndex;
     (void)newPlayingIndex;
   };
-  FileManager::deleteCurrentFile(SD, appState, fileCallbacks);
+  fileCallbacks.playQueueIndex = [](int queueIndex) {
+    AudioManager::requestTrack(Storage::fs(), appState, queueIndex);
+  };
+  fileCallbacks.stopPlayback = []() {
+    AudioManager::postCommand(AudioManager::AudioCommandType::Stop, 0);
+  };
+  FileManager::deleteCurrentFile(Storage::fs(), appState, fileCallbacks);
 }
 
 static String getParentDirectory(const String& path) {
@@ -93,9 +105,7 @@ static String getParentDirectory(const String& path) {
 
 // Detect language from text and return appropriate font
 // Returns efontKR_12 for Korean, efontJA_12 for Japanese, efontCN_12 for Chinese, or nullptr for default
-const lgfx::U8g2font* detectAndGetFont(const String& text) {
-  if (text.length() == 0) return nullptr;
-  
+static const lgfx::U8g2font* detectFontUncached(const String& text) {
   const uint8_t* utf8 = (const uint8_t*)text.c_str();
   bool hasKorean = false;
   bool hasJapanese = false;
@@ -160,6 +170,36 @@ const lgfx::U8g2font* detectAndGetFont(const String& text) {
   return nullptr;  // Use default font for English/other languages
 }
 
+// Same strings (list rows, ID3 fields) are drawn every frame, so remember the
+// font choice per string instead of re-walking the UTF-8 each time. The hash
+// only rejects quickly; a hit is confirmed against the stored text.
+struct FontChoice {
+  uint32_t hash = 0;
+  String text;
+  const lgfx::U8g2font* font = nullptr;
+};
+static FontChoice fontChoiceCache[FONT_CHOICE_CACHE_SIZE];
+static int fontChoiceWritePos = 0;
+
+const lgfx::U8g2font* detectAndGetFont(const String& text) {
+  if (text.length() == 0) return nullptr;
+
+  uint32_t hash = fnv1a32(text.c_str());
+  for (int i = 0; i < FONT_CHOICE_CACHE_SIZE; ++i) {
+    if (fontChoiceCache[i].hash == hash && fontChoiceCache[i].text == text) {
+      return fontChoiceCache[i].font;
+    }
+  }
+
+  const lgfx::U8g2font* font = detectFontUncached(text);
+  FontChoice& slot = fontChoiceCache[fontChoiceWritePos];
+  slot.hash = hash;
+  slot.text = text;
+  slot.font = font;
+  fontChoiceWritePos = (fontChoiceWritePos + 1) % FONT_CHOICE_CACHE_SIZE;
+  return font;
+}
+
 // Battery helper for M5Cardputer Advanced
 // M5Cardputer Advanced uses AXP2101 PMIC which provides accurate battery level
 // The library's getBatteryLevel() uses the PMIC's internal gauge for accurate readings
@@ -167,7 +207,9 @@ const lgfx::U8g2font* detectAndGetFont(const String& text) {
 static int getBatteryPercent() {
   // Try to use M5Cardputer's built-in Power API first (recommended for Advanced version)
   // This uses AXP2101 PMIC's internal battery gauge for accurate readings
+  BoardInit::lockI2c();
   int level = M5Cardputer.Power.getBatteryLevel();
+  BoardInit::unlockI2c();
   
   // If Power API returns valid value (0-100), use it
   // Returns -1 or -2 if not supported or error
@@ -180,22 +222,28 @@ static int getBatteryPercent() {
   // Voltage range: 3.3V (0%) to 4.2V (100%) is typical for Li-Po batteries
   // Note: Battery capacity (mAh) doesn't directly affect voltage-to-percentage calculation
   // The voltage range is determined by battery chemistry, not capacity
-  int raw = analogRead(BAT_ADC_PIN);
-  float voltage = (raw / 4095.0f) * 3.3f * 2.0f; // 2:1 voltage divider assumption
-  int mv = (int)(voltage * 1000.0f);
+  int mv = PowerManager::batteryMillivolts();
   
   // Voltage-to-percentage mapping for Li-Po batteries
   // 3.3V = 0%, 4.2V = 100% (typical range)
   // Note: This is a linear approximation; actual battery discharge curve is non-linear
-  int percent = constrain(map(mv, 3300, 4200, 0, 100), 0, 100);
+  int percent = constrain(map(mv, (long)BATTERY_EMPTY_MV, (long)BATTERY_FULL_MV, 0, 100), 0, 100);
   return percent;
 }
 
+static void IRAM_ATTR onHpDetectEdge() {
+  BaseType_t woken = pdFALSE;
+  if (hpWatchTask) vTaskNotifyGiveFromISR(hpWatchTask, &woken);
+  if (woken) portYIELD_FROM_ISR();
+}
+
 // Hardware initialization functions have been migrated to BoardInit module
 void setup() {
   LOG_INIT(115200);
   LOG_PRINTLN("hi");
   resetClock();
+  // Volume, brightness, play mode etc. from the last session, before anything uses them
+  Session::loadSettings(appState);
   // Initialize M5Cardputer and SD card
   auto cfg = M5.config();
   cfg.serial_baudrate = 115200;
@@ -213,24 +261,28 @@ void setup() {
   // Enable UTF-8 support for Chinese character display
   M5Cardputer.Display.setAttribute(utf8_switch, true);
   sprite.createSprite(SCREEN_WIDTH, SCREEN_HEIGHT);
-  SPI.begin(SD_SCK, SD_MISO, SD_MOSI);
-  if (!SD.begin(SD_CS)) {
-    LOG_PRINTLN(F("ERROR: SD Mount Failed!"));
-  }
+  GlyphCache::initialize();
+  Storage::begin();
+  CoverCache::initialize(Storage::fs());
   // Load persistent library index; rebuild when index file is missing/invalid.
-  if (!FileManager::loadLibraryIndex(SD, appState)) {
-    FileManager::rebuildLibraryIndex(SD, MUSIC_DIR, LIBRARY_SCAN_MAX_DEPTH, appState);
+  if (!FileManager::loadLibraryIndex(Storage::fs(), appState)) {
+    FileManager::rebuildLibraryIndex(Storage::fs(), MUSIC_DIR, LIBRARY_SCAN_MAX_DEPTH, appState);
   }
   if (appState.libraryCount == 0) {
     LOG_PRINTLN("No files found in /music, scanning root as fallback");
-    FileManager::rebuildLibraryIndex(SD, "/", LIBRARY_SCAN_MAX_DEPTH, appState);
+    FileManager::rebuildLibraryIndex(Storage::fs(), "/", LIBRARY_SCAN_MAX_DEPTH, appState);
   }
-  if (!FileManager::buildQueueForDirectory(SD, appState, MUSIC_DIR, -1)) {
-    (void)FileManager::buildQueueForDirectory(SD, appState, "/", -1);
+  uint32_t resumeFilePos = 0;
+  if (!Session::restoreQueue(Storage::fs(), appState, resumeFilePos) &&
+      !FileManager::buildQueueForDirectory(Storage::fs(), appState, MUSIC_DIR, -1)) {
+    (void)FileManager::buildQueueForDirectory(Storage::fs(), appState, "/", -1);
   }
   // Initialize AudioManager with the global Audio instance (must be before BoardInit)
   AudioManager::setAudioInstance(&audio);
   AudioManager::initialize(appState);
+  if (appState.playbackSpeedPct != 100) {
+    AudioManager::postCommand(AudioManager::AudioCommandType::SetSpeed, appState.playbackSpeedPct);
+  }
   
   // Detect board variant and initialize audio hardware
   BoardInit::Variant detected = BoardInit::detectVariant();
@@ -242,18 +294,20 @@ void setup() {
   // Initialize lastHPState if headphone detect pin is available
   if (hpDetectPin >= 0) {
     lastHPState = (digitalRead(hpDetectPin) == LOW);
+    hpWatchTask = xTaskGetCurrentTaskHandle();  // setup() and loop() share the Arduino loop task
+    attachInterrupt(digitalPinToInterrupt(hpDetectPin), onHpDetectEdge, CHANGE);
   }
   
   // Configure keyboard driver
   BoardInit::configureKeyboard(detected);
   if (appState.fileCount > 0) {
     String selectedPath;
-    if (FileManager::getPathByQueueIndex(SD, appState, appState.currentSelectedIndex, selectedPath)) {
+    if (FileManager::getPathByQueueIndex(Storage::fs(), appState, appState.currentSelectedIndex, selectedPath)) {
       LOG_PRINTF("Trying to play: %s\n", selectedPath.c_str());
       // Double-check the file exists
-      if (SD.exists(selectedPath)) {
+      if (Storage::fs().exists(selectedPath)) {
         // Open the file directly and print size + header bytes for verification
-        File f = SD.open(selectedPath);
+        File f = Storage::fs().open(selectedPath);
         if (f) {
           uint32_t sz = f.size();
           LOG_PRINTF("SD open OK, size=%u bytes\n", (unsigned)sz);
@@ -271,8 +325,15 @@ void setup() {
         } else {
           LOG_PRINTLN("SD.open failed (could not read file)");
         }
+#if SD_READ_BENCHMARK
+        SdBench::sweepReadSizes(Storage::fs(), selectedPath.c_str());
+#endif
         // Always connect; decoding + ID3 parsing should not depend on codec init state
-        AudioManager::connectToFile(SD, selectedPath.c_str());
+        MediaInfo::ReplayGain gain;
+        FileManager::getReplayGainByQueueIndex(Storage::fs(), appState, appState.currentSelectedIndex, gain);
+        String folderCover;
+        FileManager::getFolderCoverPath(Storage::fs(), appState, selectedPath.c_str(), folderCover);
+        AudioManager::connectToFile(Storage::fs(), selectedPath.c_str(), gain, resumeFilePos, folderCover.c_str());
         appState.currentPlayingIndex = appState.currentSelectedIndex;  // Sync playing index on initialization
         appState.isPlaying = true;
         appState.stopped = false;
@@ -298,8 +359,13 @@ void setup() {
   appState.lastGraphUpdate = millis();
   
   // Create tasks and pin them to different cores
-  xTaskCreatePinnedToCore(Task_TFT, "Task_TFT", 20480, NULL, 2, NULL, 0);                  // Core 0
-  xTaskCreatePinnedToCore(Task_Audio, "Task_Audio", 10240, NULL, 3, &handleAudioTask, 1);  // Core 1
+  xTaskCreatePinnedToCore(Task_TFT, "Task_TFT", UI_TASK_STACK_SIZE, NULL, 2, &handleTftTask, 0);           // Core 0
+  xTaskCreatePinnedToCore(Task_Audio, "Task_Audio", AUDIO_TASK_STACK_SIZE, NULL, 3, &handleAudioTask, 1);  // Core 1
+  Diagnostics::registerTask("tft", handleTftTask, UI_TASK_STACK_SIZE);
+  Diagnostics::registerTask("audio", handleAudioTask, AUDIO_TASK_STACK_SIZE);
+  Diagnostics::registerTask("loop", xTaskGetCurrentTaskHandle(), CONFIG_ARDUINO_LOOP_STACK_SIZE);
+  OutputMonitor::start(AudioManager::getAudioInstance(), handleAudioTask);
+  PowerManager::initialize();
 }
 void loop() {
   // Poll headphone detect and gate AMP_EN accordingly
@@ -318,7 +384,11 @@ void loop() {
       }
     }
   }
-  delay(200);  // Increase polling interval to reduce CPU usage
+  // Sleep until the detect pin changes (then let it settle); the timeout covers a missed edge
+  if (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(HP_DETECT_FALLBACK_MS))) {
+    delay(HP_DETECT_DEBOUNCE_MS);
+    ulTaskNotifyTake(pdTRUE, 0);  // Bounces during the wait
+  }
 }
 
 // Step 2: Split draw() into smaller functions
@@ -331,6 +401,10 @@ void drawId3Page() {
 // (removed original implementation after extraction)
 
 void draw() {
+  if (appState.showDiagPage) {
+    UiRenderer::drawDiagnosticsPage(sprite, appState, grays);
+    return;
+  }
   if (appState.showID3Page) {
     drawId3Page();
     return;
@@ -341,8 +415,16 @@ void draw() {
 }
 
 void Task_TFT(void *pvParameters) {
+  AudioManager::bindUiTask();
+#if ENABLE_TRACE
+  uint32_t frameNo = 0;
+#endif
   while (1) {
+    TRACE_BEGIN(UiFrame, frameNo++);
+    AudioManager::pollEvents(Storage::fs(), appState);
+    BoardInit::lockI2c();  // Keyboard scan shares the bus with Task_Audio's codec writes
     M5Cardputer.update();
+    BoardInit::unlockI2c();
     // Check for key press events
     if (M5Cardputer.Keyboard.isChange()) {
       // Centralized handlers
@@ -356,11 +438,11 @@ void Task_TFT(void *pvParameters) {
           String browserStartDir = appState.queueDirectory;
           if (appState.fileCount > 0 && appState.currentSelectedIndex >= 0 && appState.currentSelectedIndex < appState.fileCount) {
             String selectedPath;
-            if (FileManager::getPathByQueueIndex(SD, appState, appState.currentSelectedIndex, selectedPath)) {
+            if (FileManager::getPathByQueueIndex(Storage::fs(), appState, appState.currentSelectedIndex, selectedPath)) {
               browserStartDir = getParentDirectory(selectedPath);
             }
           }
-          if (FileManager::buildBrowserEntries(SD, appState, browserStartDir.c_str())) {
+          if (FileManager::buildBrowserEntries(Storage::fs(), appState, browserStartDir.c_str())) {
             appState.browserMode = true;
             appState.currentSelectedIndex = 0;
             appState.showDeleteDialog = false;
@@ -381,12 +463,10 @@ void Task_TFT(void *pvParameters) {
           if (appState.currentSelectedIndex >= appState.browserEntryCount) appState.currentSelectedIndex = 0;
         }
         if (M5Cardputer.Keyboard.isKeyPressed('g')) {
-          if (FileManager::buildQueueForDirectory(SD, appState, appState.browserCurrentDir.c_str(), -1)) {
+          if (FileManager::buildQueueForDirectory(Storage::fs(), appState, appState.browserCurrentDir.c_str(), -1)) {
             appState.browserMode = false;
             resetClock();
-            appState.isPlaying = false;
-            appState.stopped = false;
-            appState.nextS = 1;
+            AudioManager::requestTrack(Storage::fs(), appState, appState.currentSelectedIndex);
             LOG_PRINTF("Play folder recursively: %s\n", appState.queueDirectory.c_str());
           } else {
             LOG_PRINTF("Folder has no playable songs: %s\n", appState.browserCurrentDir.c_str());
@@ -398,18 +478,17 @@ void Task_TFT(void *pvParameters) {
               appState.currentSelectedIndex < appState.browserEntryCount) {
             int idx = appState.currentSelectedIndex;
             if (appState.browserEntryIsDir[idx]) {
-              String targetDir = appState.browserEntryPath[idx];
-              if (!FileManager::buildBrowserEntries(SD, appState, targetDir.c_str())) {
+              // buildBrowserEntries() resets the arena the path lives in
+              String targetDir = appState.browserPath(idx).toString();
+              if (!FileManager::buildBrowserEntries(Storage::fs(), appState, targetDir.c_str())) {
                 LOG_PRINTF("Failed to enter folder: %s\n", targetDir.c_str());
               }
             } else {
               int songIndex = appState.browserEntrySongIndex[idx];
-              if (FileManager::buildQueueForDirectory(SD, appState, appState.browserCurrentDir.c_str(), songIndex)) {
+              if (FileManager::buildQueueForDirectory(Storage::fs(), appState, appState.browserCurrentDir.c_str(), songIndex)) {
                 appState.browserMode = false;
                 resetClock();
-                appState.isPlaying = false;
-                appState.stopped = false;
-                appState.nextS = 1;
+                AudioManager::requestTrack(Storage::fs(), appState, appState.currentSelectedIndex);
               }
             }
           }
@@ -417,33 +496,37 @@ void Task_TFT(void *pvParameters) {
       } else {
         (void)InputHandler::processPlaybackAndList(appState);
       }
+      (void)InputHandler::processSeekKeys(appState);
+      (void)InputHandler::processSpeedKey(appState);
+      (void)InputHandler::processReplayGainKey(appState);
+      (void)InputHandler::processLatencyKey(appState);
       InputHandler::Actions acts;
       acts.captureScreenshot = &captureScreenshotWrapper;
       acts.deleteCurrentFile = &deleteCurrentFileWrapper;
       (void)InputHandler::processDeleteAndScreenshot(appState, acts);
 
       if (M5Cardputer.Keyboard.isKeyPressed('a')) {
-        appState.isPlaying = !appState.isPlaying;
-        appState.stopped = !appState.stopped;
+        // Task_Audio owns the state; appState follows through pollEvents()
+        AudioManager::postCommand(AudioManager::AudioCommandType::TogglePause, 0);
       }  // Toggle the playback state
+      int volumeBefore = appState.volume;
       if (M5Cardputer.Keyboard.isKeyPressed('v')) {
-        appState.isPlaying = false;
-        appState.volUp = true;
         appState.volume = appState.volume + 5;
         if (appState.volume > 20) appState.volume = 5;
       }
       if (M5Cardputer.Keyboard.isKeyPressed('-')) {
         // '-' key: Decrease appState.volume
-        appState.volUp = true;
         appState.volume = appState.volume - 1;
         if (appState.volume < 0) appState.volume = 0;
       }
       if (M5Cardputer.Keyboard.isKeyPressed('=')) {
         // '=' key: Increase appState.volume
-        appState.volUp = true;
         appState.volume = appState.volume + 1;
         if (appState.volume > 21) appState.volume = 21;
       }
+      if (appState.volume != volumeBefore) {
+        AudioManager::postCommand(AudioManager::AudioCommandType::SetVolume, appState.volume);
+      }
       if (M5Cardputer.Keyboard.isKeyPressed('l')) {
         appState.brightnessIndex++;
         if (appState.brightnessIndex == 5) appState.brightnessIndex = 0;
@@ -451,66 +534,29 @@ void Task_TFT(void *pvParameters) {
       }
       // All other keys handled by InputHandler
     }
+    Diagnostics::update(appState.showDiagPage && !appState.screenOff);
+    PowerManager::update(appState);
     // If screen is off, skip drawing to save CPU
     if (!appState.screenOff) {
       draw();
     }
-    vTaskDelay(50 / portTICK_PERIOD_MS);  // Balance refresh rate: 50ms (20fps), smooth and power-efficient
+    Session::update(appState);
+    TRACE_END(UiFrame, 0);
+    // 50ms (20fps) frame, cut short when Task_Audio posts an event (end of track)
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(UI_FRAME_MS));
   }
 }
 
 void Task_Audio(void *pvParameters) {
-  static unsigned long lastLog = 0;
-  const TickType_t playDelay = pdMS_TO_TICKS(1);
-  const TickType_t idleDelay = pdMS_TO_TICKS(20);
-
+  AudioManager::bindAudioTask();
   while (1) {
-    if (appState.volUp) {
-      AudioManager::setVolume(appState.volume);
-      appState.isPlaying = true;
-      appState.volUp = false;
-    }
-
-    if (appState.nextS) {
-      AudioManager::stop();
-      String selectedPath;
-      if (FileManager::getPathByQueueIndex(SD, appState, appState.currentSelectedIndex, selectedPath)) {
-        LOG_PRINTF("Task_Audio: next track requested: %s\n", selectedPath.c_str());
-        if (SD.exists(selectedPath)) {
-          // Reset ID3 metadata before opening the next file to avoid stale display
-          appState.resetID3Metadata();
-          AudioManager::connectToFile(SD, selectedPath.c_str());
-          appState.currentPlayingIndex = appState.currentSelectedIndex;  // Update actual playing index
-          // Reset audio info cache when switching songs (will be updated after decoder initializes)
-          appState.cachedAudioInfo = "";
-          appState.lastAudioInfoUpdate = millis();  // Reset timer to allow decoder initialization time
-        } else {
-          LOG_PRINTF("Task_Audio: file not found: %s\n", selectedPath.c_str());
-        }
-      } else {
-        LOG_PRINTF("Task_Audio: failed to resolve queue index %d\n", appState.currentSelectedIndex);
-      }
-      appState.isPlaying = true;
-      appState.stopped = false;  // Ensure playback is not stopped after switching tracks
-      appState.nextS = 0;
-    }
-
-    // Do not gate decoding/ID3 parsing on codec_initialized; allow loop() to run
-    if (appState.isPlaying && !appState.stopped) {
-      AudioManager::loop(appState, codec_initialized);
-
-      if (millis() - lastLog >= 500) {
-        int ampState = -1;
-        if (ampEnablePin >= 0) {
-          ampState = digitalRead(ampEnablePin);
-        }
-        //Serial.printf("Task_Audio: audio.loop() heartbeat  codec_initialized=%d AMP_EN=%d ES_ADDR=0x%02X\n", codec_initialized ? 1 : 0, ampState, ES8311_ADDR);
-        lastLog = millis();
-      }
-
-      vTaskDelay(playDelay);
-    } else {
-      vTaskDelay(idleDelay);
+    // Commands are applied between decode calls, so Task_Audio is the only task touching Audio
+    AudioManager::processCommands();
+    // Do not gate decoding/ID3 parsing on codec_initialized; allow loop() to run.
+    // While playing, i2s_write blocks once the DMA buffers are full, which paces this loop;
+    // otherwise sleep until the UI posts a command.
+    if (!AudioManager::loop(codec_initialized)) {
+      ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
     }
   }
 }
@@ -521,14 +567,20 @@ void Task_Audio(void *pvParameters) {
 // File operations have been migrated to FileManager module
 
 void audio_eof_mp3(const char *info) {
-  AudioManager::onEOF(info, appState, SD);
+  AudioManager::onEOF(info);
 }
 
 void audio_id3data(const char* info) {
-  AudioManager::onID3Data(info, appState);
+  AudioManager::onID3Data(info);
 }
 
 void audio_id3image(File& file, const size_t pos, const size_t size) {
-  AudioManager::onID3Image(file, pos, size, appState);
+  AudioManager::onID3Image(file, pos, size);
+}
+
+#if ENABLE_TRACE
+void audio_trace(uint8_t point, bool begin, uint32_t arg) {
+  Trace::record(point, begin ? Trace::Begin : Trace::End, arg);
 }
+#endif
 
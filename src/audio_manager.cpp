@@ -4,8 +4,16 @@
 #include "../include/audio_manager.hpp"
 #include "../include/config.hpp"
 #include "../include/file_manager.hpp"
+#include "../include/cover_cache.hpp"
+#include "../include/storage.hpp"
+#include "../include/path_hash.hpp"
+#include "../include/seqlock.hpp"
+#include "../include/spsc_queue.hpp"
+#include "../include/output_monitor.hpp"
+#include "../include/trace.hpp"
 #include "M5Cardputer.h"
 #include <ESP32Time.h>
+#include <esp_heap_caps.h>
 
 // Forward declaration for resetClock
 extern void resetClock();
@@ -14,16 +22,417 @@ extern ESP32Time rtc;
 // Global Audio instance (managed by AudioManager)
 static Audio* g_audio = nullptr;
 
+// Track opened by the last connectToFile
+static fs::FS* g_currentFs = nullptr;
+static String g_currentPath;
+// Its folder cover, until the header shows whether there is an embedded one
+static String g_folderCoverPending;
+
+// Seek index state of the current track, to skip rewriting an unchanged index
+static uint32_t g_currentFileSize = 0;
+static uint16_t g_seekIndexLoadedCount = 0;
+static uint32_t g_seekIndexLoadedFrames = 0;
+
+// UI -> Task_Audio
+static SpscQueue<AudioManager::AudioCommand, AUDIO_COMMAND_QUEUE_LEN> g_commands;
+static Seqlock<AudioManager::TrackRequest> g_trackRequest;
+static uint32_t g_requestSerial = 0;  // UI side, last TrackRequest serial
+static TaskHandle_t g_audioTask = nullptr;
+
+// Task_Audio -> UI
+static SpscQueue<AudioManager::AudioEvent, AUDIO_EVENT_QUEUE_LEN> g_events;
+static Seqlock<AudioManager::PlaybackStatus> g_status;
+static Seqlock<AudioManager::NowPlaying> g_nowPlaying;
+static TaskHandle_t g_uiTask = nullptr;
+
+// Task_Audio's working copies of what it publishes
+static AudioManager::PlaybackStatus g_statusLocal = {};
+static AudioManager::NowPlaying g_npLocal = {};
+static uint32_t g_statusPublishedMs = 0;
+
+// This frame's copies, taken by pollEvents() (UI side)
+static AudioManager::PlaybackStatus g_statusFrame = {};
+static AudioManager::NowPlaying g_npFrame = {};
+static uint32_t g_statusSeen = 0;
+static uint32_t g_npSeen = 0;
+
+static bool g_seekLatencyPending = false;
+static uint32_t g_seekIssuedMs = 0;
+static uint32_t g_resumeMillisBefore = 0;
+static int32_t g_pendingSpeedPct = -1;  // The stretcher needs the track's rate, kept until it is known
+
+// ReplayGain of the current track and the mode it is applied in
+static MediaInfo::ReplayGain g_trackGain;
+static uint8_t g_replayGainMode = REPLAYGAIN_DEFAULT_MODE;
+
+// I2S DMA latency mode; auto mode's size is kept across mode changes until reboot
+static uint8_t g_latencyMode = LATENCY_DEFAULT_MODE;
+static uint32_t g_refillBelowMs = 0;
+static uint16_t g_autoBuffers = LATENCY_AUTO_MIN_BUFFERS;
+static uint32_t g_autoUnderruns = 0;    // OutputMonitor count already acted on
+static uint32_t g_autoResizedMs = 0;
+
+namespace {
+
+struct SeekIndexHeader {
+  uint32_t magic;
+  uint32_t fileSize;     // Index is discarded when the track size changes
+  uint32_t totalFrames;  // Non-zero once the index reached EOF
+  uint16_t count;
+  uint16_t reserved;
+};
+
+void applyReplayGain() {
+  if (g_replayGainMode == REPLAYGAIN_MODE_OFF) {
+    g_audio->setReplayGain(0);
+    return;
+  }
+  const int16_t unknown = MediaInfo::ReplayGain::kUnknownGain;
+  // Album mode falls back to the track gain and track mode to the album gain
+  bool album = g_replayGainMode == REPLAYGAIN_MODE_ALBUM ? g_trackGain.albumGain != unknown
+                                                         : g_trackGain.trackGain == unknown;
+  int16_t gain = album ? g_trackGain.albumGain : g_trackGain.trackGain;
+  uint16_t peak = album ? g_trackGain.albumPeak : g_trackGain.trackPeak;
+  float db = gain == unknown ? REPLAYGAIN_UNTAGGED_DB : gain / 100.0f + REPLAYGAIN_PREAMP_DB;
+  g_audio->setReplayGain(db, peak / 10000.0f);
+  LOG_PRINTF("ReplayGain: %s %.2f dB -> x%.3f\n", gain == unknown ? "untagged" : (album ? "album" : "track"),
+             db, g_audio->getReplayGain());
+}
+
+// Reinstall the I2S driver with count x frames DMA buffers, unless growing would leave less
+// than LATENCY_HEAP_RESERVE_BYTES of DMA-capable RAM. Drops what is queued.
+bool resizeDma(uint16_t count, uint16_t frames) {
+  uint32_t frameBytes = g_audio->getI2sFrameBytes();
+  uint32_t oldBytes = g_audio->getI2sDmaBufBytes() * g_audio->getI2sDmaBufCount();
+  uint32_t bufBytes = (uint32_t)frames * frameBytes;
+  if (bufBytes > 4092) bufBytes = 4092 / frameBytes * frameBytes;  // As the driver allocates it
+  uint32_t newBytes = count * bufBytes;
+  if (newBytes > oldBytes &&
+      heap_caps_get_free_size(MALLOC_CAP_DMA) + oldBytes < newBytes + LATENCY_HEAP_RESERVE_BYTES) {
+    LOG_PRINTF("Latency: %u x %u needs %lu bytes, not enough RAM\n", (unsigned)count, (unsigned)frames,
+               (unsigned long)newBytes);
+    return false;
+  }
+  return g_audio->setI2sDmaBuffers(count, frames);
+}
+
+void applyLatencyMode(uint8_t mode) {
+  static const char* const kNames[] = {"balanced", "low", "battery", "auto"};
+  g_latencyMode = mode < LATENCY_MODE_COUNT ? mode : LATENCY_DEFAULT_MODE;
+  bool ok;
+  if (g_latencyMode == LATENCY_MODE_AUTO) {
+    OutputMonitor::Stats out;
+    OutputMonitor::read(out);
+    g_autoUnderruns = out.underruns;  // Only underruns from now on make it grow
+    g_autoResizedMs = millis();
+    g_refillBelowMs = 0;
+    ok = resizeDma(g_autoBuffers, LATENCY_AUTO_FRAMES);
+  } else {
+    g_refillBelowMs = LATENCY_REFILL_BELOW_MS[g_latencyMode];
+    ok = resizeDma(LATENCY_DMA_BUFFERS[g_latencyMode], LATENCY_DMA_FRAMES[g_latencyMode]);
+  }
+  LOG_PRINTF("Latency: %s, DMA %u x %u%s\n", kNames[g_latencyMode], (unsigned)g_audio->getI2sDmaBufCount(),
+             (unsigned)g_audio->getI2sDmaBufLen(), ok ? "" : " (kept)");
+}
+
+// Auto mode: a step more DMA after each underrun, at most once per LATENCY_AUTO_HOLDOFF_MS
+// (the resize itself empties the DMA)
+void updateAutoLatency() {
+  if (g_latencyMode != LATENCY_MODE_AUTO) return;
+  OutputMonitor::Stats out;
+  OutputMonitor::read(out);
+  if (out.underruns == g_autoUnderruns) return;
+  g_autoUnderruns = out.underruns;
+  if (millis() - g_autoResizedMs < LATENCY_AUTO_HOLDOFF_MS || g_autoBuffers >= LATENCY_AUTO_MAX_BUFFERS) return;
+  g_autoResizedMs = millis();
+  uint16_t next = g_autoBuffers + LATENCY_AUTO_STEP_BUFFERS;
+  if (next > LATENCY_AUTO_MAX_BUFFERS) next = LATENCY_AUTO_MAX_BUFFERS;
+  if (!resizeDma(next, LATENCY_AUTO_FRAMES)) return;
+  g_autoBuffers = next;
+  LOG_PRINTF("Latency: underrun, auto DMA grown to %u x %u\n", (unsigned)next, (unsigned)LATENCY_AUTO_FRAMES);
+}
+
+// Read position minus what is still buffered
+uint32_t decodeFilePos() {
+  if (!g_audio || !g_audio->isRunning()) return 0;
+  uint32_t pos = g_audio->getFilePos();
+  uint32_t buffered = g_audio->inBufferFilled();
+  return pos > buffered ? pos - buffered : 0;
+}
+
+void publishStatus() {
+  g_statusLocal.filePos = decodeFilePos();
+  g_statusLocal.positionSec = g_audio ? g_audio->getAudioCurrentTime() : 0;
+  AudioManager::PlaybackStatus::Load& load = g_statusLocal.load;
+  load = {};
+  if (g_audio && !g_statusLocal.paused && g_audio->isRunning()) {
+    load.sampleRate = g_audio->getSampleRate();
+    load.bitsPerSample = g_audio->getBitsPerSample();
+    strlcpy(load.codec, load.sampleRate ? g_audio->getCodecname() : "", sizeof(load.codec));
+    uint32_t outRate = g_audio->getOutputSampleRate();
+    load.resampling = outRate && outRate != load.sampleRate;
+    load.stretching = g_audio->getPlaybackSpeed() != 1.0f;
+  }
+  g_status.publish(g_statusLocal);
+  g_statusPublishedMs = millis();
+}
+
+void pushEvent(AudioManager::AudioEventType type) {
+  AudioManager::AudioEvent ev = {type, g_statusLocal.trackSerial};
+  if (!g_events.push(ev)) LOG_PRINTLN("AudioManager: event queue full");
+  if (g_uiTask) xTaskNotifyGive(g_uiTask);
+}
+
+// Format and duration become known (and the duration more exact) while the track plays
+void refreshFormat() {
+  AudioManager::NowPlaying& np = g_npLocal;
+  uint32_t rate = g_audio->getSampleRate();
+  uint8_t bits = g_audio->getBitsPerSample();
+  uint8_t channels = g_audio->getChannels();
+  uint32_t duration = g_audio->getAudioFileDuration();
+  if (rate == np.sampleRate && bits == np.bitsPerSample && channels == np.channels && duration == np.durationSec) {
+    return;
+  }
+  np.sampleRate = rate;
+  np.bitsPerSample = bits;
+  np.channels = channels;
+  np.durationSec = duration;
+  strlcpy(np.codec, rate ? g_audio->getCodecname() : "", sizeof(np.codec));
+  g_nowPlaying.publish(np);
+}
+
+// UI side of the end of a track: pick the next one by play mode
+void advanceQueue(fs::FS& fs, AppState& appState) {
+  resetClock();
+  if (appState.fileCount <= 0) {
+    LOG_PRINTLN("eof: queue is empty");
+    return;
+  }
+  int next = appState.currentPlayingIndex;
+  if (appState.playMode == PlaybackMode::Sequential) {
+    next++;
+    if (next >= appState.fileCount) next = 0;
+  } else if (appState.playMode == PlaybackMode::Random) {
+    next = random(0, appState.fileCount);
+  }  // SingleRepeat: same index again
+  LOG_PRINTF("eof: next queue index %d (mode %d)\n", next, static_cast<int>(appState.playMode));
+  if (AudioManager::requestTrack(fs, appState, next)) {
+    appState.currentSelectedIndex = next;  // Sync selected index to playing index
+  }
+}
+
+void seekIndexPath(const char* trackPath, char* out, size_t outLen) {
+  snprintf(out, outLen, "%s/%08lx.idx", SEEK_INDEX_DIR, (unsigned long)fnv1a32(trackPath));
+}
+
+void loadSeekIndex(fs::FS& fs, const char* trackPath) {
+  g_seekIndexLoadedCount = 0;
+  g_seekIndexLoadedFrames = 0;
+  char name[48];
+  seekIndexPath(trackPath, name, sizeof(name));
+  if (!fs.exists(name)) return;
+  File f = fs.open(name, FILE_READ);
+  if (!f) return;
+  SeekIndexHeader hdr;
+  bool ok = f.read((uint8_t*)&hdr, sizeof(hdr)) == sizeof(hdr) &&
+            hdr.magic == SEEK_INDEX_MAGIC && hdr.fileSize == g_currentFileSize;
+  uint32_t* entries = nullptr;
+  if (ok && hdr.count > 0) {
+    entries = (uint32_t*)malloc(hdr.count * sizeof(uint32_t));
+    ok = entries && f.read((uint8_t*)entries, hdr.count * sizeof(uint32_t)) == hdr.count * sizeof(uint32_t);
+  }
+  f.close();
+  if (ok && g_audio->setSeekIndex(entries, hdr.count, hdr.totalFrames)) {
+    g_seekIndexLoadedCount = hdr.count;
+    g_seekIndexLoadedFrames = hdr.totalFrames;
+    LOG_PRINTF("Seek index: loaded %u entries%s\n", (unsigned)hdr.count, hdr.totalFrames ? " (complete)" : "");
+  }
+  free(entries);
+}
+
+// Write the current track's index if playback extended it
+void saveSeekIndex() {
+  if (!g_audio || !g_currentFs || g_currentPath.length() == 0) return;
+  const uint32_t* entries = nullptr;
+  uint32_t totalFrames = 0;
+  uint16_t count = g_audio->getSeekIndex(&entries, &totalFrames);
+  if (count == 0 || (count <= g_seekIndexLoadedCount && totalFrames == g_seekIndexLoadedFrames)) return;
+
+  fs::FS& fs = *g_currentFs;
+  if (!fs.exists(SEEK_INDEX_DIR) && !fs.mkdir(SEEK_INDEX_DIR)) {
+    LOG_PRINTF("Seek index: cannot create %s\n", SEEK_INDEX_DIR);
+    return;
+  }
+  char name[48];
+  seekIndexPath(g_currentPath.c_str(), name, sizeof(name));
+  File f = fs.open(name, FILE_WRITE);
+  if (!f) return;
+  SeekIndexHeader hdr = {SEEK_INDEX_MAGIC, g_currentFileSize, totalFrames, count, 0};
+  f.write((const uint8_t*)&hdr, sizeof(hdr));
+  f.write((const uint8_t*)entries, count * sizeof(uint32_t));
+  f.close();
+  g_seekIndexLoadedCount = count;
+  g_seekIndexLoadedFrames = totalFrames;
+  LOG_PRINTF("Seek index: saved %u entries for %s\n", (unsigned)count, g_currentPath.c_str());
+}
+
+}  // namespace
+
 namespace AudioManager {
 
+void NowPlaying::clear() {
+  memset(this, 0, sizeof(*this));
+  textUsed = 1;  // text[0] is the empty string every unset field points at
+}
+
+void NowPlaying::setField(Field f, const char* value, size_t len) {
+  // Drop the old value and close the gap
+  uint16_t old = textOffset[f];
+  if (old) {
+    uint16_t oldLen = strlen(text + old) + 1;
+    memmove(text + old, text + old + oldLen, textUsed - old - oldLen);
+    textUsed -= oldLen;
+    for (int i = 0; i < FieldCount; ++i) {
+      if (textOffset[i] > old) textOffset[i] -= oldLen;
+    }
+    textOffset[f] = 0;
+  }
+  size_t room = sizeof(text) - textUsed;
+  if (len == 0 || room < 2) return;
+  if (len >= room) {
+    len = room - 1;
+    while (len > 0 && ((uint8_t)value[len] & 0xC0) == 0x80) len--;  // Never end in half a character
+    if (len == 0) return;
+  }
+  textOffset[f] = textUsed;
+  memcpy(text + textUsed, value, len);
+  text[textUsed + len] = '\0';
+  textUsed += len + 1;
+}
+
 bool initialize(AppState& appState) {
   // Audio object will be created externally and passed via setAudioInstance
   // For now, we'll use a static instance
   static Audio audioInstance;
   g_audio = &audioInstance;
+  // Input buffer is allocated on the first connect, so sizes must be set before that
+  g_audio->setBufsize(AUDIO_INBUFF_RAM_BYTES, AUDIO_INBUFF_PSRAM_BYTES);
+  g_audio->setFileReadChunk(SD_READ_CHUNK_BYTES);
+  g_replayGainMode = appState.replayGainMode;
+  if (AUDIO_OUTPUT_RATE && !g_audio->setOutputSampleRate(AUDIO_OUTPUT_RATE, AUDIO_RESAMPLE_QUALITY)) {
+    LOG_PRINTLN("AudioManager: resampler unavailable, I2S follows the track rate");
+  }
+  if (appState.latencyMode != LATENCY_MODE_BALANCED) applyLatencyMode(appState.latencyMode);
   return true;
 }
 
+void bindAudioTask() {
+  g_audioTask = xTaskGetCurrentTaskHandle();
+}
+
+void bindUiTask() {
+  g_uiTask = xTaskGetCurrentTaskHandle();
+}
+
+bool postCommand(AudioCommandType type, int32_t value) {
+  AudioCommand cmd = {type, value, millis()};
+  if (!g_commands.push(cmd)) return false;
+  if (g_audioTask) xTaskNotifyGive(g_audioTask);
+  return true;
+}
+
+void processCommands() {
+  if (!g_audio) return;
+  AudioCommand cmd;
+  int32_t relative = 0;
+  int32_t percent = -1;
+  int32_t speedPct = -1;
+  int32_t replayGainMode = -1;
+  int32_t latencyMode = -1;
+  uint32_t issuedMs = 0;
+  bool any = false;
+  while (g_commands.pop(cmd)) {
+    if (cmd.type == AudioCommandType::PlayTrack) {
+      TrackRequest req;
+      g_trackRequest.read(req);
+      if (req.serial != (uint32_t)cmd.value) continue;  // A newer request follows in the queue
+      stop();
+      LOG_PRINTF("Task_Audio: next track requested: %s\n", req.path);
+      g_statusLocal.trackSerial = req.serial;
+      connectToFile(Storage::fs(), req.path, req.gain, req.resumeFilePos, req.folderCover);
+      g_statusLocal.paused = false;
+      relative = 0;  // Seeks queued before the switch were meant for the old track
+      percent = -1;
+      any = false;
+      continue;
+    }
+    if (cmd.type == AudioCommandType::SetVolume) {
+      g_audio->setVolume(cmd.value);
+      continue;
+    }
+    if (cmd.type == AudioCommandType::TogglePause) {
+      g_statusLocal.paused = !g_statusLocal.paused;
+      publishStatus();
+      continue;
+    }
+    if (cmd.type == AudioCommandType::Stop) {
+      stop();
+      g_statusLocal.paused = true;
+      publishStatus();
+      continue;
+    }
+    if (cmd.type == AudioCommandType::SetSpeed) {
+      speedPct = cmd.value;  // Only the last one matters
+      continue;
+    }
+    if (cmd.type == AudioCommandType::SetReplayGainMode) {
+      replayGainMode = cmd.value;
+      continue;
+    }
+    if (cmd.type == AudioCommandType::SetLatencyMode) {
+      latencyMode = cmd.value;
+      continue;
+    }
+    if (!any) issuedMs = cmd.issuedMs;
+    any = true;
+    if (cmd.type == AudioCommandType::SeekPercent) {
+      percent = cmd.value;  // A jump discards earlier steps
+      relative = 0;
+    } else {
+      relative += cmd.value;
+    }
+  }
+  if (speedPct > 0) g_pendingSpeedPct = speedPct;
+  if (g_pendingSpeedPct > 0 && g_audio->getSampleRate() > 0) {
+    if (!g_audio->setPlaybackSpeed(g_pendingSpeedPct / 100.0f)) {
+      LOG_PRINTF("Speed: %d%% not available\n", (int)g_pendingSpeedPct);
+    }
+    g_pendingSpeedPct = -1;
+  }
+  if (replayGainMode >= 0) {
+    g_replayGainMode = (uint8_t)replayGainMode;
+    applyReplayGain();
+  }
+  if (latencyMode >= 0) applyLatencyMode((uint8_t)latencyMode);
+  if (!any || !g_audio->isRunning()) return;
+
+  uint32_t duration = g_audio->getAudioFileDuration();
+  bool ok;
+  if (percent >= 0) {
+    int32_t target = (int32_t)(duration * (uint32_t)constrain(percent, 0, 100) / 100) + relative;
+    ok = g_audio->setAudioPlayPosition(target > 0 ? target : 0);
+  } else {
+    ok = g_audio->setTimeOffset(relative);
+  }
+  if (!ok) {
+    LOG_PRINTLN("Seek: not supported for this file");
+    return;
+  }
+  g_resumeMillisBefore = g_audio->getResumeMillis();
+  g_seekIssuedMs = issuedMs;
+  g_seekLatencyPending = true;
+}
+
 void setAudioInstance(Audio* audio) {
   g_audio = audio;
 }
@@ -32,21 +441,171 @@ Audio* getAudioInstance() {
   return g_audio;
 }
 
-void connectToFile(fs::FS& fs, const char* path) {
+void connectToFile(fs::FS& fs, const char* path, const MediaInfo::ReplayGain& gain, uint32_t resumeFilePos,
+                   const char* folderCover) {
   if (!g_audio) return;
-  g_audio->connecttoFS(fs, path);
+  // The UI shows nothing of the previous track from here on
+  g_npLocal.clear();
+  g_npLocal.trackSerial = g_statusLocal.trackSerial;
+  g_nowPlaying.publish(g_npLocal);
+  // Before connecting, so the first decoded frame already has the new gain
+  g_trackGain = gain;
+  applyReplayGain();
+  // Abort any cover decode for the previous track
+  CoverCache::cancel();
+  // Keep what the previous track taught us about its frame layout
+  saveSeekIndex();
+  g_currentFs = &fs;
+  g_currentPath = path ? path : "";
+  g_statusLocal.trackHash = fnv1a32(g_currentPath.c_str());
+  g_folderCoverPending = folderCover ? folderCover : "";
+  g_currentFileSize = 0;
+  uint32_t resumeMillisBefore = g_audio->getResumeMillis();
+  if (g_audio->connecttoFS(fs, path, resumeFilePos)) {
+    g_currentFileSize = g_audio->getFileSize();
+    loadSeekIndex(fs, g_currentPath.c_str());
+    if (resumeFilePos > 0) {
+      // Like a seek: move the elapsed-time clock once the first resumed sample is out
+      g_resumeMillisBefore = resumeMillisBefore;
+      g_seekIssuedMs = millis();
+      g_seekLatencyPending = true;
+    }
+  }
+  publishStatus();
+}
+
+bool requestTrack(fs::FS& fs, AppState& appState, int queueIndex) {
+  String path;
+  if (!FileManager::getPathByQueueIndex(fs, appState, queueIndex, path)) {
+    LOG_PRINTF("requestTrack: failed to resolve queue index %d\n", queueIndex);
+    return false;
+  }
+  if (!fs.exists(path)) {
+    LOG_PRINTF("requestTrack: file not found: %s\n", path.c_str());
+    return false;
+  }
+  // Checked before the request is published: overwriting it, or moving g_requestSerial on, for a
+  // command that never gets queued would drop the pending PlayTrack and the TrackEnded of the
+  // playing track, and the queue would stall
+  if (g_commands.full()) {
+    LOG_PRINTLN("requestTrack: command queue full");
+    return false;
+  }
+  TrackRequest req = {};
+  req.serial = g_requestSerial + 1;
+  FileManager::getReplayGainByQueueIndex(fs, appState, queueIndex, req.gain);
+  strlcpy(req.path, path.c_str(), sizeof(req.path));
+  // Here rather than on Task_Audio: the folder cover table belongs to the UI, which rebuilds it
+  String cover;
+  if (FileManager::getFolderCoverPath(fs, appState, req.path, cover)) {
+    strlcpy(req.folderCover, cover.c_str(), sizeof(req.folderCover));
+  }
+  g_trackRequest.publish(req);
+  if (!postCommand(AudioCommandType::PlayTrack, (int32_t)req.serial)) {
+    LOG_PRINTLN("requestTrack: command queue full");
+    return false;
+  }
+  g_requestSerial = req.serial;
+  appState.currentPlayingIndex = queueIndex;
+  appState.isPlaying = true;
+  appState.stopped = false;
+  // Stale until Task_Audio publishes the new track's metadata and the decoder reports its format
+  appState.resetID3Metadata();
+  appState.cachedAudioInfo = "";
+  appState.lastAudioInfoUpdate = millis();
+  return true;
+}
+
+void pollEvents(fs::FS& fs, AppState& appState) {
+  AudioEvent ev;
+  while (g_events.pop(ev)) {
+    // A track the user already switched away from does not advance the queue
+    if (ev.type == AudioEventType::TrackEnded && ev.trackSerial == g_requestSerial) advanceQueue(fs, appState);
+  }
+  if (g_status.version() != g_statusSeen) {
+    g_statusSeen = g_status.read(g_statusFrame);
+    appState.isPlaying = !g_statusFrame.paused;
+    appState.stopped = g_statusFrame.paused;
+  }
+  if (g_nowPlaying.version() != g_npSeen) {
+    NowPlaying next;
+    g_npSeen = g_nowPlaying.read(next);
+    // Format and duration updates leave the tag Strings (and the glyph/marquee caches keyed on them) alone
+    bool textChanged = next.textUsed != g_npFrame.textUsed ||
+                       memcmp(next.textOffset, g_npFrame.textOffset, sizeof(next.textOffset)) != 0 ||
+                       memcmp(next.text, g_npFrame.text, next.textUsed) != 0;
+    g_npFrame = next;
+    if (textChanged) {
+      appState.id3Title = g_npFrame.field(NowPlaying::Title);
+      appState.id3Artist = g_npFrame.field(NowPlaying::Artist);
+      appState.id3Album = g_npFrame.field(NowPlaying::Album);
+      appState.id3Year = g_npFrame.field(NowPlaying::Year);
+      appState.id3ContentType = g_npFrame.field(NowPlaying::ContentType);
+    }
+  }
+}
+
+const NowPlaying& nowPlaying() {
+  return g_npFrame;
+}
+
+uint32_t getTrackHash() {
+  return g_statusFrame.trackHash;
+}
+
+uint32_t getPlaybackFilePos() {
+  return g_statusFrame.filePos;
+}
+
+const PlaybackStatus::Load& playbackLoad() {
+  return g_statusFrame.load;
 }
 
 void stop() {
   if (!g_audio) return;
   g_audio->stopSong();
+  saveSeekIndex();
 }
 
-void loop(AppState& appState, bool codecInitialized) {
-  if (!g_audio) return;
-  if (appState.isPlaying && !appState.stopped) {
+bool loop(bool codecInitialized) {
+  if (!g_audio) return false;
+  bool active = !g_statusLocal.paused && g_audio->isRunning();
+  OutputMonitor::setActive(active);
+  if (active) {
+    // Battery saver: let the DMA play down to g_refillBelowMs, then refill it in one burst
+    // (i2s_write blocks once it is full). A command wakes the task early.
+    if (g_refillBelowMs) {
+      uint32_t queued = OutputMonitor::queuedMs();
+      if (queued > g_refillBelowMs) ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(queued - g_refillBelowMs));
+    }
+    TRACE_BEGIN(AudioLoop, 0);
     g_audio->loop();
+    TRACE_END(AudioLoop, 0);
+    if (millis() - g_statusPublishedMs >= AUDIO_STATUS_INTERVAL_MS) {
+      publishStatus();
+      refreshFormat();
+      updateAutoLatency();
+    }
   }
+  if (g_seekLatencyPending && g_audio->getResumeMillis() != g_resumeMillisBefore) {
+    g_seekLatencyPending = false;
+    LOG_PRINTF("Seek: first sample %lu ms after key press\n",
+               (unsigned long)(g_audio->getResumeMillis() - g_seekIssuedMs));
+    // The list view shows elapsed time from the RTC; move it to the new position
+    uint32_t sec = g_audio->getAudioCurrentTime();
+    rtc.setTime(sec % 60, (sec / 60) % 60, sec / 3600, 17, 1, 2021);
+  }
+  // Once the header has been parsed (bitrate known) any embedded APIC has been seen;
+  // without one, fall back to the folder's cover/folder/front image.
+  if (g_folderCoverPending.length() > 0 && g_audio->getBitRate() > 0) {
+    if (g_npLocal.coverKey == 0) {
+      LOG_PRINTF("Using folder cover: %s\n", g_folderCoverPending.c_str());
+      g_npLocal.coverKey = CoverCache::request(g_folderCoverPending.c_str(), 0, 0);
+      g_nowPlaying.publish(g_npLocal);
+    }
+    g_folderCoverPending = "";
+  }
+  return active;
 }
 
 void setVolume(int volume) {
@@ -65,26 +624,22 @@ void setPinout(int bclkPin, int lrckPin, int doutPin) {
 }
 
 uint32_t getSampleRate() {
-  if (!g_audio) return 0;
-  return g_audio->getSampleRate();
+  return g_npFrame.sampleRate;
 }
 
 uint8_t getBitsPerSample() {
-  if (!g_audio) return 0;
-  return g_audio->getBitsPerSample();
+  return g_npFrame.bitsPerSample;
 }
 
 uint32_t getCurrentTime() {
-  if (!g_audio) return 0;
-  return g_audio->getAudioCurrentTime();
+  return g_statusFrame.positionSec;
 }
 
 uint32_t getFileDuration() {
-  if (!g_audio) return 0;
-  return g_audio->getAudioFileDuration();
+  return g_npFrame.durationSec;
 }
 
-void onID3Data(const char* info, AppState& appState) {
+void onID3Data(const char* info) {
   if (!info) return;
   String s(info);
   LOG_PRINTF("ID3DATA: %s\n", s.c_str());
@@ -96,104 +651,64 @@ void onID3Data(const char* info, AppState& appState) {
     s = s.substring(2);
   }
 
-  auto assignKV = [&](const char* key, String& out) {
+  auto assignKV = [&](const char* key, NowPlaying::Field field) {
     int n = strlen(key);
     if (s.startsWith(key)) {
       int pos = n;
       if (pos < s.length() && (s[pos] == ':' || s[pos] == '=')) pos++;
       String v = s.substring(pos);
       v.trim();
-      if (v.length() > 0) { out = v; return true; }
+      if (v.length() > 0) { g_npLocal.setField(field, v.c_str(), v.length()); return true; }
     }
     return false;
   };
 
-  auto assignFrame = [&](const char* frame, String& out) {
+  auto assignFrame = [&](const char* frame, NowPlaying::Field field) {
     int n = strlen(frame);
     if (s.startsWith(frame)) {
       String v = s.substring(n);
       if (v.length() > 0 && (v[0] == ':' || v[0] == '=')) v = v.substring(1);
       v.trim();
-      if (v.length() > 0) { out = v; return true; }
+      if (v.length() > 0) { g_npLocal.setField(field, v.c_str(), v.length()); return true; }
     }
     return false;
   };
 
   bool matched = false;
-  matched |= assignKV("Title",  appState.id3Title);
-  matched |= assignKV("Artist", appState.id3Artist);
-  matched |= assignKV("Album",  appState.id3Album);
-  matched |= assignKV("Year",   appState.id3Year);
-  matched |= assignKV("ContentType", appState.id3ContentType);
-
-  matched |= assignFrame("TIT2", appState.id3Title);
-  matched |= assignFrame("TALB", appState.id3Album);
-  matched |= assignFrame("TPE1", appState.id3Artist);
-  matched |= assignFrame("TYER", appState.id3Year);
-  matched |= assignFrame("TDRC", appState.id3Year);
-  matched |= assignFrame("TCON", appState.id3ContentType);
+  matched |= assignKV("Title", NowPlaying::Title);
+  matched |= assignKV("Artist", NowPlaying::Artist);
+  matched |= assignKV("Album", NowPlaying::Album);
+  matched |= assignKV("Year", NowPlaying::Year);
+  matched |= assignKV("ContentType", NowPlaying::ContentType);
+
+  matched |= assignFrame("TIT2", NowPlaying::Title);
+  matched |= assignFrame("TALB", NowPlaying::Album);
+  matched |= assignFrame("TPE1", NowPlaying::Artist);
+  matched |= assignFrame("TYER", NowPlaying::Year);
+  matched |= assignFrame("TDRC", NowPlaying::Year);
+  matched |= assignFrame("TCON", NowPlaying::ContentType);
 
   // Ignore non-metadata lines (e.g., "SettingsForEncoding: Lavf58.76.100")
   if (!matched && (s.indexOf(":") >= 0 || s.indexOf("=") >= 0)) {
     // Could be metadata but not recognized, ignore
   }
+  if (matched) g_nowPlaying.publish(g_npLocal);
 }
 
-void onID3Image(File& file, const size_t pos, const size_t size, AppState& appState) {
+void onID3Image(File& file, const size_t pos, const size_t size) {
   // Streaming-only: never allocate full image into RAM
-  appState.id3CoverPos = pos;
-  appState.id3CoverLen = size;
-  if (appState.id3CoverBuf) { 
-    heap_caps_free(appState.id3CoverBuf); 
-    appState.id3CoverBuf = nullptr; 
-    appState.id3CoverSize = 0; 
-  }
   LOG_PRINTF("ID3 image will stream: size=%u pos=%u\n", (unsigned)size, (unsigned)pos);
+  // Decode in the background so the thumbnail is ready when the ID3 page opens
+  g_folderCoverPending = "";
+  g_npLocal.coverKey = CoverCache::request(file.path(), pos, size);
+  g_nowPlaying.publish(g_npLocal);
 }
 
-void onEOF(const char* info, AppState& appState, fs::FS& fs) {
-  resetClock();
+void onEOF(const char* info) {
   LOG_PRINT("eof_mp3     ");
   LOG_PRINTLN(info);
-
-  if (appState.fileCount <= 0) {
-    LOG_PRINTLN("eof: queue is empty");
-    return;
-  }
-  
-  // Determine next song based on playback mode
-  if (appState.playMode == PlaybackMode::Sequential) {
-    // Sequential playback: next song
-    appState.currentPlayingIndex++;
-    if (appState.currentPlayingIndex >= appState.fileCount) appState.currentPlayingIndex = 0;
-  } else if (appState.playMode == PlaybackMode::Random) {
-    // Random playback: random selection
-    appState.currentPlayingIndex = random(0, appState.fileCount);
-  } else if (appState.playMode == PlaybackMode::SingleRepeat) {
-    // Single repeat: don't change index, continue playing current song
-    // appState.currentPlayingIndex remains unchanged
-  }
-  
-  appState.currentSelectedIndex = appState.currentPlayingIndex;  // Sync selected index to playing index
-  String nextPath;
-  if (!FileManager::getPathByQueueIndex(fs, appState, appState.currentPlayingIndex, nextPath)) {
-    LOG_PRINTF("eof: failed to resolve queue index %d\n", appState.currentPlayingIndex);
-    return;
-  }
-  LOG_PRINTF("eof: opening next file: %s (index %d, mode %d)\n", 
-                nextPath.c_str(),
-                appState.currentPlayingIndex, 
-                static_cast<int>(appState.playMode));
-  if (fs.exists(nextPath)) {
-    connectToFile(fs, nextPath.c_str());
-    // Reset audio info cache when auto-switching songs (will be updated after decoder initializes)
-    appState.cachedAudioInfo = "";
-    appState.lastAudioInfoUpdate = millis();  // Reset timer to allow decoder initialization time
-    // Reset ID3 metadata
-    appState.resetID3Metadata();
-  } else {
-    LOG_PRINTF("eof: next file not found: %s\n", nextPath.c_str());
-  }
+  publishStatus();
+  pushEvent(AudioEventType::TrackEnded);
 }
 
 }  // namespace AudioManager
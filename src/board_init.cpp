@@ -6,6 +6,8 @@
 #include <utility/Keyboard/KeyboardReader/IOMatrix.h>
 #include <utility/Keyboard/KeyboardReader/TCA8418.h>
 #include "driver/i2s.h"
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
 #include <math.h>
 
 namespace BoardInit {
@@ -42,6 +44,9 @@ static bool es8311_write(uint8_t reg, uint8_t val) {
   return true;
 }
 
+// Set once the ES8311 init sequence succeeded; gates the slot width callback below
+static bool g_es8311Ready = false;
+
 // Simple boot-time sine test
 static void playTestTone(int bclkPin, int lrckPin, int doutPin, 
                          uint32_t freq_hz, uint32_t duration_ms, 
@@ -243,6 +248,7 @@ bool initAdvancedCodec(int& bclkPin, int& lrckPin, int& doutPin,
     return false;
   }
 
+  g_es8311Ready = true;
   LOG_PRINTLN("ES8311 init sequence done");
   LOG_PRINTF("Using Cardputer-Adv audio pins: I2C SDA=%d SCL=%d, BCLK=%d LRCK=%d DOUT=%d\n", 
                 CARDPUTER_I2C_SDA, CARDPUTER_I2C_SCL, bclkPin, lrckPin, doutPin);
@@ -297,6 +303,34 @@ bool initAudioForDetectedVariant(Variant detected,
   return ok;
 }
 
+bool setCodecSlotBits(uint8_t bits) {
+  if (!g_es8311Ready || (bits != 16 && bits != 32)) return false;
+  // MCLK is taken from BCLK (reg 0x01): 32 bit slots double BCLK, so halve the multiplier to stay at 256fs.
+  // Reg 0x02 bits 4:3 pre-multiplier (x8 = 0x18, x4 = 0x10); reg 0x09 SDP in word length: 32 bit (0x10),
+  // or back to the power-on value (0x00) that 16 bit playback has always used.
+  lockI2c();
+  bool ok = es8311_write(0x02, bits == 32 ? 0x10 : 0x18);
+  ok &= es8311_write(0x09, bits == 32 ? 0x10 : 0x00);
+  unlockI2c();
+  LOG_PRINTF("ES8311: %u bit I2S slots%s\n", (unsigned)bits, ok ? "" : " (write failed)");
+  return ok;
+}
+
+// Created on first use; a mutex rather than a binary semaphore so Task_TFT inherits
+// Task_Audio's priority while it holds the bus
+static SemaphoreHandle_t i2cMutex() {
+  static SemaphoreHandle_t mutex = xSemaphoreCreateMutex();
+  return mutex;
+}
+
+void lockI2c() {
+  xSemaphoreTake(i2cMutex(), portMAX_DELAY);
+}
+
+void unlockI2c() {
+  xSemaphoreGive(i2cMutex());
+}
+
 void configureKeyboard(Variant variant) {
   bool useAdvKeyboard = false;
   auto boardType = M5.getBoard();
@@ -338,4 +372,7 @@ void configureKeyboard(Variant variant) {
 
 }  // namespace BoardInit
 
-
+// Audio library hook: a track needs a different I2S slot width
+bool audio_i2s_slot_bits(uint8_t bits) {
+  return BoardInit::setCodecSlotBits(bits);
+}
@@ -0,0 +1,352 @@
+#include "../include/cover_cache.hpp"
+#include "../include/config.hpp"
+#include "../include/diagnostics.hpp"
+#include "../include/image_utils.hpp"
+#include "../include/path_hash.hpp"
+#include "M5Cardputer.h"
+#include <esp_heap_caps.h>
+#include <cstdio>
+#include <cstring>
+
+namespace CoverCache {
+
+namespace {
+
+constexpr uint32_t THUMB_MAGIC = 0x31545043UL;  // "CPT1"
+
+struct ThumbHeader {
+  uint32_t magic;
+  uint32_t key;
+  uint16_t width;
+  uint16_t height;
+};
+
+struct Slot {
+  uint32_t key = 0;
+  uint32_t lastUse = 0;
+  bool valid = false;
+  bool busy = false;    // Being filled by the worker
+  uint8_t pins = 0;     // Held by the renderer
+  uint16_t* pixels = nullptr;
+};
+
+struct Request {
+  char path[COVER_PATH_MAX];
+  uint32_t pos;
+  uint32_t len;
+  uint32_t key;
+  uint32_t generation;
+  bool pending;
+};
+
+// Everything below is shared between the worker, the UI and the audio task and is
+// guarded by g_lock. g_generation is also read without the lock to abort decodes.
+portMUX_TYPE g_lock = portMUX_INITIALIZER_UNLOCKED;
+volatile uint32_t g_generation = 0;
+Request g_request = {};
+Slot g_slots[COVER_CACHE_SLOTS_PSRAM];
+int g_slotLimit = 0;
+uint32_t g_useCounter = 0;
+uint32_t g_currentKey = 0; // Key of the latest request, 0 after cancel()
+int g_currentSlot = -1;   // Published thumbnail for the current generation
+int g_pinnedSlot = -1;    // Slot pinned by the last acquire()
+State g_state = State::None;
+
+fs::FS* g_fs = nullptr;
+TaskHandle_t g_worker = nullptr;
+
+// Reads through to the file relative to the image start and reports EOF once the
+// request generation moves on, which makes the decoders bail out early.
+class CancellableFileWrapper : public lgfx::DataWrapper {
+ public:
+  CancellableFileWrapper(fs::File& file, uint32_t base, uint32_t generation)
+      : _file(file), _base(base), _generation(generation) {}
+
+  int read(uint8_t* buf, uint32_t len) override {
+    if (cancelled()) return 0;
+    return _file.read(buf, len);
+  }
+  void skip(int32_t offset) override { _file.seek(_file.position() + offset); }
+  bool seek(uint32_t offset) override { return _file.seek(_base + offset); }
+  void close(void) override {}
+  int32_t tell(void) override { return (int32_t)(_file.position() - _base); }
+
+  bool cancelled() const { return _generation != g_generation; }
+
+ private:
+  fs::File& _file;
+  uint32_t _base;
+  uint32_t _generation;
+};
+
+uint32_t makeKey(const char* sourcePath, size_t pos, size_t len) {
+  uint32_t h = fnv1a32(sourcePath);
+  h = fnv1a32Mix(h, (uint32_t)pos);
+  return fnv1a32Mix(h, (uint32_t)len);
+}
+
+String cachePathForKey(uint32_t key) {
+  char name[48];
+  snprintf(name, sizeof(name), "%s/%08lx.565", COVER_CACHE_DIR, (unsigned long)key);
+  return String(name);
+}
+
+// Caller holds g_lock
+int findSlotLocked(uint32_t key) {
+  for (int i = 0; i < g_slotLimit; ++i) {
+    if (g_slots[i].valid && g_slots[i].key == key) return i;
+  }
+  return -1;
+}
+
+// Caller holds g_lock. Picks an empty slot or the least recently used one that is
+// neither pinned nor published, and marks it busy.
+int claimVictimSlotLocked() {
+  int victim = -1;
+  for (int i = 0; i < g_slotLimit; ++i) {
+    Slot& s = g_slots[i];
+    if (s.busy || s.pins > 0 || i == g_currentSlot) continue;
+    if (!s.valid) { victim = i; break; }
+    if (victim < 0 || s.lastUse < g_slots[victim].lastUse) victim = i;
+  }
+  if (victim >= 0) {
+    g_slots[victim].valid = false;
+    g_slots[victim].busy = true;
+  }
+  return victim;
+}
+
+void touchLocked(int idx) {
+  g_slots[idx].lastUse = ++g_useCounter;
+}
+
+bool loadFromSd(fs::FS& fs, uint32_t key, uint16_t* dst) {
+  String path = cachePathForKey(key);
+  if (!fs.exists(path)) return false;
+  File f = fs.open(path, FILE_READ);
+  if (!f) return false;
+  ThumbHeader hdr;
+  bool ok = f.read((uint8_t*)&hdr, sizeof(hdr)) == sizeof(hdr) &&
+            hdr.magic == THUMB_MAGIC && hdr.key == key &&
+            hdr.width == COVER_WIDTH && hdr.height == COVER_HEIGHT &&
+            f.read((uint8_t*)dst, COVER_THUMB_BYTES) == COVER_THUMB_BYTES;
+  f.close();
+  return ok;
+}
+
+void storeToSd(fs::FS& fs, uint32_t key, const uint16_t* src) {
+  String path = cachePathForKey(key);
+  File f = fs.open(path, FILE_WRITE);
+  if (!f) {
+    LOG_PRINTF("CoverCache: failed to create %s\n", path.c_str());
+    return;
+  }
+  ThumbHeader hdr = {THUMB_MAGIC, key, (uint16_t)COVER_WIDTH, (uint16_t)COVER_HEIGHT};
+  bool ok = f.write((const uint8_t*)&hdr, sizeof(hdr)) == sizeof(hdr) &&
+            f.write((const uint8_t*)src, COVER_THUMB_BYTES) == COVER_THUMB_BYTES;
+  f.close();
+  if (!ok) {
+    LOG_PRINTF("CoverCache: short write, removing %s\n", path.c_str());
+    fs.remove(path);
+  }
+}
+
+// Decode the image at pos into dst, scaled to fit COVER_WIDTH x COVER_HEIGHT
+bool decodeFromFile(fs::FS& fs, const Request& req, uint16_t* dst) {
+  File f = fs.open(req.path);
+  if (!f) return false;
+  if (!f.seek(req.pos)) {
+    f.close();
+    return false;
+  }
+
+  const size_t scanMax = (req.len > 0 && req.len < COVER_SCAN_MAX) ? req.len : (size_t)COVER_SCAN_MAX;
+  size_t startOff = 0;
+  ImageFormat fmt = ImageFormat::Unknown;
+  findImageStart(f, scanMax, startOff, fmt);
+  if (fmt == ImageFormat::Unknown || fmt == ImageFormat::GIF) {
+    f.close();
+    return false;
+  }
+
+  uint32_t imgW = 0, imgH = 0;
+  const uint32_t imageStart = req.pos + startOff;
+  bool gotSize = getImageSize(f, imageStart, fmt, imgW, imgH);
+  f.seek(imageStart);
+
+  float scaleX = 0.0f;  // 0 means fit-to-size when dimensions are unknown
+  float scaleY = 0.0f;  // 0 means follow scaleX (maintain aspect ratio)
+  if (gotSize && imgW > 0 && imgH > 0) {
+    float sx = (float)COVER_WIDTH / (float)imgW;
+    float sy = (float)COVER_HEIGHT / (float)imgH;
+    scaleX = sx < sy ? sx : sy;
+    if (scaleX <= 0.0f || scaleX > 1.0f) scaleX = 1.0f;
+  }
+
+  // Render straight into the slot memory; the canvas does not own the buffer
+  M5Canvas canvas;
+  canvas.setBuffer(dst, COVER_WIDTH, COVER_HEIGHT);
+  canvas.fillScreen(BLACK);
+
+  CancellableFileWrapper data(f, imageStart, req.generation);
+  unsigned long t0 = millis();
+  bool ok = false;
+  if (fmt == ImageFormat::JPEG) {
+    ok = canvas.drawJpg(&data, 0, 0, COVER_WIDTH, COVER_HEIGHT, 0, 0, scaleX, scaleY);
+  } else if (fmt == ImageFormat::PNG) {
+    ok = canvas.drawPng(&data, 0, 0, COVER_WIDTH, COVER_HEIGHT, 0, 0, scaleX, scaleY);
+  } else if (fmt == ImageFormat::BMP) {
+    ok = canvas.drawBmp(&data, 0, 0, COVER_WIDTH, COVER_HEIGHT, 0, 0, scaleX, scaleY);
+  } else if (fmt == ImageFormat::QOI) {
+    ok = canvas.drawQoi(&data, 0, 0, COVER_WIDTH, COVER_HEIGHT, 0, 0, scaleX, scaleY);
+  }
+  bool cancelled = data.cancelled();
+  f.close();
+
+  LOG_PRINTF("CoverCache: decoded %ux%u cover in %lu ms (%s)\n",
+             (unsigned)imgW, (unsigned)imgH, millis() - t0,
+             cancelled ? "cancelled" : (ok ? "ok" : "failed"));
+  return ok && !cancelled;
+}
+
+// Worker side: resolve one request into a slot and publish it if still current
+void processRequest(const Request& req) {
+  portENTER_CRITICAL(&g_lock);
+  int idx = findSlotLocked(req.key);
+  if (idx >= 0) {
+    touchLocked(idx);
+    if (req.generation == g_generation) {
+      g_currentSlot = idx;
+      g_state = State::Ready;
+    }
+    portEXIT_CRITICAL(&g_lock);
+    return;
+  }
+  idx = claimVictimSlotLocked();
+  portEXIT_CRITICAL(&g_lock);
+
+  bool ok = false;
+  if (idx >= 0) {
+    Slot& slot = g_slots[idx];
+    if (!slot.pixels) {
+      uint32_t caps = psramFound() ? MALLOC_CAP_SPIRAM : MALLOC_CAP_8BIT;
+      slot.pixels = (uint16_t*)heap_caps_malloc(COVER_THUMB_BYTES, caps);
+    }
+    if (slot.pixels) {
+      ok = loadFromSd(*g_fs, req.key, slot.pixels);
+      if (!ok && decodeFromFile(*g_fs, req, slot.pixels)) {
+        storeToSd(*g_fs, req.key, slot.pixels);
+        ok = true;
+      }
+    }
+  }
+
+  portENTER_CRITICAL(&g_lock);
+  if (idx >= 0) {
+    Slot& slot = g_slots[idx];
+    slot.busy = false;
+    if (ok) {
+      slot.key = req.key;
+      slot.valid = true;
+      touchLocked(idx);
+    }
+  }
+  if (req.generation == g_generation) {
+    g_currentSlot = ok ? idx : -1;
+    g_state = ok ? State::Ready : State::Failed;
+  }
+  portEXIT_CRITICAL(&g_lock);
+}
+
+void workerTask(void* pvParameters) {
+  (void)pvParameters;
+  while (1) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    Request req;
+    portENTER_CRITICAL(&g_lock);
+    bool pending = g_request.pending;
+    if (pending) {
+      req = g_request;
+      g_request.pending = false;
+    }
+    portEXIT_CRITICAL(&g_lock);
+    if (pending) processRequest(req);
+  }
+}
+
+}  // namespace
+
+bool initialize(fs::FS& fs) {
+  g_fs = &fs;
+  g_slotLimit = psramFound() ? COVER_CACHE_SLOTS_PSRAM : COVER_CACHE_SLOTS_INTERNAL;
+  if (!fs.exists(MUSIC_DIR)) {
+    fs.mkdir(MUSIC_DIR);
+  }
+  if (!fs.exists(COVER_CACHE_DIR) && !fs.mkdir(COVER_CACHE_DIR)) {
+    LOG_PRINTF("CoverCache: failed to create %s\n", COVER_CACHE_DIR);
+  }
+  if (!g_worker) {
+    xTaskCreatePinnedToCore(workerTask, "Task_Cover", COVER_WORKER_STACK_SIZE, NULL,
+                            COVER_WORKER_PRIORITY, &g_worker, COVER_WORKER_CORE);
+    Diagnostics::registerTask("cover", g_worker, COVER_WORKER_STACK_SIZE);
+  }
+  return g_worker != nullptr;
+}
+
+uint32_t request(const char* sourcePath, size_t pos, size_t len) {
+  if (!sourcePath || !sourcePath[0] || !g_worker) return 0;
+  uint32_t key = makeKey(sourcePath, pos, len);
+  if (key == 0) key = 1;  // 0 means "no cover" to acquire()
+  portENTER_CRITICAL(&g_lock);
+  g_generation = g_generation + 1;
+  strncpy(g_request.path, sourcePath, sizeof(g_request.path) - 1);
+  g_request.path[sizeof(g_request.path) - 1] = '\0';
+  g_request.pos = (uint32_t)pos;
+  g_request.len = (uint32_t)len;
+  g_request.key = key;
+  g_request.generation = g_generation;
+  g_request.pending = true;
+  g_currentKey = key;
+  g_currentSlot = -1;
+  g_state = State::Loading;
+  portEXIT_CRITICAL(&g_lock);
+  xTaskNotifyGive(g_worker);
+  return key;
+}
+
+void cancel() {
+  portENTER_CRITICAL(&g_lock);
+  g_generation = g_generation + 1;
+  g_request.pending = false;
+  g_currentKey = 0;
+  g_currentSlot = -1;
+  g_state = State::None;
+  portEXIT_CRITICAL(&g_lock);
+}
+
+State acquire(uint32_t key, const uint16_t*& pixels) {
+  pixels = nullptr;
+  if (key == 0) return State::None;
+  portENTER_CRITICAL(&g_lock);
+  State state = key == g_currentKey ? g_state : State::Loading;
+  if (state == State::Ready && g_currentSlot >= 0 && g_pinnedSlot < 0) {
+    g_pinnedSlot = g_currentSlot;
+    g_slots[g_pinnedSlot].pins++;
+    pixels = g_slots[g_pinnedSlot].pixels;
+  } else if (state == State::Ready) {
+    state = State::Loading;
+  }
+  portEXIT_CRITICAL(&g_lock);
+  return state;
+}
+
+void release() {
+  portENTER_CRITICAL(&g_lock);
+  if (g_pinnedSlot >= 0) {
+    g_slots[g_pinnedSlot].pins--;
+    g_pinnedSlot = -1;
+  }
+  portEXIT_CRITICAL(&g_lock);
+}
+
+}  // namespace CoverCache
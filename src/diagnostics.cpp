@@ -0,0 +1,109 @@
+#include "../include/diagnostics.hpp"
+#include <atomic>
+#include <esp_heap_caps.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+namespace Diagnostics {
+
+namespace {
+
+struct WatchedTask {
+  const char* name;
+  TaskHandle_t handle;
+  uint32_t stackBytes;
+};
+
+// Registered from setup() only; Task_TFT may already be sampling, so an entry is
+// written before the count that makes it visible
+WatchedTask g_tasks[DIAG_MAX_TASKS];
+std::atomic<int> g_taskCount{0};
+
+Snapshot g_latest = {};
+uint32_t g_lastSampleMs = 0;
+uint32_t g_lastLogMs = 0;
+bool g_headerLogged = false;
+
+void readHeap(uint32_t caps, HeapStats& out) {
+  multi_heap_info_t info;
+  heap_caps_get_info(&info, caps);
+  out.totalBytes = heap_caps_get_total_size(caps);
+  out.freeBytes = info.total_free_bytes;
+  out.minFreeBytes = info.minimum_free_bytes;
+  out.largestBlock = info.largest_free_block;
+  out.allocatedBlocks = info.allocated_blocks;
+  out.freeBlocks = info.free_blocks;
+  out.fragmentationPct = info.total_free_bytes > 0
+      ? (uint8_t)(100 - (uint64_t)info.largest_free_block * 100 / info.total_free_bytes)
+      : 0;
+}
+
+void logCsv(const Snapshot& s) {
+  // One header per boot, then one line per sample; the task columns follow registration order
+  if (!g_headerLogged) {
+    g_headerLogged = true;
+    LOG_PRINT("diag,ms,mhz,int_free,int_min,int_largest,int_frag,int_blocks,ps_free,ps_min,ps_largest");
+    for (int i = 0; i < s.taskCount; ++i) {
+      LOG_PRINTF(",%s_free", s.tasks[i].name);
+    }
+    LOG_PRINTLN();
+  }
+  LOG_PRINTF("diag,%lu,%lu,%lu,%lu,%lu,%u,%lu,%lu,%lu,%lu",
+             (unsigned long)s.ms, (unsigned long)s.cpuMhz,
+             (unsigned long)s.internal.freeBytes, (unsigned long)s.internal.minFreeBytes,
+             (unsigned long)s.internal.largestBlock, (unsigned)s.internal.fragmentationPct,
+             (unsigned long)s.internal.allocatedBlocks,
+             (unsigned long)s.psram.freeBytes, (unsigned long)s.psram.minFreeBytes,
+             (unsigned long)s.psram.largestBlock);
+  for (int i = 0; i < s.taskCount; ++i) {
+    LOG_PRINTF(",%lu", (unsigned long)s.tasks[i].minFreeBytes);
+  }
+  LOG_PRINTLN();
+}
+
+}  // namespace
+
+void registerTask(const char* name, TaskHandle_t handle, uint32_t stackBytes) {
+  int n = g_taskCount.load(std::memory_order_relaxed);
+  if (!handle || n >= DIAG_MAX_TASKS) return;
+  g_tasks[n].name = name;
+  g_tasks[n].handle = handle;
+  g_tasks[n].stackBytes = stackBytes;
+  g_taskCount.store(n + 1, std::memory_order_release);
+}
+
+void sample(Snapshot& out) {
+  out.ms = millis();
+  out.cpuMhz = getCpuFrequencyMhz();
+  readHeap(MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT, out.internal);
+  if (psramFound()) {
+    readHeap(MALLOC_CAP_SPIRAM, out.psram);
+  } else {
+    out.psram = HeapStats();
+  }
+  out.taskCount = g_taskCount.load(std::memory_order_acquire);
+  for (int i = 0; i < out.taskCount; ++i) {
+    out.tasks[i].name = g_tasks[i].name;
+    out.tasks[i].stackBytes = g_tasks[i].stackBytes;
+    out.tasks[i].minFreeBytes = uxTaskGetStackHighWaterMark(g_tasks[i].handle);
+  }
+}
+
+void update(bool pageVisible) {
+  uint32_t now = millis();
+  bool logDue = DIAG_SERIAL_LOG && (now - g_lastLogMs >= DIAG_LOG_INTERVAL_MS || g_lastLogMs == 0);
+  bool pageDue = pageVisible && (now - g_lastSampleMs >= DIAG_PAGE_INTERVAL_MS || g_lastSampleMs == 0);
+  if (!logDue && !pageDue) return;
+  sample(g_latest);
+  g_lastSampleMs = now;
+  if (logDue) {
+    g_lastLogMs = now;
+    logCsv(g_latest);
+  }
+}
+
+const Snapshot& latest() {
+  return g_latest;
+}
+
+}  // namespace Diagnostics
@@ -1,8 +1,11 @@
 #include "../include/file_manager.hpp"
 #include "../include/config.hpp"
+#include "../include/path_hash.hpp"
+#include "../include/media_info.hpp"
 #include <SD.h>
 #include "M5Cardputer.h"
 #include <ESP32Time.h>
+#include <esp_heap_caps.h>
 #include <cstdio>
 
 namespace FileManager {
@@ -15,7 +18,52 @@ bool isSupportedAudioFile(const String& fullPath) {
   int dot = lower.lastIndexOf('.');
   if (dot < 0) return false;
   String ext = lower.substring(dot + 1);
-  return ext == "mp3" || ext == "wav";
+  return ext == "mp3" || ext == "wav" || ext == "flac" || ext == "m4a" || ext == "aac";
+}
+
+// Rank of a sidecar cover file name in FOLDER_COVER_CANDIDATES, or -1 if it is not one
+int folderCoverRank(const char* entryName) {
+  String name = String(entryName ? entryName : "");
+  int lastSlash = name.lastIndexOf('/');
+  if (lastSlash >= 0) name = name.substring(lastSlash + 1);
+  name.toLowerCase();
+  for (int i = 0; i < FOLDER_COVER_CANDIDATE_COUNT; ++i) {
+    if (name == FOLDER_COVER_CANDIDATES[i]) return i;
+  }
+  return -1;
+}
+
+bool isIndexDirective(const String& line) {
+  return line.length() > 0 && line[0] == '#';
+}
+
+// Track lines are "<path>\t<duration>[\t<replaygain>]"
+String indexLinePath(const String& line) {
+  int tab = line.indexOf('\t');
+  return tab >= 0 ? line.substring(0, tab) : line;
+}
+
+uint16_t indexLineDuration(const String& line) {
+  int tab = line.indexOf('\t');
+  if (tab < 0) return 0;
+  long sec = line.substring(tab + 1).toInt();
+  return (uint16_t)constrain(sec, 0L, 65535L);
+}
+
+// Third field: "<track gain>,<track peak>,<album gain>,<album peak>" as stored in MediaInfo::ReplayGain
+bool indexLineReplayGain(const String& line, MediaInfo::ReplayGain& out) {
+  out = MediaInfo::ReplayGain();
+  int tab = line.indexOf('\t');
+  if (tab < 0) return false;
+  tab = line.indexOf('\t', tab + 1);
+  if (tab < 0) return false;
+  int tg, tp, ag, ap;
+  if (sscanf(line.c_str() + tab + 1, "%d,%d,%d,%d", &tg, &tp, &ag, &ap) != 4) return false;
+  out.trackGain = (int16_t)tg;
+  out.trackPeak = (uint16_t)tp;
+  out.albumGain = (int16_t)ag;
+  out.albumPeak = (uint16_t)ap;
+  return out.any();
 }
 
 String normalizeDir(const char* dirname) {
@@ -60,25 +108,29 @@ bool pathInDirectoryRecursive(const String& path, const String& dir) {
 
 bool addBrowserDirectoryEntry(AppState& appState, const String& dirName, const String& dirPath) {
   for (int i = 0; i < appState.browserEntryCount; ++i) {
-    if (appState.browserEntryIsDir[i] && appState.browserEntryPath[i] == dirPath) return true;
+    if (appState.browserEntryIsDir[i] && appState.browserPath(i) == dirPath) return true;
   }
   if (appState.browserEntryCount >= MAX_BROWSER_ENTRIES) return false;
 
-  int idx = appState.browserEntryCount++;
+  int idx = appState.browserEntryCount;
+  if (!appState.browserArena.add(dirName, appState.browserEntryName[idx]) ||
+      !appState.browserArena.add(dirPath, appState.browserEntryPath[idx])) {
+    return false;
+  }
   appState.browserEntryIsDir[idx] = true;
   appState.browserEntrySongIndex[idx] = -1;
-  appState.browserEntryName[idx] = dirName;
-  appState.browserEntryPath[idx] = dirPath;
+  appState.browserEntryCount++;
   return true;
 }
 
 bool addBrowserSongEntry(AppState& appState, int songIndex, const String& fullPath) {
   if (appState.browserEntryCount >= MAX_BROWSER_ENTRIES) return false;
-  int idx = appState.browserEntryCount++;
+  int idx = appState.browserEntryCount;
+  if (!appState.browserArena.add(extractDisplayName(fullPath), appState.browserEntryName[idx])) return false;
   appState.browserEntryIsDir[idx] = false;
   appState.browserEntrySongIndex[idx] = songIndex;
-  appState.browserEntryName[idx] = extractDisplayName(fullPath);
-  appState.browserEntryPath[idx] = "";
+  appState.browserEntryPath[idx] = StrRef();
+  appState.browserEntryCount++;
   return true;
 }
 
@@ -95,23 +147,50 @@ void scanDirectoryToIndex(fs::FS& fs,
     return;
   }
 
+  int coverRank = -1;
+  String coverName;
+
   File entry = root.openNextFile();
   while (entry && songCount < MAX_LIBRARY_FILES) {
     String fullPath = buildEntryPath(dir, entry.name());
 
     if (entry.isDirectory()) {
-      if (levels > 0) {
+      // Skip our own cache directories (e.g. /music/.cp_covers)
+      if (levels > 0 && !String(entry.name()).startsWith(".cp_")) {
         scanDirectoryToIndex(fs, fullPath, levels - 1, indexFile, songCount);
       }
     } else {
       if (isSupportedAudioFile(fullPath)) {
-        indexFile.println(fullPath);
+        // Header-only probe; cheap compared to the directory walk itself
+        uint32_t duration = MediaInfo::probeDurationSec(entry);
+        MediaInfo::ReplayGain gain;
+        indexFile.print(fullPath);
+        indexFile.print('\t');
+        indexFile.print(duration);
+        if (MediaInfo::probeReplayGain(entry, gain)) {
+          indexFile.printf("\t%d,%u,%d,%u", gain.trackGain, gain.trackPeak, gain.albumGain, gain.albumPeak);
+        }
+        indexFile.println();
         songCount++;
+      } else {
+        int rank = folderCoverRank(entry.name());
+        if (rank >= 0 && (coverRank < 0 || rank < coverRank)) {
+          coverRank = rank;
+          coverName = fullPath.substring(fullPath.lastIndexOf('/') + 1);
+        }
       }
     }
 
     entry = root.openNextFile();
   }
+
+  // Resolve the sidecar cover now so playback never has to probe the card for it
+  if (coverRank >= 0) {
+    indexFile.print(LIBRARY_INDEX_COVER_TAG);
+    indexFile.print(dir);
+    indexFile.print('\t');
+    indexFile.println(coverName);
+  }
 }
 
 void rebuildQueueFromLibrary(AppState& appState) {
@@ -135,16 +214,7 @@ void rebuildQueueFromLibrary(AppState& appState) {
   }
 }
 
-bool readPathBySongIndex(fs::FS& fs, AppState& appState, int songIndex, String& outPath) {
-  if (songIndex < 0 || songIndex >= appState.libraryCount) return false;
-
-  for (int i = 0; i < FILE_PATH_CACHE_SIZE; ++i) {
-    if (appState.pathCacheIndices[i] == songIndex) {
-      outPath = appState.pathCacheValues[i];
-  return outPath.length() > 0;
-}
-  }
-
+bool readIndexLine(fs::FS& fs, const AppState& appState, int songIndex, String& outLine) {
   File indexFile = fs.open(LIBRARY_INDEX_PATH, FILE_READ);
   if (!indexFile) {
     LOG_PRINTF("Failed to open index file: %s\n", LIBRARY_INDEX_PATH);
@@ -157,14 +227,39 @@ bool readPathBySongIndex(fs::FS& fs, AppState& appState, int songIndex, String&
     return false;
   }
 
-  String line = indexFile.readStringUntil('\n');
+  outLine = indexFile.readStringUntil('\n');
   indexFile.close();
-  line.trim();
+  outLine.trim();
+  return outLine.length() > 0;
+}
+
+bool readPathBySongIndex(fs::FS& fs, AppState& appState, int songIndex, String& outPath) {
+  if (songIndex < 0 || songIndex >= appState.libraryCount) return false;
+
+  for (int i = 0; i < FILE_PATH_CACHE_SIZE; ++i) {
+    if (appState.pathCacheIndices[i] == songIndex) {
+      outPath = appState.pathCacheArena.view(appState.pathCacheValues[i]).c_str();
+      return outPath.length() > 0;
+    }
+  }
+
+  String line;
+  if (!readIndexLine(fs, appState, songIndex, line)) return false;
+  line = indexLinePath(line);
   if (line.length() == 0) return false;
 
+  // Overwritten slots keep their bytes until the arena fills; then the whole cache starts over
+  StrRef ref;
+  if (!appState.pathCacheArena.add(line, ref)) {
+    appState.resetPathCache();
+    if (!appState.pathCacheArena.add(line, ref)) {
+      outPath = line;
+      return true;
+    }
+  }
   int slot = appState.pathCacheWritePos % FILE_PATH_CACHE_SIZE;
   appState.pathCacheIndices[slot] = songIndex;
-  appState.pathCacheValues[slot] = line;
+  appState.pathCacheValues[slot] = ref;
   appState.pathCacheWritePos = (slot + 1) % FILE_PATH_CACHE_SIZE;
 
   outPath = line;
@@ -207,6 +302,7 @@ bool rebuildLibraryIndex(fs::FS& fs, const char* dirname, uint8_t levels, AppSta
     return false;
   }
 
+  indexFile.println(LIBRARY_INDEX_HEADER);
   int songCount = 0;
   scanDirectoryToIndex(fs, dir, levels, indexFile, songCount);
   indexFile.close();
@@ -224,13 +320,35 @@ bool loadLibraryIndex(fs::FS& fs, AppState& appState) {
     return false;
   }
 
+  String header = indexFile.readStringUntil('\n');
+  header.trim();
+  if (header != LIBRARY_INDEX_HEADER) {
+    LOG_PRINTF("Index format outdated (%s), rebuilding\n", header.c_str());
+    indexFile.close();
+    return false;
+  }
+
+  const size_t coverTagLen = strlen(LIBRARY_INDEX_COVER_TAG);
   while (indexFile.available() && appState.libraryCount < MAX_LIBRARY_FILES) {
     uint32_t offset = static_cast<uint32_t>(indexFile.position());
     String line = indexFile.readStringUntil('\n');
     line.trim();
     if (line.length() == 0) continue;
+    if (isIndexDirective(line)) {
+      if (line.startsWith(LIBRARY_INDEX_COVER_TAG) && appState.folderCoverCount < MAX_FOLDER_COVERS) {
+        int tab = line.indexOf('\t', coverTagLen);
+        if (tab > 0) {
+          String dir = line.substring(coverTagLen, tab);
+          appState.folderCoverDirHashes[appState.folderCoverCount] = fnv1a32(dir.c_str());
+          appState.folderCoverOffsets[appState.folderCoverCount] = offset;
+          appState.folderCoverCount++;
+        }
+      }
+      continue;
+    }
 
     appState.libraryOffsets[appState.libraryCount] = offset;
+    appState.libraryDurationSec[appState.libraryCount] = indexLineDuration(line);
     appState.libraryCount++;
   }
   indexFile.close();
@@ -238,7 +356,8 @@ bool loadLibraryIndex(fs::FS& fs, AppState& appState) {
   rebuildQueueFromLibrary(appState);
   appState.resetPathCache();
 
-  LOG_PRINTF("Loaded index: libraryCount=%d queueSize=%d\n", appState.libraryCount, appState.fileCount);
+  LOG_PRINTF("Loaded index: libraryCount=%d queueSize=%d folderCovers=%d\n",
+             appState.libraryCount, appState.fileCount, appState.folderCoverCount);
   if (appState.libraryCount >= MAX_LIBRARY_FILES) {
     LOG_PRINTF("WARNING: reached MAX_LIBRARY_FILES=%d\n", MAX_LIBRARY_FILES);
   }
@@ -253,6 +372,55 @@ bool getPathByQueueIndex(fs::FS& fs, AppState& appState, int queueIndex, String&
   return readPathBySongIndex(fs, appState, songIndex, outPath);
 }
 
+bool getReplayGainByQueueIndex(fs::FS& fs, const AppState& appState, int queueIndex, MediaInfo::ReplayGain& out) {
+  out = MediaInfo::ReplayGain();
+  if (queueIndex < 0 || queueIndex >= appState.fileCount) return false;
+  String line;
+  if (!readIndexLine(fs, appState, appState.playbackQueue[queueIndex], line)) return false;
+  return indexLineReplayGain(line, out);
+}
+
+uint32_t getDurationByQueueIndex(const AppState& appState, int queueIndex) {
+  if (queueIndex < 0 || queueIndex >= appState.fileCount) return 0;
+  return appState.libraryDurationSec[appState.playbackQueue[queueIndex]];
+}
+
+uint32_t getQueueDurationFrom(const AppState& appState, int firstQueueIndex) {
+  uint32_t total = 0;
+  for (int q = firstQueueIndex < 0 ? 0 : firstQueueIndex; q < appState.fileCount; ++q) {
+    total += appState.libraryDurationSec[appState.playbackQueue[q]];
+  }
+  return total;
+}
+
+bool getFolderCoverPath(fs::FS& fs, AppState& appState, const char* trackPath, String& outImagePath) {
+  if (!trackPath || appState.folderCoverCount <= 0) return false;
+  String dir = getParentDir(String(trackPath));
+  uint32_t dirHash = fnv1a32(dir.c_str());
+
+  const size_t coverTagLen = strlen(LIBRARY_INDEX_COVER_TAG);
+  for (int i = 0; i < appState.folderCoverCount; ++i) {
+    if (appState.folderCoverDirHashes[i] != dirHash) continue;
+
+    File indexFile = fs.open(LIBRARY_INDEX_PATH, FILE_READ);
+    if (!indexFile) return false;
+    if (!indexFile.seek(appState.folderCoverOffsets[i])) {
+      indexFile.close();
+      return false;
+    }
+    String line = indexFile.readStringUntil('\n');
+    indexFile.close();
+    line.trim();
+
+    int tab = line.indexOf('\t', coverTagLen);
+    if (!line.startsWith(LIBRARY_INDEX_COVER_TAG) || tab < 0) continue;
+    if (line.substring(coverTagLen, tab) != dir) continue;  // Hash collision
+    outImagePath = buildEntryPath(dir, line.substring(tab + 1).c_str());
+    return true;
+  }
+  return false;
+}
+
 bool buildQueueForDirectory(fs::FS& fs, AppState& appState, const char* dirname, int preferredSongIndex) {
   String dir = normalizeDir(dirname);
   File indexFile = fs.open(LIBRARY_INDEX_PATH, FILE_READ);
@@ -274,7 +442,8 @@ bool buildQueueForDirectory(fs::FS& fs, AppState& appState, const char* dirname,
   while (indexFile.available() && songIndex < appState.libraryCount && queueCount < MAX_LIBRARY_FILES) {
     String line = indexFile.readStringUntil('\n');
     line.trim();
-    if (line.length() == 0) continue;
+    if (line.length() == 0 || isIndexDirective(line)) continue;
+    line = indexLinePath(line);
 
     if (pathInDirectoryRecursive(line, dir)) {
       appState.playbackQueue[queueCount] = static_cast<uint16_t>(songIndex);
@@ -315,17 +484,14 @@ bool buildQueueForDirectory(fs::FS& fs, AppState& appState, const char* dirname,
 bool buildBrowserEntries(fs::FS& fs, AppState& appState, const char* dirname) {
   String dir = normalizeDir(dirname);
 
-  appState.browserEntryCount = 0;
+#if ENABLE_LOGGING
+  const size_t heapBefore = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+  const size_t largestBefore = heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL);
+#endif
+  appState.clearBrowserEntries();
   appState.browserCurrentDir = dir;
   appState.currentSelectedIndex = 0;
 
-  for (int i = 0; i < MAX_BROWSER_ENTRIES; ++i) {
-    appState.browserEntryIsDir[i] = false;
-    appState.browserEntrySongIndex[i] = -1;
-    appState.browserEntryName[i] = "";
-    appState.browserEntryPath[i] = "";
-  }
-
   if (dir != "/") {
     String parentDir = getParentDir(dir);
     (void)addBrowserDirectoryEntry(appState, "..", parentDir);
@@ -341,7 +507,8 @@ bool buildBrowserEntries(fs::FS& fs, AppState& appState, const char* dirname) {
   while (indexFile.available() && songIndex < appState.libraryCount && appState.browserEntryCount < MAX_BROWSER_ENTRIES) {
     String line = indexFile.readStringUntil('\n');
     line.trim();
-    if (line.length() == 0) continue;
+    if (line.length() == 0 || isIndexDirective(line)) continue;
+    line = indexLinePath(line);
 
     if (!pathInDirectoryRecursive(line, dir)) {
       songIndex++;
@@ -371,7 +538,13 @@ bool buildBrowserEntries(fs::FS& fs, AppState& appState, const char* dirname) {
   }
   indexFile.close();
 
-  LOG_PRINTF("Browser dir '%s': %d entries\n", dir.c_str(), appState.browserEntryCount);
+  LOG_PRINTF("Browser dir '%s': %d entries, arena %u/%u B\n", dir.c_str(), appState.browserEntryCount,
+             (unsigned)appState.browserArena.used(), (unsigned)appState.browserArena.capacity());
+  // Fragmentation report: the view itself allocates nothing, so these should only move by
+  // what the index scan's temporary Strings leave behind
+  LOG_PRINTF("Heap internal: free %u -> %u B, largest block %u -> %u B\n",
+             (unsigned)heapBefore, (unsigned)heap_caps_get_free_size(MALLOC_CAP_INTERNAL),
+             (unsigned)largestBefore, (unsigned)heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL));
   return true;
 }
 
@@ -388,7 +561,6 @@ void deleteCurrentFile(fs::FS& fs, AppState& appState, const Callbacks& callback
     return;
   }
 
-  bool wasPlaying = (appState.isPlaying && !appState.stopped);
   bool deletingPlayingSong = (deletedQueueIndex == appState.currentPlayingIndex);
 
   String playingPath;
@@ -420,8 +592,7 @@ void deleteCurrentFile(fs::FS& fs, AppState& appState, const Callbacks& callback
   }
 
   if (appState.fileCount <= 0) {
-    appState.isPlaying = false;
-    appState.stopped = true;
+    if (callbacks.stopPlayback) callbacks.stopPlayback();
     appState.currentSelectedIndex = 0;
     appState.currentPlayingIndex = 0;
     LOG_PRINTLN("No more files available");
@@ -452,11 +623,7 @@ void deleteCurrentFile(fs::FS& fs, AppState& appState, const Callbacks& callback
 
   if (deletingPlayingSong) {
     if (callbacks.resetClock) callbacks.resetClock();
-    appState.nextS = 1;
-    if (wasPlaying) {
-      appState.isPlaying = true;
-      appState.stopped = false;
-    }
+    if (callbacks.playQueueIndex) callbacks.playQueueIndex(newPlayingIndex);
   }
 
   if (callbacks.onFileDeleted) {
@@ -0,0 +1,207 @@
+#include "../include/glyph_cache.hpp"
+#include "../include/config.hpp"
+#include "../include/path_hash.hpp"
+#include <esp_heap_caps.h>
+#include <cstring>
+
+namespace GlyphCache {
+
+namespace {
+
+struct Glyph {
+  const lgfx::U8g2font* font;
+  uint32_t codepoint;
+  uint32_t lastUse;
+  uint8_t width;      // Bitmap width (the glyph advance)
+  uint8_t height;
+  uint8_t advance;
+  bool valid;
+  bool oversized;     // Larger than GLYPH_MAX_*; drawn with drawString instead
+  uint8_t bits[GLYPH_BITMAP_BYTES];
+};
+
+Glyph* g_pool = nullptr;  // GLYPH_CACHE_SETS * GLYPH_CACHE_WAYS entries
+M5Canvas g_scratch;       // 1-bit canvas a glyph is rasterised into on a miss
+uint32_t g_useCounter = 0;
+uint32_t g_hits = 0;
+uint32_t g_misses = 0;
+
+// Decode one UTF-8 sequence; returns 0 at the terminator
+uint32_t nextCodepoint(const uint8_t*& p) {
+  uint8_t c = *p;
+  if (c == 0) return 0;
+  int extra = 0;
+  uint32_t cp = 0;
+  if ((c & 0x80) == 0) { p++; return c; }
+  else if ((c & 0xE0) == 0xC0) { cp = c & 0x1F; extra = 1; }
+  else if ((c & 0xF0) == 0xE0) { cp = c & 0x0F; extra = 2; }
+  else if ((c & 0xF8) == 0xF0) { cp = c & 0x07; extra = 3; }
+  else { p++; return '?'; }  // Invalid lead byte
+  p++;
+  for (int i = 0; i < extra; ++i) {
+    if ((*p & 0xC0) != 0x80) return '?';  // Truncated sequence
+    cp = (cp << 6) | (*p & 0x3F);
+    p++;
+  }
+  return cp;
+}
+
+int encodeUtf8(uint32_t cp, char* out) {
+  int n = 0;
+  if (cp < 0x80) {
+    out[n++] = (char)cp;
+  } else if (cp < 0x800) {
+    out[n++] = (char)(0xC0 | (cp >> 6));
+    out[n++] = (char)(0x80 | (cp & 0x3F));
+  } else if (cp < 0x10000) {
+    out[n++] = (char)(0xE0 | (cp >> 12));
+    out[n++] = (char)(0x80 | ((cp >> 6) & 0x3F));
+    out[n++] = (char)(0x80 | (cp & 0x3F));
+  } else {
+    out[n++] = (char)(0xF0 | (cp >> 18));
+    out[n++] = (char)(0x80 | ((cp >> 12) & 0x3F));
+    out[n++] = (char)(0x80 | ((cp >> 6) & 0x3F));
+    out[n++] = (char)(0x80 | (cp & 0x3F));
+  }
+  out[n] = '\0';
+  return n;
+}
+
+void rasterize(Glyph* g, const lgfx::U8g2font* font, uint32_t codepoint) {
+  char utf8[5];
+  encodeUtf8(codepoint, utf8);
+  g_scratch.setFont(font);
+  int32_t advance = g_scratch.textWidth(utf8);
+  int32_t height = g_scratch.fontHeight();
+
+  g->font = font;
+  g->codepoint = codepoint;
+  g->valid = true;
+  g->advance = (uint8_t)constrain(advance, 0, 255);
+  g->height = (uint8_t)constrain(height, 0, 255);
+  g->oversized = (advance > GLYPH_MAX_WIDTH || height > GLYPH_MAX_HEIGHT);
+  g->width = g->oversized ? 0 : (uint8_t)advance;
+  memset(g->bits, 0, sizeof(g->bits));
+  if (g->oversized || advance <= 0) return;
+
+  g_scratch.fillScreen(0);
+  g_scratch.setTextColor(1, 0);
+  g_scratch.setTextDatum(0);
+  g_scratch.drawString(utf8, 0, 0);
+  const int stride = (advance + 7) / 8;
+  for (int32_t y = 0; y < height; ++y) {
+    for (int32_t x = 0; x < advance; ++x) {
+      if (g_scratch.readPixelValue(x, y)) {
+        g->bits[y * stride + (x >> 3)] |= (uint8_t)(0x80 >> (x & 7));
+      }
+    }
+  }
+}
+
+Glyph* lookup(const lgfx::U8g2font* font, uint32_t codepoint) {
+  uint32_t h = fnv1a32Mix(FNV1A_OFFSET_BASIS, (uint32_t)(uintptr_t)font);
+  h = fnv1a32Mix(h, codepoint);
+  Glyph* set = &g_pool[(h & (GLYPH_CACHE_SETS - 1)) * GLYPH_CACHE_WAYS];
+
+  Glyph* victim = nullptr;
+  for (int w = 0; w < GLYPH_CACHE_WAYS; ++w) {
+    Glyph* g = &set[w];
+    if (g->valid && g->font == font && g->codepoint == codepoint) {
+      g->lastUse = ++g_useCounter;
+      g_hits++;
+      return g;
+    }
+    if (!victim || (victim->valid && (!g->valid || g->lastUse < victim->lastUse))) victim = g;
+  }
+
+  g_misses++;
+  rasterize(victim, font, codepoint);
+  victim->lastUse = ++g_useCounter;
+  return victim;
+}
+
+}  // namespace
+
+bool initialize() {
+  if (g_pool) return true;
+  const size_t bytes = sizeof(Glyph) * GLYPH_CACHE_SETS * GLYPH_CACHE_WAYS;
+  uint32_t caps = psramFound() ? MALLOC_CAP_SPIRAM : MALLOC_CAP_8BIT;
+  g_pool = (Glyph*)heap_caps_calloc(1, bytes, caps);
+  if (!g_pool) {
+    LOG_PRINTF("GlyphCache: failed to allocate %u bytes, using direct font rendering\n", (unsigned)bytes);
+    return false;
+  }
+  g_scratch.setColorDepth(1);
+  if (!g_scratch.createSprite(GLYPH_MAX_WIDTH, GLYPH_MAX_HEIGHT)) {
+    heap_caps_free(g_pool);
+    g_pool = nullptr;
+    return false;
+  }
+  LOG_PRINTF("GlyphCache: %d glyphs, %u bytes\n", GLYPH_CACHE_SETS * GLYPH_CACHE_WAYS, (unsigned)bytes);
+  return true;
+}
+
+int32_t textWidth(const char* text, const lgfx::U8g2font* font) {
+  if (!text || !font) return 0;
+  if (!g_pool) {
+    g_scratch.setFont(font);
+    return g_scratch.textWidth(text);
+  }
+  int32_t width = 0;
+  const uint8_t* p = (const uint8_t*)text;
+  uint32_t cp;
+  while ((cp = nextCodepoint(p)) != 0) {
+    width += lookup(font, cp)->advance;
+  }
+  return width;
+}
+
+int32_t drawText(M5Canvas& dst, const char* text, const lgfx::U8g2font* font,
+                 int32_t x, int32_t y, uint16_t fg, uint16_t bg) {
+  if (!text || !*text || !font) return 0;
+  if (!g_pool) {
+    dst.setFont(font);
+    dst.setTextColor(fg, bg);
+    return dst.drawString(text, x, y);
+  }
+
+  // Apply the text datum the same way drawString would
+  const int32_t width = textWidth(text, font);
+  g_scratch.setFont(font);
+  const int32_t height = g_scratch.fontHeight();
+  lgfx::FontMetrics metrics;
+  font->getDefaultMetric(&metrics);
+  const uint8_t datum = (uint8_t)dst.getTextDatum();
+  if ((datum & 3) == 1) x -= width >> 1;
+  else if ((datum & 3) == 2) x -= width;
+  if (datum & 16) y -= metrics.baseline;  // Glyph top to baseline, i.e. height less the descent
+  else if (datum & 8) y -= height;
+  else if (datum & 4) y -= height >> 1;
+
+  const uint8_t* p = (const uint8_t*)text;
+  uint32_t cp;
+  int32_t cx = x;
+  while ((cp = nextCodepoint(p)) != 0) {
+    Glyph* g = lookup(font, cp);
+    if (g->oversized) {
+      char utf8[5];
+      encodeUtf8(cp, utf8);
+      dst.setFont(font);
+      dst.setTextColor(fg, bg);
+      dst.setTextDatum(0);
+      dst.drawString(utf8, cx, y);
+      dst.setTextDatum((lgfx::textdatum_t)datum);
+    } else if (g->width > 0) {
+      dst.drawBitmap(cx, y, g->bits, g->width, g->height, fg, bg);
+    }
+    cx += g->advance;
+  }
+  return width;
+}
+
+void getStats(uint32_t& hits, uint32_t& misses) {
+  hits = g_hits;
+  misses = g_misses;
+}
+
+}  // namespace GlyphCache
@@ -2,6 +2,9 @@
 #include "M5Cardputer.h"
 #include "../include/input_handler.hpp"
 #include "../include/config.hpp"
+#include "../include/audio_manager.hpp"
+#include "../include/storage.hpp"
+#include "../include/trace.hpp"
 
 // Forward declaration
 extern void resetClock();
@@ -52,6 +55,19 @@ bool processBasicToggles(AppState& appState) {
     needRedraw = true;
   }
 
+  // '`' key: hidden diagnostics page (heap, stacks)
+  if (M5Cardputer.Keyboard.isKeyPressed('`')) {
+    appState.showDiagPage = !appState.showDiagPage;
+    needRedraw = true;
+  }
+
+#if ENABLE_TRACE
+  // 't' key: print the trace ring over serial (scripts/trace2perfetto.py)
+  if (M5Cardputer.Keyboard.isKeyPressed('t')) {
+    Trace::dump();
+  }
+#endif
+
   return needRedraw;
 }
 
@@ -90,9 +106,7 @@ bool processPlaybackAndList(AppState& appState) {
       appState.currentSelectedIndex++;
       if (appState.currentSelectedIndex >= appState.fileCount) appState.currentSelectedIndex = 0;
     }
-    appState.isPlaying = false;
-    // Note: stopped is not set here - it will be set to false in Task_Audio after nextS is processed
-    appState.nextS = 1;
+    AudioManager::requestTrack(Storage::fs(), appState, appState.currentSelectedIndex);
     needRedraw = true;
   }
   // 'p' previous song (respect random)
@@ -112,22 +126,73 @@ bool processPlaybackAndList(AppState& appState) {
       appState.currentSelectedIndex--;
       if (appState.currentSelectedIndex < 0) appState.currentSelectedIndex = appState.fileCount - 1;
     }
-    appState.isPlaying = false;
-    // Note: stopped is not set here - it will be set to false in Task_Audio after nextS is processed
-    appState.nextS = 1;
+    AudioManager::requestTrack(Storage::fs(), appState, appState.currentSelectedIndex);
     needRedraw = true;
   }
   // Enter: request play selected
   if (M5Cardputer.Keyboard.isKeyPressed(KEY_ENTER)) {
     resetClock();
-    appState.isPlaying = false;
-    appState.stopped = false;
-    appState.nextS = 1;
+    AudioManager::requestTrack(Storage::fs(), appState, appState.currentSelectedIndex);
     needRedraw = true;
   }
   return needRedraw;
 }
 
+bool processSeekKeys(AppState& appState) {
+  if (appState.showDeleteDialog || appState.stopped) return false;
+  bool requested = false;
+  if (M5Cardputer.Keyboard.isKeyPressed(',')) {
+    requested |= AudioManager::postCommand(AudioManager::AudioCommandType::SeekRelative, -SEEK_STEP_SHORT_SEC);
+  }
+  if (M5Cardputer.Keyboard.isKeyPressed('/')) {
+    requested |= AudioManager::postCommand(AudioManager::AudioCommandType::SeekRelative, SEEK_STEP_SHORT_SEC);
+  }
+  if (M5Cardputer.Keyboard.isKeyPressed('[')) {
+    requested |= AudioManager::postCommand(AudioManager::AudioCommandType::SeekRelative, -SEEK_STEP_LONG_SEC);
+  }
+  if (M5Cardputer.Keyboard.isKeyPressed(']')) {
+    requested |= AudioManager::postCommand(AudioManager::AudioCommandType::SeekRelative, SEEK_STEP_LONG_SEC);
+  }
+  for (char digit = '0'; digit <= '9'; ++digit) {
+    if (M5Cardputer.Keyboard.isKeyPressed(digit)) {
+      requested |= AudioManager::postCommand(AudioManager::AudioCommandType::SeekPercent, (digit - '0') * 10);
+    }
+  }
+  if (requested) LOG_PRINTLN("Seek requested");
+  return requested;
+}
+
+bool processSpeedKey(AppState& appState) {
+  if (!M5Cardputer.Keyboard.isKeyPressed('x')) return false;
+  int next = 0;
+  for (int i = 0; i < PLAYBACK_SPEED_COUNT; ++i) {
+    if (PLAYBACK_SPEEDS_PCT[i] == appState.playbackSpeedPct) next = (i + 1) % PLAYBACK_SPEED_COUNT;
+  }
+  if (!AudioManager::postCommand(AudioManager::AudioCommandType::SetSpeed, PLAYBACK_SPEEDS_PCT[next])) return false;
+  appState.playbackSpeedPct = PLAYBACK_SPEEDS_PCT[next];
+  appState.lastAudioInfoUpdate = 0;  // Show the new speed right away
+  LOG_PRINTF("Playback speed: %d%%\n", (int)appState.playbackSpeedPct);
+  return true;
+}
+
+bool processReplayGainKey(AppState& appState) {
+  if (!M5Cardputer.Keyboard.isKeyPressed('r')) return false;
+  uint8_t next = (appState.replayGainMode + 1) % 3;
+  if (!AudioManager::postCommand(AudioManager::AudioCommandType::SetReplayGainMode, next)) return false;
+  appState.replayGainMode = next;
+  static const char* const kNames[] = {"off", "track", "album"};
+  LOG_PRINTF("ReplayGain: %s\n", kNames[next]);
+  return true;
+}
+
+bool processLatencyKey(AppState& appState) {
+  if (!M5Cardputer.Keyboard.isKeyPressed('k')) return false;
+  uint8_t next = (appState.latencyMode + 1) % LATENCY_MODE_COUNT;
+  if (!AudioManager::postCommand(AudioManager::AudioCommandType::SetLatencyMode, next)) return false;
+  appState.latencyMode = next;
+  return true;
+}
+
 bool processDeleteAndScreenshot(AppState& appState, const Actions& actions) {
   bool needRedraw = false;
   if (appState.browserMode) {
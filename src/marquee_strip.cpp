@@ -0,0 +1,51 @@
+#include "../include/marquee_strip.hpp"
+#include "../include/config.hpp"
+#include "../include/path_hash.hpp"
+
+int32_t MarqueeStrip::prepare(const String& text, const lgfx::U8g2font* font, uint16_t fg, uint16_t bg) {
+  uint32_t hash = fnv1a32(text.c_str());
+  if (!_ready || hash != _hash || font != _font) {
+    _hash = hash;
+    _font = font;
+    _ready = false;
+
+    if (font) _canvas.setFont(font); else _canvas.setTextFont(0);
+    _textWidth = _canvas.textWidth(text);
+    int32_t stripW = _textWidth < MARQUEE_MAX_WIDTH ? _textWidth : MARQUEE_MAX_WIDTH;
+    int32_t stripH = _canvas.fontHeight();
+    if (stripW <= 0 || stripH <= 0) return _textWidth;
+
+    // 1-bit with a two-entry palette: about 2KB for a 1024px line
+    if (_canvas.width() != stripW || _canvas.height() != stripH) {
+      _canvas.deleteSprite();
+      _canvas.setColorDepth(1);
+      if (!_canvas.createSprite(stripW, stripH)) {
+        LOG_PRINTF("MarqueeStrip: failed to allocate %dx%d strip\n", (int)stripW, (int)stripH);
+        return _textWidth;
+      }
+      _canvas.createPalette();
+    }
+    _canvas.fillScreen(0);
+    _canvas.setTextColor(1, 0);
+    _canvas.setTextDatum(0);
+    _canvas.drawString(text, 0, 0);
+    _ready = true;
+    _fg = ~fg;  // Force the palette update below
+  }
+  if (fg != _fg || bg != _bg) {
+    _fg = fg;
+    _bg = bg;
+    _canvas.setPaletteColor(0, bg);
+    _canvas.setPaletteColor(1, fg);
+  }
+  return _textWidth;
+}
+
+void MarqueeStrip::draw(M5Canvas& dst, int32_t x, int32_t y) {
+  if (!_ready) return;
+  const int32_t h = _canvas.height();
+  const uint8_t datum = (uint8_t)dst.getTextDatum();
+  if (datum & (8 | 16)) y -= h;
+  else if (datum & 4) y -= h >> 1;
+  _canvas.pushSprite(&dst, x, y);
+}
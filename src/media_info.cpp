@@ -0,0 +1,309 @@
+#include "../include/media_info.hpp"
+#include "../include/config.hpp"
+#include <cstdlib>
+#include <cstring>
+
+namespace MediaInfo {
+
+namespace {
+
+uint32_t be32(const uint8_t* p) {
+  return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+uint32_t le32(const uint8_t* p) {
+  return ((uint32_t)p[3] << 24) | ((uint32_t)p[2] << 16) | ((uint32_t)p[1] << 8) | p[0];
+}
+
+uint64_t be64(const uint8_t* p) {
+  return ((uint64_t)be32(p) << 32) | be32(p + 4);
+}
+
+bool readAt(File& f, uint32_t pos, uint8_t* buf, size_t len) {
+  return f.seek(pos) && f.read(buf, len) == len;
+}
+
+uint32_t roundedSeconds(uint64_t units, uint32_t unitsPerSecond) {
+  if (unitsPerSecond == 0) return 0;
+  return (uint32_t)((units + unitsPerSecond / 2) / unitsPerSecond);
+}
+
+// MPEG audio Layer III header: frame length in bytes, or -1 if not a valid header
+int mp3FrameLength(const uint8_t* h, uint32_t& sampleRate, uint32_t& bitrate, uint16_t& samplesPerFrame) {
+  static const uint16_t kBitrateMpeg1[15] = {0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320};
+  static const uint16_t kBitrateMpeg2[15] = {0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160};
+  static const uint16_t kSampleRate[3] = {44100, 48000, 32000};
+
+  if (h[0] != 0xFF || (h[1] & 0xE0) != 0xE0) return -1;
+  uint8_t version = (h[1] >> 3) & 0x03;  // 0: MPEG2.5, 1: reserved, 2: MPEG2, 3: MPEG1
+  uint8_t layer = (h[1] >> 1) & 0x03;    // 1: Layer III
+  uint8_t brIdx = (h[2] >> 4) & 0x0F;
+  uint8_t srIdx = (h[2] >> 2) & 0x03;
+  if (version == 1 || layer != 1 || brIdx == 0 || brIdx == 15 || srIdx == 3) return -1;
+
+  sampleRate = kSampleRate[srIdx] >> (version == 3 ? 0 : (version == 2 ? 1 : 2));
+  bitrate = (uint32_t)(version == 3 ? kBitrateMpeg1[brIdx] : kBitrateMpeg2[brIdx]) * 1000;
+  samplesPerFrame = (version == 3) ? 1152 : 576;
+  return (samplesPerFrame / 8) * bitrate / sampleRate + ((h[2] >> 1) & 0x01);
+}
+
+uint32_t probeMp3(File& f, uint32_t start) {
+  const size_t kProbeBytes = 1024;
+  uint8_t* buf = (uint8_t*)malloc(kProbeBytes);
+  if (!buf) return 0;
+  size_t n = f.seek(start) ? f.read(buf, kProbeBytes) : 0;
+
+  uint32_t result = 0;
+  for (size_t i = 0; i + 4 <= n; ++i) {
+    uint32_t sr, br, sr2, br2;
+    uint16_t spf, spf2;
+    int len = mp3FrameLength(buf + i, sr, br, spf);
+    if (len < 0) continue;
+    // A second header at the expected distance rules out 0xFFEx inside ID3 padding
+    if (i + len + 4 <= n && (mp3FrameLength(buf + i + len, sr2, br2, spf2) < 0 || sr2 != sr)) continue;
+
+    const uint8_t* h = buf + i;
+    bool mpeg1 = ((h[1] >> 3) & 0x03) == 3;
+    bool mono = ((h[3] >> 6) & 0x03) == 3;
+    size_t xing = i + 4 + (mpeg1 ? (mono ? 17 : 32) : (mono ? 9 : 17));
+    size_t vbri = i + 4 + 32;
+    uint32_t frames = 0;
+    if (xing + 12 <= n && (memcmp(buf + xing, "Xing", 4) == 0 || memcmp(buf + xing, "Info", 4) == 0)) {
+      if (be32(buf + xing + 4) & 0x01) frames = be32(buf + xing + 8);
+    } else if (vbri + 18 <= n && memcmp(buf + vbri, "VBRI", 4) == 0) {
+      frames = be32(buf + vbri + 14);
+    }
+
+    if (frames > 0) {
+      result = roundedSeconds((uint64_t)frames * spf, sr);
+    } else {
+      // No VBR header: treat as CBR, excluding a trailing ID3v1 tag
+      uint32_t audioBytes = f.size() - (start + i);
+      uint8_t tag[3];
+      if (f.size() > 128 && readAt(f, f.size() - 128, tag, 3) && memcmp(tag, "TAG", 3) == 0) audioBytes -= 128;
+      result = roundedSeconds((uint64_t)audioBytes * 8, br);
+    }
+    break;
+  }
+  free(buf);
+  return result;
+}
+
+uint32_t probeWav(File& f) {
+  uint8_t chunk[16];
+  uint32_t pos = 12;  // After "RIFF" size "WAVE"
+  uint32_t byteRate = 0;
+  for (int i = 0; i < 32 && pos + 8 <= f.size(); ++i) {
+    if (!readAt(f, pos, chunk, 8)) break;
+    uint32_t size = le32(chunk + 4);
+    if (memcmp(chunk, "fmt ", 4) == 0) {
+      if (!readAt(f, pos + 8, chunk, 16)) break;
+      byteRate = le32(chunk + 8);
+    } else if (memcmp(chunk, "data", 4) == 0) {
+      uint32_t available = f.size() - (pos + 8);
+      if (size == 0 || size > available) size = available;  // Streamed or truncated files
+      return roundedSeconds(size, byteRate);
+    }
+    pos += 8 + size + (size & 1);
+  }
+  return 0;
+}
+
+uint32_t probeFlac(File& f, uint32_t start) {
+  uint8_t b[4 + 4 + 18];
+  // "fLaC", then the STREAMINFO block header and the first 18 bytes of its body
+  if (!readAt(f, start, b, sizeof(b)) || (b[4] & 0x7F) != 0) return 0;
+  const uint8_t* si = b + 8;
+  uint32_t sampleRate = ((uint32_t)si[10] << 12) | ((uint32_t)si[11] << 4) | (si[12] >> 4);
+  uint64_t totalSamples = ((uint64_t)(si[13] & 0x0F) << 32) | be32(si + 14);
+  return roundedSeconds(totalSamples, sampleRate);
+}
+
+// Find a child atom of the given type in [begin, end); returns its payload range
+bool findAtom(File& f, uint32_t begin, uint32_t end, const char* type, uint32_t& payload, uint32_t& payloadEnd) {
+  uint8_t hdr[16];
+  uint32_t pos = begin;
+  while (pos + 8 <= end) {
+    if (!readAt(f, pos, hdr, 8)) return false;
+    uint64_t size = be32(hdr);
+    uint32_t headerLen = 8;
+    if (size == 1) {
+      if (!readAt(f, pos + 8, hdr + 8, 8)) return false;
+      size = be64(hdr + 8);
+      headerLen = 16;
+    } else if (size == 0) {
+      size = end - pos;  // Extends to the end of the parent
+    }
+    if (size < headerLen || pos + size > end) return false;
+    if (memcmp(hdr + 4, type, 4) == 0) {
+      payload = pos + headerLen;
+      payloadEnd = pos + (uint32_t)size;
+      return true;
+    }
+    pos += (uint32_t)size;
+  }
+  return false;
+}
+
+uint32_t probeM4a(File& f) {
+  uint32_t p = 0, e = f.size();
+  static const char* const kPath[] = {"moov", "trak", "mdia", "mdhd"};
+  for (const char* type : kPath) {
+    if (!findAtom(f, p, e, type, p, e)) return 0;
+  }
+  uint8_t b[32];
+  if (!readAt(f, p, b, 1)) return 0;
+  if (b[0] == 1) {  // Version 1: 64-bit times
+    if (!readAt(f, p, b, 32)) return 0;
+    return roundedSeconds(be64(b + 24), be32(b + 20));
+  }
+  if (!readAt(f, p, b, 20)) return 0;
+  return roundedSeconds(be32(b + 16), be32(b + 12));
+}
+
+// Apply one "REPLAYGAIN_..." key/value pair; key compared case-insensitively
+void applyReplayGainField(const char* key, const char* value, ReplayGain& rg) {
+  static const char kPrefix[] = "REPLAYGAIN_";
+  if (strncasecmp(key, kPrefix, sizeof(kPrefix) - 1) != 0) return;
+  key += sizeof(kPrefix) - 1;
+  float v = strtof(value, nullptr);  // "-7.53 dB", "0.988312"
+  if (strcasecmp(key, "TRACK_GAIN") == 0) rg.trackGain = (int16_t)constrain(lroundf(v * 100), -6000L, 6000L);
+  else if (strcasecmp(key, "ALBUM_GAIN") == 0) rg.albumGain = (int16_t)constrain(lroundf(v * 100), -6000L, 6000L);
+  else if (strcasecmp(key, "TRACK_PEAK") == 0) rg.trackPeak = (uint16_t)constrain(lroundf(v * 10000), 0L, 65535L);
+  else if (strcasecmp(key, "ALBUM_PEAK") == 0) rg.albumPeak = (uint16_t)constrain(lroundf(v * 10000), 0L, 65535L);
+}
+
+// ID3 text in any of the four encodings, reduced to ASCII (the ReplayGain keys and values are ASCII).
+// Returns the number of bytes consumed including the terminator.
+size_t id3TextToAscii(const uint8_t* p, size_t len, uint8_t encoding, char* out, size_t outLen) {
+  const bool wide = encoding == 1 || encoding == 2;
+  size_t i = 0, n = 0;
+  while (i < len) {
+    uint8_t c = p[i];
+    if (wide) {
+      if (i + 1 >= len) { i = len; break; }
+      uint8_t c2 = p[i + 1];
+      i += 2;
+      if (c == 0 && c2 == 0) break;
+      if ((c == 0xFF && c2 == 0xFE) || (c == 0xFE && c2 == 0xFF)) continue;  // BOM
+      c = c ? c : c2;
+    } else {
+      i++;
+      if (c == 0) break;
+    }
+    if (c < 0x80 && n + 1 < outLen) out[n++] = (char)c;
+  }
+  out[n] = 0;
+  return i;
+}
+
+void probeId3ReplayGain(File& f, const uint8_t* head, ReplayGain& rg) {
+  const uint8_t version = head[3];
+  if (version != 3 && version != 4) return;
+  if (version == 3 && (head[5] & 0x80)) return;  // Whole-tag unsynchronisation, rare
+  uint32_t tagEnd = 10 + (((uint32_t)(head[6] & 0x7F) << 21) | ((uint32_t)(head[7] & 0x7F) << 14) |
+                          ((uint32_t)(head[8] & 0x7F) << 7) | (head[9] & 0x7F));
+  uint32_t pos = 10;
+  uint8_t h[10];
+  if (head[5] & 0x40) {  // Extended header
+    if (!readAt(f, pos, h, 4)) return;
+    uint32_t ext = version == 4 ? (((uint32_t)(h[0] & 0x7F) << 21) | ((uint32_t)(h[1] & 0x7F) << 14) |
+                                   ((uint32_t)(h[2] & 0x7F) << 7) | (h[3] & 0x7F))
+                                : be32(h) + 4;
+    pos += ext;
+  }
+  uint8_t frame[256];
+  while (pos + 10 <= tagEnd && readAt(f, pos, h, 10) && h[0] != 0) {
+    uint32_t size = version == 4 ? (((uint32_t)(h[4] & 0x7F) << 21) | ((uint32_t)(h[5] & 0x7F) << 14) |
+                                    ((uint32_t)(h[6] & 0x7F) << 7) | (h[7] & 0x7F))
+                                 : be32(h + 4);
+    pos += 10;
+    // Compressed, encrypted or unsynchronised frames are skipped
+    bool plain = version == 4 ? (h[9] & 0x0E) == 0 : (h[9] & 0xC0) == 0;
+    if (memcmp(h, "TXXX", 4) == 0 && plain && size > 1 && size <= sizeof(frame) && readAt(f, pos, frame, size)) {
+      char key[32], value[32];
+      size_t used = 1 + id3TextToAscii(frame + 1, size - 1, frame[0], key, sizeof(key));
+      if (used < size) {
+        id3TextToAscii(frame + used, size - used, frame[0], value, sizeof(value));
+        applyReplayGainField(key, value, rg);
+      }
+    }
+    pos += size;
+  }
+}
+
+void probeFlacReplayGain(File& f, uint32_t start, ReplayGain& rg) {
+  uint32_t pos = start + 4;  // After "fLaC"
+  uint8_t h[4];
+  for (int block = 0; block < 64 && readAt(f, pos, h, 4); ++block) {
+    uint32_t len = ((uint32_t)h[1] << 16) | ((uint32_t)h[2] << 8) | h[3];
+    if ((h[0] & 0x7F) == 4) {  // VORBIS_COMMENT, little-endian lengths
+      uint32_t p = pos + 4, end = p + len;
+      uint8_t b[4];
+      if (!readAt(f, p, b, 4)) return;
+      p += 4 + le32(b);  // Vendor string
+      if (!readAt(f, p, b, 4)) return;
+      uint32_t count = le32(b);
+      p += 4;
+      char comment[64];
+      for (uint32_t i = 0; i < count && p + 4 <= end; ++i) {
+        if (!readAt(f, p, b, 4)) return;
+        uint32_t clen = le32(b);
+        p += 4;
+        if (clen >= 11 && clen < sizeof(comment) && readAt(f, p, (uint8_t*)comment, clen)) {
+          comment[clen] = 0;
+          char* eq = strchr(comment, '=');
+          if (eq) {
+            *eq = 0;
+            applyReplayGainField(comment, eq + 1, rg);
+          }
+        }
+        p += clen;
+      }
+      return;
+    }
+    if (h[0] & 0x80) return;  // Last metadata block
+    pos += 4 + len;
+  }
+}
+
+}  // namespace
+
+bool probeReplayGain(File& file, ReplayGain& out) {
+  out = ReplayGain();
+  if (!file || file.isDirectory()) return false;
+  uint8_t head[10];
+  if (!readAt(file, 0, head, sizeof(head))) return false;
+  uint32_t start = 0;
+  if (memcmp(head, "ID3", 3) == 0) {
+    probeId3ReplayGain(file, head, out);
+    uint32_t tagSize = ((uint32_t)(head[6] & 0x7F) << 21) | ((uint32_t)(head[7] & 0x7F) << 14) |
+                       ((uint32_t)(head[8] & 0x7F) << 7) | (head[9] & 0x7F);
+    start = 10 + tagSize + ((head[5] & 0x10) ? 10 : 0);
+    if (!readAt(file, start, head, 4)) return out.any();
+  }
+  if (memcmp(head, "fLaC", 4) == 0) probeFlacReplayGain(file, start, out);
+  return out.any();
+}
+
+uint32_t probeDurationSec(File& file) {
+  if (!file || file.isDirectory()) return 0;
+  uint8_t head[12];
+  if (!readAt(file, 0, head, sizeof(head))) return 0;
+
+  if (memcmp(head, "RIFF", 4) == 0 && memcmp(head + 8, "WAVE", 4) == 0) return probeWav(file);
+  if (memcmp(head + 4, "ftyp", 4) == 0) return probeM4a(file);
+
+  // MP3 and FLAC may both start with an ID3v2 tag
+  uint32_t start = 0;
+  if (memcmp(head, "ID3", 3) == 0) {
+    uint32_t tagSize = ((uint32_t)(head[6] & 0x7F) << 21) | ((uint32_t)(head[7] & 0x7F) << 14) |
+                       ((uint32_t)(head[8] & 0x7F) << 7) | (head[9] & 0x7F);
+    start = 10 + tagSize + ((head[5] & 0x10) ? 10 : 0);  // Optional footer
+    if (!readAt(file, start, head, 4)) return 0;
+  }
+  if (memcmp(head, "fLaC", 4) == 0) return probeFlac(file, start);
+  return probeMp3(file, start);
+}
+
+}  // namespace MediaInfo
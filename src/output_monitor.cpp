@@ -0,0 +1,149 @@
+#include "../include/output_monitor.hpp"
+#include <atomic>
+#include <climits>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include "Audio.h"
+#include "../include/diagnostics.hpp"
+#include "../include/seqlock.hpp"
+
+namespace OutputMonitor {
+
+namespace {
+
+Audio* g_audio = nullptr;
+TaskHandle_t g_audioTask = nullptr;
+TaskHandle_t g_task = nullptr;
+std::atomic<bool> g_active{false};
+std::atomic<uint32_t> g_queuedMs{0};
+
+Seqlock<Stats> g_published;
+Stats g_stats = {};  // Monitor task only
+
+// Depth accounting: bytes queued = written by i2s_write - played by the DMA. Each
+// TX_DONE is one buffer played; TX_Q_OVF means the DMA found no new buffer and
+// replayed silence, so everything written so far has been played.
+uint32_t g_played = 0;
+bool g_primed = false;   // Reached half the DMA since the last underrun / pause
+bool g_low = false;      // In a near miss; the next one counts once back above OUTPUT_REARM_PCT
+bool g_eventPending = false;  // Publish now rather than at the next interval
+uint32_t g_lastPublishMs = 0;
+
+char taskState(TaskHandle_t running) {
+  if (!g_audioTask) return '?';
+  if (running == g_audioTask) return 'R';
+  switch (eTaskGetState(g_audioTask)) {
+    case eReady: return 'r';
+    case eBlocked: return 'B';
+    case eSuspended: return 'S';
+    default: return '?';
+  }
+}
+
+void recordEvent(bool underrun) {
+  if (underrun) {
+    g_stats.underruns++;
+  } else {
+    g_stats.nearMisses++;
+  }
+  TaskHandle_t running = xTaskGetCurrentTaskHandleForCPU(1);
+  strlcpy(g_stats.lastTask, running ? pcTaskGetName(running) : "-", sizeof(g_stats.lastTask));
+  g_stats.lastAudioState = taskState(running);
+  g_stats.lastEventMs = millis();
+  g_stats.lastWasUnderrun = underrun;
+  g_eventPending = true;
+  LOG_PRINTF("OutputMonitor: %s, %lu ms queued, core 1 running %s (audio %c)\n",
+             underrun ? "underrun" : "near miss", (unsigned long)g_stats.depthMs, g_stats.lastTask,
+             g_stats.lastAudioState);
+}
+
+void handleEvent(const i2s_event_t& ev) {
+  uint32_t written = g_audio->getI2sBytesWritten();
+  uint32_t bufBytes = g_audio->getI2sDmaBufBytes();
+  uint32_t capacity = bufBytes * g_audio->getI2sDmaBufCount();
+  uint32_t bytesPerSec = g_audio->getI2sSampleRate() * g_audio->getI2sFrameBytes();
+  bool active = g_active.load(std::memory_order_relaxed);
+
+  if (ev.type == I2S_EVENT_TX_Q_OVF) {
+    if (active && g_primed) recordEvent(true);
+    g_played = written;
+    g_primed = false;
+    g_low = false;
+  } else if (ev.type == I2S_EVENT_TX_DONE) {
+    g_played += bufBytes;
+  } else {
+    return;
+  }
+  uint32_t queued = written - g_played;
+  if ((int32_t)queued < 0) {  // The TX_DONE after each TX_Q_OVF, or buffers from before a reinstall
+    g_played = written;
+    queued = 0;
+  } else if (queued > capacity) {  // Partly filled buffer, or events dropped from a full queue
+    g_played = written - capacity;
+    queued = capacity;
+  }
+  g_stats.depthMs = bytesPerSec ? (uint32_t)((uint64_t)queued * 1000 / bytesPerSec) : 0;
+  g_queuedMs.store(g_stats.depthMs, std::memory_order_relaxed);
+  g_stats.capacityMs = bytesPerSec ? (uint32_t)((uint64_t)capacity * 1000 / bytesPerSec) : 0;
+  g_stats.dmaBufCount = g_audio->getI2sDmaBufCount();
+  g_stats.dmaBufLen = g_audio->getI2sDmaBufLen();
+
+  if (!active) {
+    g_primed = false;
+    g_low = false;
+  } else if (queued >= capacity / 2) {
+    g_primed = true;
+  }
+  if (active && g_primed) {
+    // Relative to the DMA size, which the latency modes change from ~35 to ~280 ms
+    if (g_stats.depthMs < g_stats.minDepthMs) g_stats.minDepthMs = g_stats.depthMs;
+    if (!g_low && queued < (uint64_t)capacity * OUTPUT_NEAR_MISS_PCT / 100) {
+      g_low = true;
+      recordEvent(false);
+    } else if (g_low && queued >= (uint64_t)capacity * OUTPUT_REARM_PCT / 100) {
+      g_low = false;
+    }
+  }
+}
+
+void monitorTask(void*) {
+  i2s_event_t ev;
+  while (true) {
+    bool got = g_audio->waitI2sEvent(&ev, pdMS_TO_TICKS(OUTPUT_MONITOR_WAIT_MS));
+    if (got) handleEvent(ev);
+    uint32_t now = millis();
+    if (!got || g_eventPending || now - g_lastPublishMs >= OUTPUT_MONITOR_PUBLISH_MS) {
+      g_eventPending = false;
+      g_lastPublishMs = now;
+      g_published.publish(g_stats);
+    }
+  }
+}
+
+}  // namespace
+
+bool start(Audio* audio, TaskHandle_t audioTask) {
+  if (!audio || g_task) return g_task != nullptr;
+  g_audio = audio;
+  g_audioTask = audioTask;
+  g_stats.minDepthMs = UINT32_MAX;
+  g_published.publish(g_stats);
+  xTaskCreatePinnedToCore(monitorTask, "Task_OutMon", OUTPUT_MONITOR_STACK_SIZE, NULL,
+                          OUTPUT_MONITOR_PRIORITY, &g_task, OUTPUT_MONITOR_CORE);
+  Diagnostics::registerTask("mon", g_task, OUTPUT_MONITOR_STACK_SIZE);
+  return g_task != nullptr;
+}
+
+void setActive(bool active) {
+  g_active.store(active, std::memory_order_relaxed);
+}
+
+void read(Stats& out) {
+  g_published.read(out);
+}
+
+uint32_t queuedMs() {
+  return g_queuedMs.load(std::memory_order_relaxed);
+}
+
+}  // namespace OutputMonitor
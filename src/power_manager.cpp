@@ -0,0 +1,175 @@
+#include "../include/power_manager.hpp"
+#include <string.h>
+#include "../include/audio_manager.hpp"
+#include "../include/board_init.hpp"
+#include "../include/output_monitor.hpp"
+#include "M5Cardputer.h"
+
+namespace PowerManager {
+
+namespace {
+
+constexpr uint32_t kLevelMhz[LevelCount] = {80, 160, 240};
+
+Report g_report = {Mhz240, Mhz80, {-1, -1, -1}, false};
+uint8_t g_boost = 0;              // Levels above the base, after near misses
+uint32_t g_boostChangedMs = 0;
+uint32_t g_seenEvents = 0;        // Output monitor near misses + underruns already acted on
+
+// Drain per level: PMIC current integrated over time, or voltage drop over whole segments
+uint32_t g_lastSampleMs = 0;
+float g_filteredMv = 0;
+float g_mAh[LevelCount] = {};
+float g_hours[LevelCount] = {};
+bool g_segmentOpen = false;
+Level g_segmentLevel = Mhz240;
+float g_segmentStartMv = 0;
+uint32_t g_segmentStartMs = 0;
+
+Level levelFor(uint32_t mhz) {
+  return mhz <= 80 ? Mhz80 : (mhz <= 160 ? Mhz160 : Mhz240);
+}
+
+// 16 bit up to 48 kHz decodes with room to spare at 80 MHz. Each stage on top of that
+// (hi-res decoding, WSOLA stretch, 32-tap or hi-res resampling) asks for one level more.
+Level loadLevel(const AudioManager::PlaybackStatus::Load& load) {
+  if (!load.sampleRate) return Mhz80;
+  bool pcm = strcmp(load.codec, "WAV") == 0;  // No decoder: more bits only widen the copy
+  int level = Mhz80;
+  if (load.sampleRate > POWER_HIRES_RATE || (load.bitsPerSample > 16 && !pcm)) level++;
+  if (load.stretching) level++;
+  if (load.resampling && (AUDIO_RESAMPLE_QUALITY >= 2 || load.sampleRate > POWER_HIRES_RATE)) level++;
+  return level > Mhz240 ? Mhz240 : (Level)level;
+}
+
+void setLevel(Level level) {
+  if (level == g_report.level) return;
+  if (!setCpuFrequencyMhz(kLevelMhz[level])) {
+    LOG_PRINTF("Power: %lu MHz refused\n", (unsigned long)kLevelMhz[level]);
+    return;
+  }
+  LOG_PRINTF("Power: CPU %lu MHz\n", (unsigned long)kLevelMhz[level]);
+  g_report.level = level;
+}
+
+void startSegment(uint32_t now) {
+  g_segmentOpen = true;
+  g_segmentLevel = g_report.level;
+  g_segmentStartMv = g_filteredMv;
+  g_segmentStartMs = now;
+}
+
+// Credit a whole segment to its level. Shorter ones are dropped: ADC noise is a few mV,
+// and 20 minutes at 100 mA is only ~17 mV of a 1750 mAh cell.
+void closeSegment(uint32_t now) {
+  if (!g_segmentOpen) return;
+  g_segmentOpen = false;
+  uint32_t ms = now - g_segmentStartMs;
+  float dropMv = g_segmentStartMv - g_filteredMv;
+  if (ms < POWER_SEGMENT_MS || dropMv <= 0) return;
+  Level l = g_segmentLevel;
+  g_mAh[l] += dropMv / (BATTERY_FULL_MV - BATTERY_EMPTY_MV) * BATTERY_CAPACITY_MAH;
+  g_hours[l] += ms / 3600000.0f;
+  g_report.drainMa[l] = (int32_t)(g_mAh[l] / g_hours[l] + 0.5f);
+  LOG_PRINTF("Power: %lu MHz for %lu min, -%.0f mV, ~%ld mA\n", (unsigned long)kLevelMhz[l],
+             (unsigned long)(ms / 60000), dropMv, (long)g_report.drainMa[l]);
+}
+
+void sampleBattery(uint32_t now) {
+  uint32_t elapsedMs = g_lastSampleMs ? now - g_lastSampleMs : 0;
+  g_lastSampleMs = now;
+
+  // Boards with a fuel-gauge PMIC report the current directly (negative while discharging)
+  BoardInit::lockI2c();
+  int32_t ma = M5Cardputer.Power.getBatteryCurrent();
+  BoardInit::unlockI2c();
+  if (ma < 0) {
+    Level l = g_report.level;
+    float hours = elapsedMs / 3600000.0f;
+    g_mAh[l] += -ma * hours;
+    g_hours[l] += hours;
+    if (g_hours[l] > 0) g_report.drainMa[l] = (int32_t)(g_mAh[l] / g_hours[l] + 0.5f);
+    g_report.measured = true;
+    return;
+  }
+  if (g_report.measured) return;
+
+  int mv = 0;
+  for (int i = 0; i < POWER_ADC_SAMPLES; ++i) mv += batteryMillivolts();
+  mv /= POWER_ADC_SAMPLES;
+  if (mv <= 0) return;
+  g_filteredMv = g_filteredMv > 0 ? g_filteredMv + (mv - g_filteredMv) / 8 : mv;
+
+  BoardInit::lockI2c();
+  bool pmicCharging = M5Cardputer.Power.isCharging() == m5::Power_Class::is_charging;
+  BoardInit::unlockI2c();
+  bool charging = pmicCharging ||
+                  (g_segmentOpen && g_filteredMv > g_segmentStartMv + POWER_CHARGE_RISE_MV);
+  if (charging) {
+    g_segmentOpen = false;  // Discarded
+    return;
+  }
+  if (g_segmentOpen && g_segmentLevel != g_report.level) {
+    closeSegment(now);  // Too short unless the level was stable for a while
+  } else if (g_segmentOpen && now - g_segmentStartMs >= POWER_SEGMENT_MS) {
+    closeSegment(now);
+  }
+  if (!g_segmentOpen) startSegment(now);
+}
+
+}  // namespace
+
+void initialize() {
+  g_report.level = levelFor(getCpuFrequencyMhz());
+  OutputMonitor::Stats out;
+  OutputMonitor::read(out);
+  g_seenEvents = out.underruns + out.nearMisses;
+}
+
+void update(const AppState& appState) {
+  uint32_t now = millis();
+#if POWER_DYNAMIC_CLOCK
+  OutputMonitor::Stats out;
+  OutputMonitor::read(out);
+  uint32_t events = out.underruns + out.nearMisses;
+  if (events != g_seenEvents) {
+    // The decoder fell behind: one level more, held for POWER_BOOST_HOLD_MS
+    g_seenEvents = events;
+    if (g_boost < Mhz240) g_boost++;
+    g_boostChangedMs = now;
+  } else if (g_boost > 0 && now - g_boostChangedMs >= POWER_BOOST_HOLD_MS) {
+    g_boost--;
+    g_boostChangedMs = now;
+  }
+  Level load = loadLevel(AudioManager::playbackLoad());
+  if (load != g_report.loadLevel) {
+    LOG_PRINTF("Power: playback load wants %lu MHz\n", (unsigned long)kLevelMhz[load]);
+    g_report.loadLevel = load;
+  }
+  Level screen = levelFor(appState.screenOff ? POWER_SCREEN_OFF_MHZ : POWER_SCREEN_ON_MHZ);
+  int level = (load > screen ? load : screen) + g_boost;
+  setLevel(level > Mhz240 ? Mhz240 : (Level)level);
+#else
+  (void)appState;
+#endif
+  if (now - g_lastSampleMs >= POWER_SAMPLE_MS || g_lastSampleMs == 0) sampleBattery(now);
+}
+
+const Report& report() {
+  return g_report;
+}
+
+int batteryMillivolts() {
+  BoardInit::lockI2c();
+  int mv = M5Cardputer.Power.getBatteryVoltage();
+  BoardInit::unlockI2c();
+  if (mv > 0) return mv;
+  // Direct ADC behind the 2:1 divider, as getBatteryPercent's fallback
+  return (int)(analogRead(BATTERY_ADC_PIN) / 4095.0f * 3.3f * 2.0f * 1000.0f);
+}
+
+uint32_t levelMhz(Level level) {
+  return kLevelMhz[level];
+}
+
+}  // namespace PowerManager
@@ -0,0 +1,66 @@
+#include "../include/sd_bench.hpp"
+#include "../include/config.hpp"
+#include <esp_heap_caps.h>
+
+namespace SdBench {
+
+bool measureReads(fs::FS& fs, const char* path, uint8_t* buf, uint32_t readSize, uint32_t totalBytes,
+                  ReadResult& result) {
+  result = ReadResult();
+  result.readSize = readSize;
+  File f = fs.open(path);
+  if (!f || f.isDirectory() || f.size() < readSize) return false;
+
+  uint64_t totalUs = 0;
+  uint32_t reads = 0;
+  while (result.bytes < totalBytes) {
+    if (f.position() + readSize > f.size()) f.seek(0);
+    uint32_t t0 = micros();
+    int n = f.read(buf, readSize);
+    uint32_t dt = micros() - t0;
+    if (n <= 0) break;
+    result.bytes += n;
+    totalUs += dt;
+    if (dt > result.worstUs) result.worstUs = dt;
+    ++reads;
+  }
+  f.close();
+  if (reads == 0 || totalUs == 0) return false;
+  result.avgUs = (uint32_t)(totalUs / reads);
+  result.kbPerSec = (uint32_t)((uint64_t)result.bytes * 1000000 / 1024 / totalUs);
+  return true;
+}
+
+void sweepReadSizes(fs::FS& fs, const char* path) {
+  static const uint32_t kSizes[] = {512, 4096, 8192, 16384, 32768, 65536, 131072};
+  const uint32_t caps = psramFound() ? MALLOC_CAP_SPIRAM : (MALLOC_CAP_DMA | MALLOC_CAP_8BIT);
+
+  // Largest buffer we can get; without PSRAM 64KB+ usually fails and those sizes are skipped
+  uint32_t bufSize = kSizes[sizeof(kSizes) / sizeof(kSizes[0]) - 1];
+  uint8_t* buf = nullptr;
+  while (bufSize >= 512 && !(buf = (uint8_t*)heap_caps_malloc(bufSize, caps))) bufSize /= 2;
+  if (!buf) {
+    LOG_PRINTLN("SdBench: no buffer");
+    return;
+  }
+
+  LOG_PRINTF("SdBench: %s, %u KB per size, buffer %u\n", path, (unsigned)(SD_BENCH_BYTES_PER_SIZE / 1024),
+             (unsigned)bufSize);
+  LOG_PRINTLN("SdBench:   size    KB/s   avg us  worst us");
+  for (uint32_t size : kSizes) {
+    if (size > bufSize) {
+      LOG_PRINTF("SdBench: %6u  skipped (no buffer)\n", (unsigned)size);
+      continue;
+    }
+    ReadResult r;
+    if (!measureReads(fs, path, buf, size, SD_BENCH_BYTES_PER_SIZE, r)) {
+      LOG_PRINTF("SdBench: %6u  failed\n", (unsigned)size);
+      continue;
+    }
+    LOG_PRINTF("SdBench: %6u  %6u  %7u  %8u\n", (unsigned)size, (unsigned)r.kbPerSec, (unsigned)r.avgUs,
+               (unsigned)r.worstUs);
+  }
+  heap_caps_free(buf);
+}
+
+}  // namespace SdBench
@@ -0,0 +1,149 @@
+#include "../include/session.hpp"
+#include "../include/config.hpp"
+#include "../include/audio_manager.hpp"
+#include "../include/file_manager.hpp"
+#include "../include/output_monitor.hpp"
+#include "../include/path_hash.hpp"
+#include <Preferences.h>
+
+namespace Session {
+
+namespace {
+
+struct Record {
+  uint32_t magic;         // SESSION_MAGIC; another value means another layout
+  uint32_t trackHash;     // fnv1a32 of the track path, guards against a rebuilt index
+  uint32_t filePos;       // Byte offset of the playback position
+  uint16_t songIndex;     // Into the library index
+  uint8_t volume;
+  uint8_t brightnessIndex;
+  uint8_t playMode;
+  uint8_t speedPct;
+  uint8_t replayGainMode;
+  uint8_t latencyMode;    // Was reserved (0 = balanced), so older records still load
+};
+// Saved records are read back byte for byte; a size change needs a new SESSION_MAGIC
+static_assert(sizeof(Record) == 20, "Session::Record layout changed");
+
+Record g_saved = {};      // What NVS holds
+String g_savedDir;
+Record g_pending = {};    // Last state seen by update(), for the debounce
+String g_pendingDir;
+bool g_loaded = false;
+uint32_t g_changedMs = 0;
+uint32_t g_lastWriteMs = 0;
+
+// Everything except the position
+bool sameSettings(const Record& a, const Record& b) {
+  return a.trackHash == b.trackHash && a.songIndex == b.songIndex && a.volume == b.volume &&
+         a.brightnessIndex == b.brightnessIndex && a.playMode == b.playMode && a.speedPct == b.speedPct &&
+         a.replayGainMode == b.replayGainMode && a.latencyMode == b.latencyMode;
+}
+
+Record capture(const AppState& appState) {
+  Record r = {};
+  r.magic = SESSION_MAGIC;
+  r.trackHash = AudioManager::getTrackHash();
+  r.filePos = AudioManager::getPlaybackFilePos();
+  if (appState.currentPlayingIndex >= 0 && appState.currentPlayingIndex < appState.fileCount) {
+    r.songIndex = appState.playbackQueue[appState.currentPlayingIndex];
+  }
+  r.volume = (uint8_t)appState.volume;
+  r.brightnessIndex = (uint8_t)appState.brightnessIndex;
+  r.playMode = (uint8_t)appState.playMode;
+  r.speedPct = appState.playbackSpeedPct;
+  r.replayGainMode = appState.replayGainMode;
+  r.latencyMode = appState.latencyMode;
+  return r;
+}
+
+void write(const Record& r, const String& dir) {
+  Preferences prefs;
+  if (!prefs.begin(SESSION_NVS_NAMESPACE, false)) {
+    LOG_PRINTLN("Session: NVS not available");
+    return;
+  }
+  prefs.putBytes("rec", &r, sizeof(r));
+  if (dir != g_savedDir) prefs.putString("dir", dir);
+  prefs.end();
+  g_saved = r;
+  g_savedDir = dir;
+  g_lastWriteMs = millis();
+}
+
+}  // namespace
+
+bool loadSettings(AppState& appState) {
+  Preferences prefs;
+  if (!prefs.begin(SESSION_NVS_NAMESPACE, true)) return false;  // Namespace not created yet
+  Record r = {};
+  bool ok = prefs.getBytes("rec", &r, sizeof(r)) == sizeof(r) && r.magic == SESSION_MAGIC;
+  if (ok) g_savedDir = prefs.getString("dir", MUSIC_DIR);
+  prefs.end();
+  if (!ok) return false;
+
+  g_saved = r;
+  g_pending = r;
+  g_pendingDir = g_savedDir;
+  g_loaded = true;
+  appState.volume = constrain((int)r.volume, 0, VOLUME_MAX);
+  appState.brightnessIndex = constrain((int)r.brightnessIndex, 0, BRIGHTNESS_LEVELS - 1);
+  if (r.playMode <= (uint8_t)PlaybackMode::SingleRepeat) appState.playMode = (PlaybackMode)r.playMode;
+  for (int i = 0; i < PLAYBACK_SPEED_COUNT; ++i) {
+    if (PLAYBACK_SPEEDS_PCT[i] == r.speedPct) appState.playbackSpeedPct = r.speedPct;
+  }
+  if (r.replayGainMode <= REPLAYGAIN_MODE_ALBUM) appState.replayGainMode = r.replayGainMode;
+  if (r.latencyMode < LATENCY_MODE_COUNT) appState.latencyMode = r.latencyMode;
+  LOG_PRINTF("Session: vol %d, bri %d, mode %d, speed %d%%, queue %s, song %u @ %lu\n", appState.volume,
+             appState.brightnessIndex, (int)appState.playMode, (int)appState.playbackSpeedPct, g_savedDir.c_str(),
+             (unsigned)r.songIndex, (unsigned long)r.filePos);
+  return true;
+}
+
+bool restoreQueue(fs::FS& fs, AppState& appState, uint32_t& outResumeFilePos) {
+  outResumeFilePos = 0;
+  if (!g_loaded) return false;
+  int songIndex = g_saved.songIndex < appState.libraryCount ? g_saved.songIndex : -1;
+  if (!FileManager::buildQueueForDirectory(fs, appState, g_savedDir.c_str(), songIndex)) return false;
+  if (songIndex < 0 || appState.playbackQueue[appState.currentSelectedIndex] != songIndex) return true;
+  String path;
+  if (FileManager::getPathByQueueIndex(fs, appState, appState.currentSelectedIndex, path) &&
+      fnv1a32(path.c_str()) == g_saved.trackHash) {
+    outResumeFilePos = g_saved.filePos;
+  } else {
+    LOG_PRINTLN("Session: index changed, starting the saved queue from its first track");
+    appState.currentSelectedIndex = 0;
+    appState.currentPlayingIndex = 0;
+  }
+  return true;
+}
+
+void update(const AppState& appState) {
+  if (appState.fileCount <= 0 || AudioManager::getTrackHash() == 0) return;  // Nothing opened yet
+  uint32_t now = millis();
+  Record cur = capture(appState);
+  // While paused the position only moves by seeking, so it is saved like a setting
+  bool paused = !appState.isPlaying || appState.stopped;
+  if (!sameSettings(cur, g_pending) || appState.queueDirectory != g_pendingDir ||
+      (paused && cur.filePos != g_pending.filePos)) {
+    g_pending = cur;
+    g_pendingDir = appState.queueDirectory;
+    g_changedMs = now;
+  }
+  // An NVS write stalls the flash cache on both cores, which a small DMA (low latency, or
+  // auto before it grew) may not cover while playing; hold everything until a pause
+  if (!paused) {
+    OutputMonitor::Stats out;
+    OutputMonitor::read(out);
+    if (out.capacityMs < SESSION_MIN_DMA_MS) return;
+  }
+  bool dirty = !sameSettings(g_pending, g_saved) || g_pendingDir != g_savedDir ||
+               (paused && g_pending.filePos != g_saved.filePos);
+  if (dirty) {
+    if (now - g_changedMs >= SESSION_SAVE_DELAY_MS) write(cur, appState.queueDirectory);
+  } else if (!paused && cur.filePos != g_saved.filePos && now - g_lastWriteMs >= SESSION_POSITION_INTERVAL_MS) {
+    write(cur, appState.queueDirectory);
+  }
+}
+
+}  // namespace Session
@@ -0,0 +1,131 @@
+#include "../include/storage.hpp"
+#include "../include/config.hpp"
+#include <SPI.h>
+#include <SD.h>
+#if STORAGE_USE_SDMMC
+#include <SD_MMC.h>
+#endif
+#include <esp_rom_crc.h>
+
+namespace Storage {
+
+namespace {
+
+Info g_info;
+
+#if !STORAGE_USE_SDMMC
+bool mountSpi(uint32_t hz) {
+  SD.end();
+  return SD.begin(CARDPUTER_SD_CS, SPI, hz);
+}
+
+// CRC of the first SD_CLOCK_PROBE_SECTORS raw sectors; false on any read error
+bool probeSectors(uint32_t& crc, uint32_t& elapsedUs) {
+  uint8_t sector[512];
+  crc = 0;
+  uint32_t t0 = micros();
+  for (uint32_t i = 0; i < SD_CLOCK_PROBE_SECTORS; ++i) {
+    if (!SD.readRAW(sector, i)) return false;
+    crc = esp_rom_crc32_le(crc, sector, sizeof(sector));
+  }
+  elapsedUs = micros() - t0;
+  return true;
+}
+
+uint32_t kbPerSec(uint32_t elapsedUs) {
+  if (elapsedUs == 0) return 0;
+  return (uint32_t)((uint64_t)SD_CLOCK_PROBE_SECTORS * 512 * 1000000 / 1024 / elapsedUs);
+}
+
+bool beginSpi() {
+  SPI.begin(CARDPUTER_SD_SCK, CARDPUTER_SD_MISO, CARDPUTER_SD_MOSI);
+  g_info.bus = Bus::Spi;
+
+#if SD_CLOCK_AUTOTUNE
+  uint32_t reference = 0, elapsed = 0;
+  if (!mountSpi(SD_SPI_CLOCK_SAFE_HZ) || !probeSectors(reference, elapsed)) {
+    // Unreadable raw sectors only rule out tuning, not the mount itself
+    g_info.clockHz = SD_SPI_CLOCK_SAFE_HZ;
+    g_info.mounted = mountSpi(SD_SPI_CLOCK_SAFE_HZ);
+    return g_info.mounted;
+  }
+  for (uint32_t hz : SD_SPI_CLOCK_CANDIDATES) {
+    if (!mountSpi(hz)) {
+      LOG_PRINTF("Storage: %u kHz mount failed\n", (unsigned)(hz / 1000));
+      continue;
+    }
+    bool stable = true;
+    uint32_t worstUs = 0;
+    for (int pass = 0; pass < SD_CLOCK_PROBE_PASSES && stable; ++pass) {
+      uint32_t crc = 0;
+      stable = probeSectors(crc, elapsed) && crc == reference;
+      if (elapsed > worstUs) worstUs = elapsed;
+    }
+    if (stable) {
+      g_info.clockHz = hz;
+      g_info.probeKBps = kbPerSec(worstUs);
+      g_info.mounted = true;
+      return true;
+    }
+    LOG_PRINTF("Storage: %u kHz read back mismatch\n", (unsigned)(hz / 1000));
+  }
+  g_info.clockHz = SD_SPI_CLOCK_SAFE_HZ;
+  g_info.mounted = mountSpi(SD_SPI_CLOCK_SAFE_HZ);
+#else
+  g_info.clockHz = SD_SPI_CLOCK_HZ;
+  g_info.mounted = mountSpi(SD_SPI_CLOCK_HZ);
+#endif
+  return g_info.mounted;
+}
+#else
+bool beginMmc() {
+  g_info.bus = Bus::Mmc1Bit;
+  // D3 doubles as the SPI chip select; held high it keeps the card in SD mode
+  pinMode(CARDPUTER_SD_CS, OUTPUT);
+  digitalWrite(CARDPUTER_SD_CS, HIGH);
+  if (!SD_MMC.setPins(CARDPUTER_SD_SCK, CARDPUTER_SD_MOSI, CARDPUTER_SD_MISO)) return false;
+  static const int kFreqKHz[] = {SDMMC_FREQ_HIGHSPEED, SDMMC_FREQ_DEFAULT};
+  for (int khz : kFreqKHz) {
+    if (SD_MMC.begin("/sdcard", true, false, khz)) {
+      g_info.clockHz = (uint32_t)khz * 1000;
+      g_info.mounted = true;
+      return true;
+    }
+    SD_MMC.end();
+  }
+  return false;
+}
+#endif
+
+}  // namespace
+
+bool begin() {
+#if STORAGE_USE_SDMMC
+  bool ok = beginMmc();
+#else
+  bool ok = beginSpi();
+#endif
+  if (ok) {
+    LOG_PRINTF("Storage: %s at %u kHz", g_info.bus == Bus::Spi ? "SPI" : "SD_MMC 1-bit",
+               (unsigned)(g_info.clockHz / 1000));
+    if (g_info.probeKBps) LOG_PRINTF(", raw read %u KB/s", (unsigned)g_info.probeKBps);
+    LOG_PRINTLN();
+  } else {
+    LOG_PRINTLN(F("ERROR: SD Mount Failed!"));
+  }
+  return ok;
+}
+
+fs::FS& fs() {
+#if STORAGE_USE_SDMMC
+  return SD_MMC;
+#else
+  return SD;
+#endif
+}
+
+const Info& info() {
+  return g_info;
+}
+
+}  // namespace Storage
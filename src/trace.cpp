@@ -0,0 +1,60 @@
+#include "../include/trace.hpp"
+
+#if ENABLE_TRACE
+
+#include <atomic>
+#include <esp_timer.h>
+
+namespace Trace {
+
+namespace {
+
+// 12 bytes. The time is the systimer in microseconds rather than CCOUNT: the cycle
+// counters of the two cores are not in step and change rate with the CPU clock.
+struct Record {
+  uint32_t us;
+  uint8_t event;
+  uint8_t phase;
+  uint8_t core;
+  uint8_t reserved;
+  uint32_t arg;
+};
+
+static_assert((TRACE_RING_EVENTS & (TRACE_RING_EVENTS - 1)) == 0, "TRACE_RING_EVENTS must be a power of two");
+
+Record g_ring[TRACE_RING_EVENTS];
+std::atomic<uint32_t> g_next{0};      // Total records claimed; slot = g_next % size
+std::atomic<bool> g_paused{false};
+
+}  // namespace
+
+void record(uint8_t event, uint8_t phase, uint32_t arg) {
+  if (g_paused.load(std::memory_order_relaxed)) return;
+  uint32_t n = g_next.fetch_add(1, std::memory_order_relaxed);
+  Record& r = g_ring[n & (TRACE_RING_EVENTS - 1)];
+  r.us = (uint32_t)esp_timer_get_time();
+  r.event = event;
+  r.phase = phase;
+  r.core = (uint8_t)xPortGetCoreID();
+  r.arg = arg;
+}
+
+void dump() {
+  g_paused.store(true);
+  vTaskDelay(1);  // Let a writer that already claimed a slot finish it
+  uint32_t next = g_next.load();
+  uint32_t count = next < (uint32_t)TRACE_RING_EVENTS ? next : (uint32_t)TRACE_RING_EVENTS;
+  Serial.printf("TRACE,begin,%lu,%lu\n", (unsigned long)count, (unsigned long)(next - count));
+  for (uint32_t i = next - count; i != next; ++i) {
+    const Record& r = g_ring[i & (TRACE_RING_EVENTS - 1)];
+    Serial.printf("T,%lu,%u,%u,%u,%lu\n", (unsigned long)r.us, (unsigned)r.core, (unsigned)r.event,
+                  (unsigned)r.phase, (unsigned long)r.arg);
+  }
+  Serial.println("TRACE,end");
+  g_next.store(0);
+  g_paused.store(false);
+}
+
+}  // namespace Trace
+
+#endif  // ENABLE_TRACE
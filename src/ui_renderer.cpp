@@ -4,13 +4,25 @@
 #include "../include/ui_renderer.hpp"
 #include "../include/config.hpp"
 #include "../include/image_utils.hpp"
+#include "../include/cover_cache.hpp"
+#include "../include/glyph_cache.hpp"
+#include "../include/marquee_strip.hpp"
 #include "../include/audio_manager.hpp"
 #include "../include/file_manager.hpp"
+#include "../include/storage.hpp"
+#include "../include/diagnostics.hpp"
+#include "../include/output_monitor.hpp"
+#include "../include/power_manager.hpp"
+#include "../include/trace.hpp"
 #include <ESP32Time.h>
 #include "font.h"
 
 namespace UiRenderer {
 
+// Pre-rendered scrolling lines (selected list row, ID3 album)
+static MarqueeStrip g_listMarquee;
+static MarqueeStrip g_albumMarquee;
+
 // Helper function to extract display name from full file path
 static String extractDisplayName(const String& fullPath) {
   String fileName = fullPath;
@@ -27,7 +39,7 @@ static String extractDisplayName(const String& fullPath) {
 
 static String getDisplayNameByQueueIndex(AppState& appState, int queueIndex) {
   String path;
-  if (!FileManager::getPathByQueueIndex(SD, appState, queueIndex, path)) {
+  if (!FileManager::getPathByQueueIndex(Storage::fs(), appState, queueIndex, path)) {
     return String("[Missing]");
   }
   return extractDisplayName(path);
@@ -43,15 +55,49 @@ static bool isDirectoryEntry(const AppState& appState, int listIndex) {
   return appState.browserEntryIsDir[listIndex];
 }
 
+// Draw text with the detected CJK font through the glyph cache, or with the
+// default font when none is needed. Honours the sprite's current text datum.
+static void drawLocalizedString(M5Canvas& sprite, const String& text, const lgfx::U8g2font* font,
+                                int32_t x, int32_t y, uint16_t fg, uint16_t bg) {
+  if (font) {
+    GlyphCache::drawText(sprite, text.c_str(), font, x, y, fg, bg);
+  } else {
+    sprite.setTextFont(0);
+    sprite.setTextColor(fg, bg);
+    sprite.drawString(text, x, y);
+  }
+}
+
+static int32_t localizedTextWidth(M5Canvas& sprite, const String& text, const lgfx::U8g2font* font) {
+  if (font) return GlyphCache::textWidth(text.c_str(), font);
+  sprite.setTextFont(0);
+  return sprite.textWidth(text);
+}
+
+// Duration of the playing track: the indexed value when known, else the decoder's estimate
+static uint32_t getPlayingDuration(const AppState& appState) {
+  uint32_t duration = FileManager::getDurationByQueueIndex(appState, appState.currentPlayingIndex);
+  return duration > 0 ? duration : AudioManager::getFileDuration();
+}
+
+// "2h14m" for an hour or more, otherwise "14:05"
+static void formatDuration(uint32_t sec, char* out, size_t outLen) {
+  if (sec >= 3600) {
+    snprintf(out, outLen, "%luh%02lum", (unsigned long)(sec / 3600), (unsigned long)((sec / 60) % 60));
+  } else {
+    snprintf(out, outLen, "%02lu:%02lu", (unsigned long)(sec / 60), (unsigned long)(sec % 60));
+  }
+}
+
 static String getDisplayNameByListIndex(AppState& appState, int listIndex) {
   if (appState.browserMode) {
     if (listIndex < 0 || listIndex >= appState.browserEntryCount) return String("");
-    String name = appState.browserEntryName[listIndex];
+    StrView name = appState.browserName(listIndex);
     if (appState.browserEntryIsDir[listIndex]) {
       if (name == "..") return "[..]";
-      return String("[") + name + "]";
+      return String("[") + name.c_str() + "]";
     }
-    return name;
+    return name.toString();
   }
   return getDisplayNameByQueueIndex(appState, listIndex);
 }
@@ -66,123 +112,20 @@ void drawId3Page(M5Canvas& sprite,
   const int coverW = COVER_WIDTH;
   const int coverH = COVER_HEIGHT;
   
-  // Make local copies to avoid race conditions with Task_Audio
-  // Task_Audio may free id3CoverBuf or change currentPlayingIndex while we're rendering
-  uint8_t* localCoverBuf = appState.id3CoverBuf;
-  size_t localCoverSize = appState.id3CoverSize;
-  size_t localCoverPos = appState.id3CoverPos;
-  size_t localCoverLen = appState.id3CoverLen;
-  int localPlayingIndex = appState.currentPlayingIndex;
-  
-  // Double-check: verify the buffer is still valid (pointer hasn't changed)
-  // This helps catch cases where Task_Audio freed and reallocated the buffer
-  if (localCoverBuf && localCoverSize > 0 && appState.id3CoverBuf == localCoverBuf && appState.id3CoverSize == localCoverSize) {
-    bool isJpeg = (localCoverSize >= 2 && localCoverBuf[0] == 0xFF && localCoverBuf[1] == 0xD8);
-    bool isPng  = (localCoverSize >= 8 && localCoverBuf[0] == 0x89 && localCoverBuf[1] == 0x50 && localCoverBuf[2] == 0x4E && localCoverBuf[3] == 0x47);
-    
-    if (isJpeg || isPng) {
-      // Get image dimensions and calculate proper scale
-      ImageFormat fmt = isJpeg ? ImageFormat::JPEG : ImageFormat::PNG;
-      uint32_t imgW = 0, imgH = 0;
-      float scaleX = 1.0f;
-      float scaleY = 0.0f;  // 0.0 means follow scaleX (maintain aspect ratio)
-      
-      if (getImageSizeFromBuffer(localCoverBuf, localCoverSize, fmt, imgW, imgH) && imgW > 0 && imgH > 0) {
-        float sx = (float)coverW / (float)imgW;
-        float sy = (float)coverH / (float)imgH;
-        scaleX = sx < sy ? sx : sy;  // Use smaller scale to fit both dimensions
-        if (scaleX <= 0.0f || scaleX > 1.0f) scaleX = 1.0f;
-      } else {
-        // If we can't get dimensions, use fit-to-size mode (scale = 0 means fit)
-        scaleX = 0.0f;
-      }
-      
-      // M5GFX drawJpg/drawPng from buffer support scale parameters directly!
-      if (isJpeg) {
-        sprite.drawJpg(localCoverBuf, localCoverSize, coverX, coverY, coverW, coverH, 0, 0, scaleX, scaleY);
-      } else {
-        sprite.drawPng(localCoverBuf, localCoverSize, coverX, coverY, coverW, coverH, 0, 0, scaleX, scaleY);
-      }
-    } else {
-      sprite.fillRect(coverX, coverY, coverW, coverH, grays[4]);
-      sprite.drawRect(coverX, coverY, coverW, coverH, grays[10]);
-      sprite.setTextColor(grays[14], grays[4]);
-      sprite.setTextDatum(4);
-      sprite.drawString(PLACEHOLDER_NO_COVER, coverX + coverW/2, coverY + coverH/2);
-      sprite.setTextDatum(0);
-    }
-  } else if (localCoverSize == 0 && localCoverPos > 0) {
-    // Check if playing index is valid before accessing queue entry
-    // Also verify index hasn't changed (race condition protection)
-    if (localPlayingIndex < 0 || localPlayingIndex >= appState.fileCount || 
-        appState.currentPlayingIndex != localPlayingIndex) {
-      sprite.fillRect(coverX, coverY, coverW, coverH, grays[4]);
-      sprite.drawRect(coverX, coverY, coverW, coverH, grays[10]);
-      return;  // Early return to avoid array out of bounds or stale data
-    }
-    
-    String playingPath;
-    if (FileManager::getPathByQueueIndex(SD, appState, localPlayingIndex, playingPath)) {
-      File f = SD.open(playingPath);
-      if (f) {
-        if (f.seek(localCoverPos)) {
-          const size_t scanMax = (localCoverLen > 0 && localCoverLen < COVER_SCAN_MAX) ? localCoverLen : (size_t)COVER_SCAN_MAX;
-          size_t startOff = 0;
-          ImageFormat fmt = ImageFormat::Unknown;
-          findImageStart(f, scanMax, startOff, fmt);
-          uint32_t imgW = 0, imgH = 0;
-          bool gotSize = getImageSize(f, localCoverPos + startOff, fmt, imgW, imgH);
-          f.seek(localCoverPos + startOff);
-          if (fmt != ImageFormat::Unknown) {
-            float scaleX = 1.0f;
-            float scaleY = 0.0f;  // 0.0 means follow scaleX (maintain aspect ratio)
-
-            if (gotSize && imgW > 0 && imgH > 0) {
-              float sx = (float)coverW / (float)imgW;
-              float sy = (float)coverH / (float)imgH;
-              scaleX = sx < sy ? sx : sy;  // Use smaller scale to fit both dimensions
-              if (scaleX <= 0.0f || scaleX > 1.0f) scaleX = 1.0f;
-            } else {
-              // If we can't get dimensions, use fit-to-size mode (scale = 0 means fit)
-              scaleX = 0.0f;
-            }
-
-            if (fmt == ImageFormat::JPEG) {
-              sprite.drawJpg(&f, coverX, coverY, coverW, coverH, 0, 0, scaleX, scaleY);
-            } else if (fmt == ImageFormat::PNG) {
-              sprite.drawPng(&f, coverX, coverY, coverW, coverH, 0, 0, scaleX, scaleY);
-            } else if (fmt == ImageFormat::BMP) {
-              sprite.drawBmp(&f, coverX, coverY, coverW, coverH, 0, 0, scaleX, scaleY);
-            } else if (fmt == ImageFormat::QOI) {
-              sprite.drawQoi(&f, coverX, coverY, coverW, coverH, 0, 0, scaleX, scaleY);
-            }
-          } else {
-            sprite.fillRect(coverX, coverY, coverW, coverH, grays[4]);
-            sprite.drawRect(coverX, coverY, coverW, coverH, grays[10]);
-            sprite.setTextColor(grays[14], grays[4]);
-            sprite.setTextDatum(4);
-            sprite.drawString(PLACEHOLDER_NO_COVER, coverX + coverW/2, coverY + coverH/2);
-            sprite.setTextDatum(0);
-          }
-        } else {
-          sprite.fillRect(coverX, coverY, coverW, coverH, grays[4]);
-          sprite.drawRect(coverX, coverY, coverW, coverH, grays[10]);
-        }
-        f.close();
-      } else {
-        sprite.fillRect(coverX, coverY, coverW, coverH, grays[4]);
-        sprite.drawRect(coverX, coverY, coverW, coverH, grays[10]);
-      }
-    } else {
-      sprite.fillRect(coverX, coverY, coverW, coverH, grays[4]);
-      sprite.drawRect(coverX, coverY, coverW, coverH, grays[10]);
-    }
+  // Covers are decoded by the CoverCache worker; the renderer only blits the thumbnail
+  // named by this frame's now-playing record, so a track change never shows a stale decode.
+  const uint16_t* thumb = nullptr;
+  CoverCache::State coverState = CoverCache::acquire(AudioManager::nowPlaying().coverKey, thumb);
+  if (coverState == CoverCache::State::Ready) {
+    sprite.pushImage(coverX, coverY, coverW, coverH, reinterpret_cast<const lgfx::swap565_t*>(thumb));
+    CoverCache::release();
   } else {
     sprite.fillRect(coverX, coverY, coverW, coverH, grays[4]);
     sprite.drawRect(coverX, coverY, coverW, coverH, grays[10]);
     sprite.setTextColor(grays[14], grays[4]);
     sprite.setTextDatum(4);
-    sprite.drawString(PLACEHOLDER_NO_COVER, coverX + coverW/2, coverY + coverH/2);
+    sprite.drawString(coverState == CoverCache::State::Loading ? PLACEHOLDER_LOADING_COVER : PLACEHOLDER_NO_COVER,
+                      coverX + coverW/2, coverY + coverH/2);
     sprite.setTextDatum(0);
   }
 
@@ -199,7 +142,7 @@ void drawId3Page(M5Canvas& sprite,
   
   sprite.fillRect(coverX, clipY, coverW, clipH, BLACK);
   sprite.setTextColor(WHITE, BLACK);
-  int16_t tw = sprite.textWidth(appState.id3Album);
+  int32_t tw = localizedTextWidth(sprite, appState.id3Album, albumFont);
   int clipW = coverW;
   // Only scroll if text width is greater than available width
   if (tw > clipW) {
@@ -208,14 +151,15 @@ void drawId3Page(M5Canvas& sprite,
       appState.id3AlbumScrollPos -= SCROLL_STEP;
       if (appState.id3AlbumScrollPos + tw < 0) appState.id3AlbumScrollPos = clipW;
     }
+    g_albumMarquee.prepare(appState.id3Album, albumFont, WHITE, BLACK);
     sprite.setClipRect(coverX, clipY, clipW, clipH);
-    sprite.drawString(appState.id3Album, coverX + appState.id3AlbumScrollPos, albumY);
+    g_albumMarquee.draw(sprite, coverX + appState.id3AlbumScrollPos, albumY);
     sprite.clearClipRect();
   } else {
     // Reset scroll position when text fits
     appState.id3AlbumScrollPos = 0;
     String albumDraw = appState.id3Album.length() ? appState.id3Album : String(PLACEHOLDER_UNKNOWN_ALBUM);
-    sprite.drawString(albumDraw, coverX, albumY);
+    drawLocalizedString(sprite, albumDraw, albumFont, coverX, albumY, WHITE, BLACK);
   }
 
   sprite.setTextFont(0);
@@ -228,7 +172,7 @@ void drawId3Page(M5Canvas& sprite,
     int32_t fontH = sprite.fontHeight();
     int artistY = COVER_Y + fontH;  // Align text top with cover top
     String artistDraw = appState.id3Artist.length() ? appState.id3Artist : String(PLACEHOLDER_UNKNOWN_ARTIST);
-    sprite.drawString(artistDraw, ARTIST_X, artistY);
+    drawLocalizedString(sprite, artistDraw, artistFont, ARTIST_X, artistY, WHITE, BLACK);
     
     // Calculate title Y position: below artist with spacing
     int titleY = artistY + fontH + 2;  // 2px spacing below artist
@@ -236,8 +180,7 @@ void drawId3Page(M5Canvas& sprite,
     if (appState.id3Title.length() > 0) {
       const lgfx::U8g2font* titleFont = detectAndGetFont(appState.id3Title);
       if (titleFont) sprite.setFont(titleFont); else sprite.setTextFont(0);
-      sprite.setTextColor(grays[2], BLACK);
-      sprite.drawString(appState.id3Title, TITLE_X, titleY);
+      drawLocalizedString(sprite, appState.id3Title, titleFont, TITLE_X, titleY, grays[2], BLACK);
       
       // Calculate ContentType Y position: below title with spacing
       int32_t titleFontH = sprite.fontHeight();
@@ -262,10 +205,14 @@ void drawId3Page(M5Canvas& sprite,
   // Display current playback time (smaller font, centered in right area, above icons)
   if (appState.isPlaying && !appState.stopped) {
     uint32_t currentTime = AudioManager::getCurrentTime();
-    uint32_t minutes = currentTime / 60;
-    uint32_t seconds = currentTime % 60;
-    char timeStr[6];
-    snprintf(timeStr, sizeof(timeStr), "%02lu:%02lu", (unsigned long)minutes, (unsigned long)seconds);
+    uint32_t duration = getPlayingDuration(appState);
+    char timeStr[24];
+    formatDuration(currentTime, timeStr, sizeof(timeStr));
+    if (duration > 0) {
+      size_t len = strlen(timeStr);
+      timeStr[len++] = '/';
+      formatDuration(duration, timeStr + len, sizeof(timeStr) - len);
+    }
     
     sprite.setTextFont(0);  // Use default font (smaller than DSEG7)
     sprite.setTextColor(GREEN, BLACK);
@@ -333,7 +280,7 @@ void drawId3Page(M5Canvas& sprite,
   // Draw progress bar at bottom of screen
   if (appState.isPlaying && !appState.stopped) {
     uint32_t currentTime = AudioManager::getCurrentTime();
-    uint32_t duration = AudioManager::getFileDuration();
+    uint32_t duration = getPlayingDuration(appState);
     if (duration > 0) {
       int progressWidth = (int)((float)currentTime / (float)duration * SCREEN_WIDTH);
       if (progressWidth > SCREEN_WIDTH) progressWidth = SCREEN_WIDTH;
@@ -343,7 +290,9 @@ void drawId3Page(M5Canvas& sprite,
     }
   }
   
+  TRACE_BEGIN(UiPush, 0);
   sprite.pushSprite(0, 0);
+  TRACE_END(UiPush, 0);
 }
 
 void drawMainView(M5Canvas& sprite,
@@ -431,92 +380,45 @@ void drawMainView(M5Canvas& sprite,
     }
     
     sprite.setTextDatum(0);
-    if (appState.currentSelectedIndex < LIST_SCROLL_THRESHOLD)
-      for (int i = 0; i < LIST_VISIBLE_LINES; i++) {
-        if (i < listCount) {
-          if (!appState.browserMode && i == appState.currentPlayingIndex) {
-            sprite.setTextColor(RED, BLACK);
-          } else if (i == appState.currentSelectedIndex) {
-            sprite.setTextColor(WHITE, BLACK);
-          } else if (isDirectoryEntry(appState, i)) {
-            sprite.setTextColor(YELLOW, BLACK);
-          } else {
-            sprite.setTextColor(GREEN, BLACK);
-          }
-          String fileName = getDisplayNameByListIndex(appState, i);
-          const lgfx::U8g2font* detectedFont = detectAndGetFont(fileName);
-          if (detectedFont) {
-            sprite.setFont(detectedFont);
-          } else {
-            sprite.setTextFont(0);
-          }
-          if (i == appState.currentSelectedIndex && (now - appState.selectedTime >= SELECTED_SCROLL_DELAY)) {
-            if (appState.graphSpeed == 0) {
-              appState.selectedScrollPos = appState.selectedScrollPos - SCROLL_STEP;
-              int textWidth = fileName.length() * TEXT_WIDTH_ESTIMATE_PX;
-              if (appState.selectedScrollPos + textWidth < TEXT_LEFT) {
-                appState.selectedScrollPos = TEXT_RIGHT;
-              }
-              if (appState.selectedScrollPos > TEXT_RIGHT) {
-                appState.selectedScrollPos = TEXT_RIGHT;
-              }
-            }
-            sprite.setClipRect(LIST_BOX_X, LIST_BOX_Y, LIST_BOX_WIDTH, LIST_BOX_HEIGHT);
-            sprite.drawString(fileName, appState.selectedScrollPos, LIST_TEXT_START_Y + (i * LIST_LINE_HEIGHT));
-            sprite.clearClipRect();
-          } else {
-            String displayName = fileName;
-            if (displayName.length() > FILENAME_DISPLAY_MAX_LENGTH) {
-              displayName = displayName.substring(0, FILENAME_DISPLAY_MAX_LENGTH);
-            }
-            sprite.drawString(displayName, LIST_TEXT_START_X, LIST_TEXT_START_Y + (i * LIST_LINE_HEIGHT));
-          }
-        }
+    // Window of visible rows: the selection stays on the 4th row once past the threshold
+    int firstRow = appState.currentSelectedIndex < LIST_SCROLL_THRESHOLD ? 0 : appState.currentSelectedIndex - LIST_SCROLL_THRESHOLD;
+    for (int row = 0; row < LIST_VISIBLE_LINES; row++) {
+      int i = firstRow + row;
+      if (i >= listCount) break;
+      uint16_t rowColor = GREEN;
+      if (!appState.browserMode && i == appState.currentPlayingIndex) {
+        rowColor = RED;
+      } else if (i == appState.currentSelectedIndex) {
+        rowColor = WHITE;
+      } else if (isDirectoryEntry(appState, i)) {
+        rowColor = YELLOW;
       }
-    int yos = 0;
-    if (appState.currentSelectedIndex >= 3)
-      for (int i = appState.currentSelectedIndex - 3; i < appState.currentSelectedIndex - 3 + 7; i++) {
-        if (i < listCount) {
-          if (!appState.browserMode && i == appState.currentPlayingIndex) {
-            sprite.setTextColor(RED, BLACK);
-          } else if (i == appState.currentSelectedIndex) {
-            sprite.setTextColor(WHITE, BLACK);
-          } else if (isDirectoryEntry(appState, i)) {
-            sprite.setTextColor(YELLOW, BLACK);
-          } else {
-            sprite.setTextColor(GREEN, BLACK);
-          }
-          String fileName = getDisplayNameByListIndex(appState, i);
-          const lgfx::U8g2font* detectedFont = detectAndGetFont(fileName);
-          if (detectedFont) {
-            sprite.setFont(detectedFont);
-          } else {
-            sprite.setTextFont(0);
+      String fileName = getDisplayNameByListIndex(appState, i);
+      const lgfx::U8g2font* detectedFont = detectAndGetFont(fileName);
+      const int rowY = LIST_TEXT_START_Y + (row * LIST_LINE_HEIGHT);
+      if (i == appState.currentSelectedIndex && (now - appState.selectedTime >= SELECTED_SCROLL_DELAY)) {
+        // Rendered into the strip once per selection; each frame only copies the visible window
+        int32_t textWidth = g_listMarquee.prepare(fileName, detectedFont, rowColor, BLACK);
+        if (appState.graphSpeed == 0) {
+          appState.selectedScrollPos = appState.selectedScrollPos - SCROLL_STEP;
+          if (appState.selectedScrollPos + textWidth < TEXT_LEFT) {
+            appState.selectedScrollPos = TEXT_RIGHT;
           }
-          if (i == appState.currentSelectedIndex && (now - appState.selectedTime >= SELECTED_SCROLL_DELAY)) {
-            if (appState.graphSpeed == 0) {
-              appState.selectedScrollPos = appState.selectedScrollPos - SCROLL_STEP;
-              int textWidth = fileName.length() * TEXT_WIDTH_ESTIMATE_PX;
-              if (appState.selectedScrollPos + textWidth < TEXT_LEFT) {
-                appState.selectedScrollPos = TEXT_RIGHT;
-              }
-              if (appState.selectedScrollPos > TEXT_RIGHT) {
-                appState.selectedScrollPos = TEXT_RIGHT;
-              }
-            }
-            sprite.setClipRect(LIST_BOX_X, LIST_BOX_Y, LIST_BOX_WIDTH, LIST_BOX_HEIGHT);
-            sprite.drawString(fileName, appState.selectedScrollPos, LIST_TEXT_START_Y + (yos * LIST_LINE_HEIGHT));
-            sprite.clearClipRect();
-          } else {
-            String displayName = fileName;
-            if (displayName.length() > FILENAME_DISPLAY_MAX_LENGTH) {
-              displayName = displayName.substring(0, FILENAME_DISPLAY_MAX_LENGTH);
-            }
-            sprite.drawString(displayName, 8, 10 + (yos * 16));
+          if (appState.selectedScrollPos > TEXT_RIGHT) {
+            appState.selectedScrollPos = TEXT_RIGHT;
           }
         }
-        yos++;
+        sprite.setClipRect(LIST_BOX_X, LIST_BOX_Y, LIST_BOX_WIDTH, LIST_BOX_HEIGHT);
+        g_listMarquee.draw(sprite, appState.selectedScrollPos, rowY);
+        sprite.clearClipRect();
+      } else {
+        String displayName = fileName;
+        if (displayName.length() > FILENAME_DISPLAY_MAX_LENGTH) {
+          displayName = displayName.substring(0, FILENAME_DISPLAY_MAX_LENGTH);
+        }
+        drawLocalizedString(sprite, displayName, detectedFont, LIST_TEXT_START_X, rowY, rowColor, BLACK);
       }
+    }
     sprite.setTextFont(0);
     sprite.setTextColor(grays[1], gray);
     sprite.drawString("WINAMP", 150, 4);
@@ -525,6 +427,8 @@ void drawMainView(M5Canvas& sprite,
       String dirLabel = appState.browserCurrentDir;
       if (dirLabel.length() > 18) dirLabel = "..." + dirLabel.substring(dirLabel.length() - 15);
       sprite.drawString(dirLabel, 6, 0);
+    } else if (appState.cachedQueueTimeStr.length() > 0) {
+      sprite.drawString(String("LIST ") + appState.cachedQueueTimeStr, 58, 0);
     } else {
       sprite.drawString("LIST", 58, 0);
     }
@@ -550,6 +454,14 @@ void drawMainView(M5Canvas& sprite,
       if (now - appState.lastTimeUpdate >= TIME_UPDATE_INTERVAL) {
         appState.cachedTimeStr = rtc.getTime().substring(3, 8);
         appState.lastTimeUpdate = now;
+        // Rest of the playing track plus everything after it in queue order
+        uint32_t played = AudioManager::getCurrentTime();
+        uint32_t current = getPlayingDuration(appState);
+        uint32_t remaining = (current > played ? current - played : 0) +
+                             FileManager::getQueueDurationFrom(appState, appState.currentPlayingIndex + 1);
+        char queueStr[12] = "";
+        if (remaining > 0) formatDuration(remaining, queueStr, sizeof(queueStr));
+        appState.cachedQueueTimeStr = queueStr;
       }
       sprite.drawString(appState.cachedTimeStr, 172, 18);
     }
@@ -592,7 +504,11 @@ void drawMainView(M5Canvas& sprite,
         // Optimized: use char buffer instead of String concatenation
         float sampleRateKHz = sampleRate / 1000.0f;
         char audioInfoStr[16];
-        if (sampleRateKHz == (int)sampleRateKHz) {
+        if (appState.playbackSpeedPct != 100) {
+          // Speed replaces the bit depth while it is not 1x
+          snprintf(audioInfoStr, sizeof(audioInfoStr), "%g %d.%02dx", sampleRateKHz,
+                   appState.playbackSpeedPct / 100, appState.playbackSpeedPct % 100);
+        } else if (sampleRateKHz == (int)sampleRateKHz) {
           // Integer kHz, no decimal needed
           snprintf(audioInfoStr, sizeof(audioInfoStr), "%d/%d", (int)sampleRateKHz, bitsPerSample);
         } else {
@@ -625,20 +541,106 @@ void drawMainView(M5Canvas& sprite,
           fileName = fileName.substring(0, FILENAME_DISPLAY_MAX_LENGTH);
         }
         const lgfx::U8g2font* detectedFont = detectAndGetFont(fileName);
-        if (detectedFont) {
-          sprite.setFont(detectedFont);
-        } else {
-          sprite.setTextFont(0);
-        }
-        sprite.drawString(fileName, 30, 57);
+        drawLocalizedString(sprite, fileName, detectedFont, 30, 57, WHITE, BLACK);
         sprite.setTextFont(0);
       }
       sprite.drawString("Y:Yes  C:Cancel", 30, 75);
     }
+    TRACE_BEGIN(UiPush, 0);
     sprite.pushSprite(0, 0);
+    TRACE_END(UiPush, 0);
   }
   appState.graphSpeed++;
   if (appState.graphSpeed == 4) appState.graphSpeed = 0;
 }
 
+void drawDiagnosticsPage(M5Canvas& sprite, const AppState& appState, const unsigned short* grays) {
+  const Diagnostics::Snapshot& d = Diagnostics::latest();
+  char line[48];
+  int y = 2;
+  sprite.fillRect(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT, BLACK);
+  sprite.setTextFont(0);
+  sprite.setTextDatum(0);
+
+  sprite.setTextColor(GREEN, BLACK);
+  snprintf(line, sizeof(line), "DIAG  up %lus  %luMHz", (unsigned long)(d.ms / 1000), (unsigned long)d.cpuMhz);
+  sprite.drawString(line, 4, y);
+  y += DIAG_LINE_HEIGHT + 2;
+
+  sprite.setTextColor(WHITE, BLACK);
+  snprintf(line, sizeof(line), "RAM   free %6lu  min %6lu", (unsigned long)d.internal.freeBytes,
+           (unsigned long)d.internal.minFreeBytes);
+  sprite.drawString(line, 4, y);
+  y += DIAG_LINE_HEIGHT;
+  snprintf(line, sizeof(line), "      big  %6lu  frag %2u%%  %lu blk", (unsigned long)d.internal.largestBlock,
+           (unsigned)d.internal.fragmentationPct, (unsigned long)d.internal.allocatedBlocks);
+  sprite.drawString(line, 4, y);
+  y += DIAG_LINE_HEIGHT;
+  if (d.psram.totalBytes > 0) {
+    snprintf(line, sizeof(line), "PSRAM free %6lu  big %6lu", (unsigned long)d.psram.freeBytes,
+             (unsigned long)d.psram.largestBlock);
+  } else {
+    snprintf(line, sizeof(line), "PSRAM none");
+  }
+  sprite.drawString(line, 4, y);
+  y += DIAG_LINE_HEIGHT + 2;
+
+  // Stack headroom: least free bytes ever, out of the stack size; red below 1 KB
+  sprite.setTextColor(grays[8], BLACK);
+  sprite.drawString("Stack free (min) / size", 4, y);
+  y += DIAG_LINE_HEIGHT;
+  for (int i = 0; i < d.taskCount; ++i) {
+    const Diagnostics::TaskStats& t = d.tasks[i];
+    snprintf(line, sizeof(line), "%-5s %5lu/%lu", t.name, (unsigned long)t.minFreeBytes, (unsigned long)t.stackBytes);
+    sprite.setTextColor(t.minFreeBytes < 1024 ? RED : WHITE, BLACK);
+    sprite.drawString(line, (i & 1) ? 122 : 4, y);
+    if (i & 1) y += DIAG_LINE_HEIGHT;
+  }
+  if (d.taskCount & 1) y += DIAG_LINE_HEIGHT;
+  y += 2;
+
+  // I2S output: latency mode and DMA size, depth now / lowest while playing, then dropouts
+  // with the task that held the audio core at the last one
+  OutputMonitor::Stats out;
+  OutputMonitor::read(out);
+  sprite.setTextColor(WHITE, BLACK);
+  static const char* const kLatency[] = {"bal", "low", "batt", "auto"};
+  snprintf(line, sizeof(line), "DMA %s %ux%u %lums now %lu",
+           appState.latencyMode < LATENCY_MODE_COUNT ? kLatency[appState.latencyMode] : "?",
+           (unsigned)out.dmaBufCount, (unsigned)out.dmaBufLen, (unsigned long)out.capacityMs,
+           (unsigned long)out.depthMs);
+  if (out.minDepthMs != UINT32_MAX) {
+    snprintf(line + strlen(line), sizeof(line) - strlen(line), " min %lu", (unsigned long)out.minDepthMs);
+  }
+  sprite.drawString(line, 4, y);
+  y += DIAG_LINE_HEIGHT;
+  sprite.setTextColor(out.underruns ? RED : (out.nearMisses ? ORANGE : WHITE), BLACK);
+  snprintf(line, sizeof(line), "Under %lu near %lu", (unsigned long)out.underruns, (unsigned long)out.nearMisses);
+  if (out.lastEventMs) {
+    snprintf(line + strlen(line), sizeof(line) - strlen(line), " %s %c %lus", out.lastTask, out.lastAudioState,
+             (unsigned long)((millis() - out.lastEventMs) / 1000));
+  }
+  sprite.drawString(line, 4, y);
+  y += DIAG_LINE_HEIGHT;
+
+  // Battery drain per CPU clock; "est" when derived from the voltage rather than the PMIC
+  const PowerManager::Report& power = PowerManager::report();
+  int n = snprintf(line, sizeof(line), "mA");
+  for (int i = 0; i < PowerManager::LevelCount; ++i) {
+    PowerManager::Level level = (PowerManager::Level)i;
+    if (power.drainMa[i] >= 0) {
+      n += snprintf(line + n, sizeof(line) - n, " %lu:%ld", (unsigned long)PowerManager::levelMhz(level),
+                    (long)power.drainMa[i]);
+    } else {
+      n += snprintf(line + n, sizeof(line) - n, " %lu:-", (unsigned long)PowerManager::levelMhz(level));
+    }
+  }
+  if (!power.measured) snprintf(line + n, sizeof(line) - n, " est");
+  sprite.setTextColor(grays[8], BLACK);
+  sprite.drawString(line, 4, y);
+  TRACE_BEGIN(UiPush, 0);
+  sprite.pushSprite(0, 0);
+  TRACE_END(UiPush, 0);
+}
+
 }  // namespace UiRenderer
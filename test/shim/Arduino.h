@@ -0,0 +1,11 @@
+// Host build of the plain C++ DSP blocks in lib/ESP32-audioI2S: only what they use from Arduino.h
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+using std::max;
+using std::min;
+#define PI 3.1415926535897932384626433832795
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
@@ -0,0 +1,4 @@
+// The library itself is ignored on the host (Audio.cpp needs the IDF); build its DSP blocks here
+#include "resampler/resampler.cpp"
+#include "timestretch/timestretch.cpp"
+#include "limiter/limiter.cpp"
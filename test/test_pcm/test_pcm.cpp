@@ -0,0 +1,366 @@
+// Host tests of the resampler, time stretcher, limiter, PCM volume scaling and the seek fade-in
+// (pio test -e native).
+// Sine tests report THD+N as what a least-squares sine fit leaves over, in dB below the sine.
+#include <unity.h>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+#include "resampler/resampler.h"
+#include "timestretch/timestretch.h"
+#include "limiter/limiter.h"
+#include "pcmscale/pcmscale.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double elapsedNs(Clock::time_point t0) {
+  return std::chrono::duration<double, std::nano>(Clock::now() - t0).count();
+}
+
+struct SineFit {
+  // Least squares fit of sine, cosine and offset at a known frequency
+  double S[3][3] = {}, Y[3] = {}, yy = 0, res = 0, sig = 0;
+  uint32_t n = 0;
+  void add(double phase, double y) {
+    double b[3] = {sin(phase), cos(phase), 1};
+    for (int i = 0; i < 3; i++) {
+      for (int j = 0; j < 3; j++) S[i][j] += b[i] * b[j];
+      Y[i] += b[i] * y;
+    }
+    yy += y * y;
+    n++;
+  }
+  // Ends a fit block; short blocks allow a slow phase drift
+  void close() {
+    if (n < 3) return;
+    double Y0[3] = {Y[0], Y[1], Y[2]};
+    for (int i = 0; i < 3; i++) {
+      for (int k = i + 1; k < 3; k++) {
+        double m = S[k][i] / S[i][i];
+        for (int j = i; j < 3; j++) S[k][j] -= m * S[i][j];
+        Y[k] -= m * Y[i];
+      }
+    }
+    double x[3];
+    for (int i = 2; i >= 0; i--) {
+      x[i] = Y[i];
+      for (int j = i + 1; j < 3; j++) x[i] -= S[i][j] * x[j];
+      x[i] /= S[i][i];
+    }
+    res += yy - (x[0] * Y0[0] + x[1] * Y0[1] + x[2] * Y0[2]);
+    sig += (x[0] * x[0] + x[1] * x[1]) / 2 * n;
+    memset(S, 0, sizeof(S));
+    memset(Y, 0, sizeof(Y));
+    yy = 0;
+    n = 0;
+  }
+  double thdnDb() {
+    close();
+    return (res > 0 && sig > 0) ? 10 * log10(res / sig) : -200;
+  }
+};
+
+int16_t sine16(double amplitude, double hz, uint32_t frame, uint32_t rate) {
+  return (int16_t)lrint(amplitude * sin(2 * PI * hz * (frame % rate) / rate));
+}
+
+// -1 dBFS 1 kHz sine, one second in 256-frame chunks; the first 100 ms of output are not fitted.
+// ns is the time spent in process()
+void runResampler(uint8_t quality, uint32_t inRate, uint32_t outRate, uint32_t& nOut, double& thdn, double& ns) {
+  Resampler rs;
+  TEST_ASSERT_TRUE(rs.setQuality(quality));
+  TEST_ASSERT_TRUE(rs.setRatio(inRate, outRate));
+  int16_t in[2 * 256], out[2 * 512];
+  SineFit fit;
+  nOut = 0;
+  ns = 0;
+  for (uint32_t base = 0; base < inRate; base += 256) {
+    size_t c = min((uint32_t)256, inRate - base);
+    for (size_t i = 0; i < c; i++) in[2 * i] = in[2 * i + 1] = sine16(29204, 1000, base + i, inRate);
+    size_t off = 0;
+    while (off < c) {
+      size_t used = 0;
+      Clock::time_point t0 = Clock::now();
+      size_t n = rs.process(in + 2 * off, c - off, &used, out, 512);
+      ns += elapsedNs(t0);
+      off += used;
+      for (size_t k = 0; k < n; k++, nOut++) {
+        TEST_ASSERT_EQUAL_INT16(out[2 * k], out[2 * k + 1]);
+        if (nOut >= outRate / 10) fit.add(2 * PI * 1000.0 * (nOut % outRate) / outRate, out[2 * k]);
+      }
+    }
+  }
+  thdn = fit.thdnDb();
+}
+
+// -6 dBFS 440 Hz sine at 44.1 kHz, two seconds; fitted in blocks of 2048 frames since the
+// splices may drift the phase slowly, the first 200 ms are not fitted. ns is the time spent in process()
+void runStretch(float speed, uint32_t& nIn, uint32_t& nOut, double& thdn, double& ns) {
+  const uint32_t rate = 44100;
+  TimeStretch ts;
+  TEST_ASSERT_TRUE(ts.setSampleRate(rate));
+  ts.setSpeed(speed);
+  int16_t in[2 * 256], out[2 * 512];
+  SineFit fit;
+  nIn = 2 * rate;
+  nOut = 0;
+  ns = 0;
+  for (uint32_t base = 0; base < nIn; base += 256) {
+    size_t c = min((uint32_t)256, nIn - base);
+    for (size_t i = 0; i < c; i++) in[2 * i] = in[2 * i + 1] = sine16(16384, 440, base + i, rate);
+    size_t off = 0;
+    while (off < c) {
+      size_t used = 0;
+      Clock::time_point t0 = Clock::now();
+      size_t n = ts.process(in + 2 * off, c - off, &used, out, 512);
+      ns += elapsedNs(t0);
+      off += used;
+      for (size_t k = 0; k < n; k++, nOut++) {
+        if (nOut < rate / 5) continue;
+        fit.add(2 * PI * 440.0 * (nOut % rate) / rate, out[2 * k]);
+        if (fit.n == 2048) fit.close();
+      }
+    }
+  }
+  thdn = fit.thdnDb();
+}
+
+const int32_t kFullScale = 32767 << 8;  // Q23
+
+// Worst-case limiter inputs, frame t of channel ch
+enum LimiterSignal { Square12dB, Impulse, AlternatingExtremes, Noise24dB, SilenceThenSine18dB, LimiterSignalCount };
+const char* const kLimiterSignalNames[] = {"square +12 dB", "impulse INT32_MAX", "INT32_MIN/MAX alternating",
+                                           "noise +24 dB", "silence -> sine +18 dB"};
+
+int32_t limiterInput(int sig, uint32_t t, int ch, uint32_t& noise) {
+  const uint32_t rate = 44100;
+  switch (sig) {
+    case Square12dB: return ((t / 50) & 1) ? 4 * kFullScale : -4 * kFullScale;
+    case Impulse: return (t % 1000 == 500) ? INT32_MAX : 0;
+    case AlternatingExtremes: return ((t + ch) & 1) ? INT32_MIN : INT32_MAX;
+    case Noise24dB:
+      noise ^= noise << 13;
+      noise ^= noise >> 17;
+      noise ^= noise << 5;
+      return (int32_t)(((int64_t)(int32_t)noise * 16 * kFullScale) >> 31);
+    default: return t < rate / 10 ? 0 : (int32_t)(8.0 * kFullScale * sin(2 * PI * 440.0 * t / rate));
+  }
+}
+
+// One second at 44.1 kHz in odd chunk sizes through one limiter; returns the output peak
+template <class Input, class Check>
+uint32_t runLimiter(Limiter& lim, Input input, Check check, uint32_t& nIn, uint32_t& nOut) {
+  static const size_t kChunks[] = {1, 7, 64, 100, 333};
+  int32_t in[2 * 333], out[2 * 64];
+  uint32_t peak = 0, k = 0;
+  nIn = nOut = 0;
+  while (nIn < 44100) {
+    size_t c = min(kChunks[k++ % 5], (size_t)(44100 - nIn));
+    for (size_t i = 0; i < c; i++) {
+      for (int ch = 0; ch < 2; ch++) in[2 * i + ch] = input(nIn + i, ch);
+    }
+    size_t off = 0;
+    while (off < c) {
+      size_t used = 0;
+      size_t n = lim.process(in + 2 * off, c - off, &used, out, 64);
+      off += used;
+      for (size_t i = 0; i < 2 * n; i++) {
+        uint32_t a = out[i] < 0 ? -(uint32_t)out[i] : (uint32_t)out[i];
+        if (a > peak) peak = a;
+        check(nOut + i / 2, out[i]);
+      }
+      nOut += n;
+    }
+    nIn += c;
+  }
+  return peak;
+}
+
+}  // namespace
+
+void setUp() {}
+void tearDown() {}
+
+void test_resampler_length_and_thdn() {
+  // THD+N bound per tier (FAST, BALANCED, BEST), both directions between 44.1 and 48 kHz.
+  // Measured -62/-77/-77 dB; BEST is held back by the Q14 coefficients, not the taps.
+  static const double kMaxThdnDb[] = {-57, -72, -72};
+  static const uint32_t kRates[][2] = {{44100, 48000}, {48000, 44100}};
+  for (uint8_t q = RESAMPLER_FAST; q <= RESAMPLER_BEST; q++) {
+    for (const auto& r : kRates) {
+      uint32_t nOut;
+      double thdn, ns;
+      runResampler(q, r[0], r[1], nOut, thdn, ns);
+      char msg[96];
+      snprintf(msg, sizeof(msg), "tier %u, %u -> %u Hz: %u frames, THD+N %.1f dB, %.1f ns/frame", q, r[0], r[1],
+               nOut, thdn, nOut ? ns / nOut : 0);
+      TEST_MESSAGE(msg);
+      // One second in; at most the filter delay (taps / 2 input frames) is still held back
+      TEST_ASSERT_UINT32_WITHIN_MESSAGE(RESAMPLER_MAX_TAPS, r[1], nOut, msg);
+      TEST_ASSERT_TRUE_MESSAGE(thdn < kMaxThdnDb[q], msg);
+    }
+  }
+}
+
+void test_resampler_same_rate_is_bypassed() {
+  // Unfiltered, but with the filter's delay of taps / 2 frames so switching is seamless
+  Resampler rs;
+  TEST_ASSERT_TRUE(rs.setQuality(RESAMPLER_BALANCED));
+  rs.setRatio(44100, 44100);
+  TEST_ASSERT_TRUE(rs.isBypassed());
+  const int delay = rs.getTaps() / 2;
+  int16_t in[2 * 100], out[2 * 100], expected[2 * 100] = {};
+  for (int i = 0; i < 2 * 100; i++) in[i] = (int16_t)(i * 311);
+  memcpy(expected + 2 * delay, in, (100 - delay) * 4);
+  size_t used = 0;
+  TEST_ASSERT_EQUAL_UINT32(100, rs.process(in, 100, &used, out, 100));
+  TEST_ASSERT_EQUAL_UINT32(100, used);
+  TEST_ASSERT_EQUAL_INT16_ARRAY(expected, out, 2 * 100);
+}
+
+void test_stretch_length_and_thdn() {
+  static const float kSpeeds[] = {0.5f, 0.75f, 1.25f, 1.5f, 2.0f};
+  static const double kMaxThdnDb[] = {-33, -38, -38, -33, -38};  // Measured -38.5/-43.6/-44.1/-38.6/-44.6 dB
+  for (size_t i = 0; i < sizeof(kSpeeds) / sizeof(kSpeeds[0]); i++) {
+    uint32_t nIn, nOut;
+    double thdn, ns;
+    runStretch(kSpeeds[i], nIn, nOut, thdn, ns);
+    double ratio = (double)nOut / nIn;
+    char msg[96];
+    snprintf(msg, sizeof(msg), "x%.2f: out/in %.3f, THD+N %.1f dB, %.1f ns/frame", kSpeeds[i], ratio, thdn,
+             nOut ? ns / nOut : 0);
+    TEST_MESSAGE(msg);
+    // 1 / speed, less what is still buffered: at most one 40 ms segment and the 15 ms search range
+    TEST_ASSERT_TRUE_MESSAGE(fabs(nOut * kSpeeds[i] - nIn) < 44100 * 55 / 1000, msg);
+    TEST_ASSERT_TRUE_MESSAGE(thdn < kMaxThdnDb[i], msg);
+  }
+}
+
+void test_stretch_unity_speed_passes_through() {
+  TimeStretch ts;
+  TEST_ASSERT_TRUE(ts.setSampleRate(44100));
+  ts.setSpeed(1.0f);
+  TEST_ASSERT_TRUE(ts.isBypassed());
+  int16_t in[2 * 100], out[2 * 100];
+  for (int i = 0; i < 2 * 100; i++) in[i] = (int16_t)(i * 311);
+  size_t used = 0;
+  TEST_ASSERT_EQUAL_UINT32(100, ts.process(in, 100, &used, out, 100));
+  TEST_ASSERT_EQUAL_UINT32(100, used);
+  TEST_ASSERT_EQUAL_INT16_ARRAY(in, out, 2 * 100);
+}
+
+void test_limiter_peak_stays_at_ceiling() {
+  Limiter* lim = new Limiter();
+  uint32_t noise = 0x2545F491;
+  for (int sig = 0; sig < LimiterSignalCount; sig++) {
+    lim->reset();
+    uint32_t nIn, nOut;
+    uint32_t peak = runLimiter(
+        *lim, [&](uint32_t t, int ch) { return limiterInput(sig, t, ch, noise); }, [](uint32_t, int32_t) {}, nIn,
+        nOut);
+    char msg[80];
+    snprintf(msg, sizeof(msg), "%s: peak %u, %u of %u frames out", kLimiterSignalNames[sig], peak, nOut, nIn);
+    TEST_MESSAGE(msg);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32_MESSAGE(LIMITER_CEILING, peak, msg);
+    // Everything but the block waiting for its lookahead and the one being filled is out
+    TEST_ASSERT_UINT32_WITHIN_MESSAGE(2 * LIMITER_BLOCK, nIn, nOut, msg);
+  }
+  delete lim;
+}
+
+void test_limiter_is_transparent_below_ceiling() {
+  Limiter* lim = new Limiter();
+  auto sine = [](uint32_t t, int) { return (int32_t)(0.89 * kFullScale * sin(2 * PI * 1000.0 * t / 44100)); };
+  uint32_t changed = 0, nIn, nOut;
+  runLimiter(
+      *lim, sine, [&](uint32_t t, int32_t v) { changed += v != sine(t, 0); }, nIn, nOut);
+  TEST_ASSERT_EQUAL_UINT32(0, changed);
+  TEST_ASSERT_EQUAL_INT32(LIMITER_UNITY, lim->getGain());
+  delete lim;
+}
+
+void test_wav_fused_scaling_matches_per_frame() {
+  // The fused WAV path scales a block at one volume and must give what the per-frame Gain() path
+  // gives. Both are timed on one second of 44.1 kHz noise, best of 5 runs, limiter and I2S excluded.
+  const uint32_t kFrames = 44100;
+  std::vector<int16_t> in(2 * kFrames);
+  std::vector<int32_t> perFrame(2 * kFrames), fused(2 * kFrames);
+  uint32_t noise = 0x2545F491;
+  for (int16_t& v : in) {
+    noise ^= noise << 13;
+    noise ^= noise >> 17;
+    noise ^= noise << 5;
+    v = (int16_t)noise;
+  }
+  static const int32_t kVolumesQ14[] = {0, 1, 5000, 16384, 32768};  // Mute ... 2.0 (ReplayGain +6 dB)
+  for (int32_t vol : kVolumesQ14) {
+    double perFrameNs = 1e30, fusedNs = 1e30;
+    for (int run = 0; run < 5; run++) {
+      Clock::time_point t0 = Clock::now();
+      for (uint32_t i = 0; i < kFrames; i++) {
+        int32_t s[2] = {in[2 * i] * 256, in[2 * i + 1] * 256};
+        pcm_gainFrameQ23(s, vol, vol);
+        perFrame[2 * i] = s[0];
+        perFrame[2 * i + 1] = s[1];
+      }
+      perFrameNs = min(perFrameNs, elapsedNs(t0));
+      t0 = Clock::now();
+      for (uint32_t i = 0; i < kFrames; i += LIMITER_BLOCK) {
+        pcm_scaleBlockQ23(&in[2 * i], min(kFrames - i, (uint32_t)LIMITER_BLOCK), vol, &fused[2 * i]);
+      }
+      fusedNs = min(fusedNs, elapsedNs(t0));
+    }
+    char msg[96];
+    snprintf(msg, sizeof(msg), "volume %ld/16384: per frame %.2f ns/frame, fused %.2f ns/frame", (long)vol,
+             perFrameNs / kFrames, fusedNs / kFrames);
+    TEST_MESSAGE(msg);
+    TEST_ASSERT_EQUAL_INT32_ARRAY_MESSAGE(perFrame.data(), fused.data(), 2 * kFrames, msg);
+  }
+}
+
+void test_seek_fade_in_has_no_click() {
+  // After a seek the DMA is zeroed, so the new position starts from silence. Worst case: it lands on
+  // the peak of a -1 dBFS 1 kHz sine. Unfaded that is a full-scale step; the ramp may add at most
+  // one ramp step (peak / len) to the largest step the sine itself makes.
+  static const uint32_t kRates[] = {44100, 48000};
+  for (uint32_t rate : kRates) {
+    uint16_t len = pcm_fadeInFrames(rate);
+    double ms = 1000.0 * len / rate;
+    const uint32_t start = rate / 4000;  // Quarter period, the peak
+    int32_t prev = 0;
+    int32_t maxStep = 0, sineStep = 0;
+    uint16_t pos = 0;
+    for (uint32_t i = 0; i < 2u * len; i++) {
+      int32_t x = sine16(29204, 1000, start + i, rate) * 256;
+      if (i) sineStep = max(sineStep, abs(x - (int32_t)sine16(29204, 1000, start + i - 1, rate) * 256));
+      int32_t s[2] = {x, -x};
+      pcm_fadeInQ23(s, pos, len);
+      TEST_ASSERT_EQUAL_INT32(-s[0], s[1]);
+      if (i == 0) TEST_ASSERT_EQUAL_INT32(0, s[0]);
+      if (i >= len) TEST_ASSERT_EQUAL_INT32(x, s[0]);  // Ramp done, samples pass unchanged
+      maxStep = max(maxStep, abs(s[0] - prev));
+      prev = s[0];
+    }
+    TEST_ASSERT_EQUAL_UINT16(len, pos);
+    char msg[112];
+    snprintf(msg, sizeof(msg), "%u Hz: ramp %u frames (%.1f ms), max step %.1f%% FS (sine alone %.1f%%, unfaded 89%%)",
+             rate, len, ms, 100.0 * maxStep / (1 << 23), 100.0 * sineStep / (1 << 23));
+    TEST_MESSAGE(msg);
+    TEST_ASSERT_TRUE_MESSAGE(ms > 7 && ms < 9, msg);
+    TEST_ASSERT_TRUE_MESSAGE(maxStep <= sineStep + 29204 * 256 / len + 1, msg);
+  }
+}
+
+int main(int, char**) {
+  UNITY_BEGIN();
+  RUN_TEST(test_resampler_length_and_thdn);
+  RUN_TEST(test_resampler_same_rate_is_bypassed);
+  RUN_TEST(test_stretch_length_and_thdn);
+  RUN_TEST(test_stretch_unity_speed_passes_through);
+  RUN_TEST(test_limiter_peak_stays_at_ceiling);
+  RUN_TEST(test_limiter_is_transparent_below_ceiling);
+  RUN_TEST(test_wav_fused_scaling_matches_per_frame);
+  RUN_TEST(test_seek_fade_in_has_no_click);
+  return UNITY_END();
+}